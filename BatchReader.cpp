@@ -0,0 +1,495 @@
+#include "BatchReader.hpp"
+
+#ifdef FS_TOOLS_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace fs_tools {
+namespace {
+// столько же читает read_attr_at за один read
+constexpr size_t READ_CHUNK = 4096U;
+}  // namespace
+
+#ifdef FS_TOOLS_HAVE_IO_URING
+namespace {
+// Файлов в одном пакете: SQ на столько записей, CQ ядро делает вдвое больше,
+// поэтому переполнения очереди завершений не бывает
+constexpr unsigned RING_ENTRIES = 256U;
+// user_data записей отмены; у операций пакета — индекс элемента
+constexpr uint64_t CANCEL_TAG = UINT64_MAX;
+
+auto load_acquire(const unsigned* ptr) -> unsigned {
+  return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+void store_release(unsigned* ptr, unsigned value) {
+  __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+}
+
+// дочитать файл длиннее одного чанка синхронно (uevent так длинен редко)
+auto read_rest(int fd, std::string& out) -> bool {
+  size_t used = out.size();
+  while (true) {
+    out.resize(used + READ_CHUNK);
+    const ssize_t NUM = ::pread(fd, &out[used], READ_CHUNK,
+                                static_cast<off_t>(used));
+    if (NUM < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    used += static_cast<size_t>(NUM);
+    if (static_cast<size_t>(NUM) < READ_CHUNK) {
+      break;
+    }
+  }
+  out.resize(used);
+  return true;
+}
+}  // namespace
+
+/**
+ * Минимальный io_uring без liburing: setup + mmap колец, очередь SQE и
+ * ожидание CQE через io_uring_enter.
+ */
+struct BatchReader::Ring {
+  Ring() = default;
+  Ring(const Ring&) = delete;
+  auto operator=(const Ring&) -> Ring& = delete;
+  ~Ring();
+
+  auto setup() -> bool;
+  /** Прочитать items пакетами; возвращает, сколько элементов обработано. */
+  auto read(std::vector<Item>& items) -> size_t;
+
+ private:
+  auto read_batch(std::vector<Item>& items, size_t begin, unsigned count)
+      -> bool;
+  auto supports(const std::vector<uint8_t>& opcodes) const -> bool;
+  auto queue() -> io_uring_sqe*;
+  /** Отправить накопленные SQE и дождаться @p count завершений. */
+  template <typename OnComplete>
+  auto submit_and_wait(unsigned count, OnComplete&& onComplete) -> bool;
+  /**
+   * Отменить брошенные операции (помеченные в m_busy) и забрать их CQE,
+   * закрывая открытые ими дескрипторы; после этого ядро не пишет в буферы.
+   */
+  auto drain() -> bool;
+
+  int m_fd = -1;
+  unsigned m_entries = 0;
+  void* m_sq_map = MAP_FAILED;
+  size_t m_sq_size = 0;
+  void* m_cq_map = MAP_FAILED;
+  size_t m_cq_size = 0;
+  io_uring_sqe* m_sqes = nullptr;
+  size_t m_sqes_size = 0;
+  unsigned* m_sq_head = nullptr;
+  unsigned* m_sq_tail = nullptr;
+  unsigned* m_sq_mask = nullptr;
+  unsigned* m_sq_array = nullptr;
+  unsigned* m_cq_head = nullptr;
+  unsigned* m_cq_tail = nullptr;
+  unsigned* m_cq_mask = nullptr;
+  io_uring_cqe* m_cqes = nullptr;
+  /** Хвост SQ с ещё не опубликованными записями. */
+  unsigned m_local_tail = 0;
+  std::vector<int> m_fds;
+  /** Операция пакета отправлена, а её CQE ещё не забран. */
+  std::vector<bool> m_busy;
+  /** Операции в m_busy — openat (их CQE несут дескрипторы), а не read. */
+  bool m_opening = false;
+  /** Кольцо отказало посреди пакета; новых пакетов не принимает. */
+  bool m_broken = false;
+  /**
+   * Буферы чтений, брошенных после отказа кольца: ядро ещё может в них
+   * писать, поэтому они живут до drain() в деструкторе.
+   */
+  std::vector<std::string> m_orphans;
+};
+
+BatchReader::Ring::~Ring() {
+  if (m_broken && !drain()) {
+    // ядро так и не вернуло CQE: освободить буферы, в которые оно ещё может
+    // писать, нельзя — остаётся оставить их ему
+    new std::vector<std::string>(std::move(m_orphans));
+  }
+  if (m_sqes != nullptr) {
+    ::munmap(m_sqes, m_sqes_size);
+  }
+  if (m_cq_map != MAP_FAILED && m_cq_map != m_sq_map) {
+    ::munmap(m_cq_map, m_cq_size);
+  }
+  if (m_sq_map != MAP_FAILED) {
+    ::munmap(m_sq_map, m_sq_size);
+  }
+  if (m_fd >= 0) {
+    ::close(m_fd);
+  }
+}
+
+auto BatchReader::Ring::setup() -> bool {
+  io_uring_params params{};
+  m_fd = static_cast<int>(::syscall(__NR_io_uring_setup, RING_ENTRIES, &params));
+  if (m_fd < 0) {
+    return false;  // ENOSYS, EPERM (seccomp, io_uring_disabled) и т.п.
+  }
+  if (!supports({IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE})) {
+    return false;  // ядро старше 5.6
+  }
+  m_entries = params.sq_entries;
+
+  m_sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  m_cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  const bool SINGLE_MMAP = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (SINGLE_MMAP) {
+    m_sq_size = m_cq_size = std::max(m_sq_size, m_cq_size);
+  }
+  m_sq_map = ::mmap(nullptr, m_sq_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+  if (m_sq_map == MAP_FAILED) {
+    return false;
+  }
+  m_cq_map = SINGLE_MMAP
+                 ? m_sq_map
+                 : ::mmap(nullptr, m_cq_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+  if (m_cq_map == MAP_FAILED) {
+    return false;
+  }
+  m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+  void* sqes = ::mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    return false;
+  }
+  m_sqes = static_cast<io_uring_sqe*>(sqes);
+
+  auto* sq = static_cast<char*>(m_sq_map);
+  auto* cq = static_cast<char*>(m_cq_map);
+  m_sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+  m_sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  m_sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  m_sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+  m_cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  m_cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  m_cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+  m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+  m_local_tail = *m_sq_tail;
+  return true;
+}
+
+auto BatchReader::Ring::supports(const std::vector<uint8_t>& opcodes) const
+    -> bool {
+  // io_uring_probe заканчивается гибким массивом ops[]
+  constexpr unsigned MAX_OPS = 256U;
+  std::vector<char> buffer(sizeof(io_uring_probe) +
+                           MAX_OPS * sizeof(io_uring_probe_op));
+  auto* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+  if (::syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_PROBE, probe,
+                MAX_OPS) < 0) {
+    return false;
+  }
+  return std::all_of(opcodes.begin(), opcodes.end(), [probe](uint8_t op) {
+    return op < probe->ops_len &&
+           (probe->ops[op].flags & IO_URING_OP_SUPPORTED) != 0;
+  });
+}
+
+auto BatchReader::Ring::read(std::vector<Item>& items) -> size_t {
+  if (m_broken) {
+    return 0;
+  }
+  for (size_t begin = 0; begin < items.size(); begin += m_entries) {
+    const auto COUNT =
+        static_cast<unsigned>(std::min<size_t>(m_entries, items.size() - begin));
+    if (!read_batch(items, begin, COUNT)) {
+      return begin;
+    }
+  }
+  return items.size();
+}
+
+auto BatchReader::Ring::read_batch(std::vector<Item>& items, size_t begin,
+                                   unsigned count) -> bool {
+  m_fds.assign(count, -1);
+  m_busy.assign(count, false);
+  // CQE всех отправленных SQE к этому моменту забраны, кроме тех, что
+  // помечены в m_busy: их дескрипторы и буферы остаются за ядром
+  auto abandon = [&] {
+    for (unsigned i = 0; i < count; ++i) {
+      if (m_busy[i]) {
+        m_orphans.push_back(std::move(items[begin + i].m_content));
+        items[begin + i].m_content = std::string();
+      }
+      if (m_fds[i] >= 0) {
+        ::close(m_fds[i]);
+        m_fds[i] = -1;
+      }
+    }
+    m_broken = true;
+    return false;
+  };
+
+  // 1. openat на весь пакет; имя ядро копирует при отправке
+  m_opening = true;
+  for (unsigned i = 0; i < count; ++i) {
+    auto& item = items[begin + i];
+    auto* sqe = queue();
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = item.m_dirfd;
+    sqe->addr = reinterpret_cast<uintptr_t>(item.m_name.c_str());
+    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+    sqe->user_data = i;
+    m_busy[i] = true;
+  }
+  const bool OPENED = submit_and_wait(count, [&](const io_uring_cqe& cqe) {
+    auto& item = items[begin + cqe.user_data];
+    m_busy[cqe.user_data] = false;
+    if (cqe.res >= 0) {
+      m_fds[cqe.user_data] = cqe.res;
+    } else {
+      item.m_content.clear();
+      item.m_error = std::error_code(-cqe.res, std::generic_category());
+    }
+  });
+  if (!OPENED) {
+    return abandon();
+  }
+
+  // 2. read по открытым; буфер элемента переиспользуется
+  m_opening = false;
+  unsigned reads = 0;
+  for (unsigned i = 0; i < count; ++i) {
+    if (m_fds[i] < 0) {
+      continue;
+    }
+    auto& item = items[begin + i];
+    item.m_content.resize(READ_CHUNK);
+    auto* sqe = queue();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = m_fds[i];
+    sqe->addr = reinterpret_cast<uintptr_t>(item.m_content.data());
+    sqe->len = READ_CHUNK;
+    sqe->off = 0;
+    sqe->user_data = i;
+    m_busy[i] = true;
+    ++reads;
+  }
+  const bool READ = submit_and_wait(reads, [&](const io_uring_cqe& cqe) {
+    auto& item = items[begin + cqe.user_data];
+    m_busy[cqe.user_data] = false;
+    if (cqe.res < 0) {
+      item.m_content.clear();
+      item.m_error = std::error_code(-cqe.res, std::generic_category());
+      return;
+    }
+    item.m_content.resize(static_cast<size_t>(cqe.res));
+    if (static_cast<size_t>(cqe.res) == READ_CHUNK &&
+        !read_rest(m_fds[cqe.user_data], item.m_content)) {
+      item.m_content.clear();
+      item.m_error = std::error_code(errno, std::generic_category());
+      return;
+    }
+    item.m_error.clear();
+  });
+  if (!READ) {
+    return abandon();
+  }
+
+  // 3. close тоже пакетом; дескриптор отдаётся ядру только с CQE закрытия
+  const unsigned FIRST = m_local_tail;
+  std::vector<unsigned> closing;
+  closing.reserve(count);
+  for (unsigned i = 0; i < count; ++i) {
+    if (m_fds[i] < 0) {
+      continue;
+    }
+    auto* sqe = queue();
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = m_fds[i];
+    sqe->user_data = i;
+    m_busy[i] = true;
+    closing.push_back(i);
+  }
+  const auto CLOSES = static_cast<unsigned>(closing.size());
+  if (submit_and_wait(CLOSES, [&](const io_uring_cqe& cqe) {
+        m_busy[cqe.user_data] = false;
+        m_fds[cqe.user_data] = -1;
+      })) {
+    return true;
+  }
+  // без SQPOLL ядро берёт SQE только в io_uring_enter: незабранный хвост
+  // пакета снимаем и закрываем сами, забранные закроет ядро (их CQE
+  // дождётся drain())
+  const unsigned CONSUMED = load_acquire(m_sq_head) - FIRST;
+  m_local_tail = FIRST + CONSUMED;
+  store_release(m_sq_tail, m_local_tail);
+  for (unsigned k = 0; k < CLOSES; ++k) {
+    const unsigned INDEX = closing[k];
+    if (k >= CONSUMED) {
+      m_busy[INDEX] = false;
+      ::close(m_fds[INDEX]);
+    }
+    m_fds[INDEX] = -1;
+  }
+  // прочитанное уже в элементах, буферы ядру не нужны
+  m_broken = true;
+  return false;
+}
+
+auto BatchReader::Ring::queue() -> io_uring_sqe* {
+  const unsigned INDEX = m_local_tail & *m_sq_mask;
+  m_sq_array[INDEX] = INDEX;
+  ++m_local_tail;
+  auto* sqe = &m_sqes[INDEX];
+  std::memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+template <typename OnComplete>
+auto BatchReader::Ring::submit_and_wait(unsigned count,
+                                        OnComplete&& onComplete) -> bool {
+  // публикуем хвост: ядро увидит SQE только после release-записи
+  store_release(m_sq_tail, m_local_tail);
+  unsigned pending = count;
+  unsigned reaped = 0;
+  while (reaped < count) {
+    const long RET =
+        ::syscall(__NR_io_uring_enter, m_fd, pending, count - reaped,
+                  IORING_ENTER_GETEVENTS, nullptr, 0);
+    if (RET >= 0) {
+      pending -= std::min(pending, static_cast<unsigned>(RET));
+    } else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+      // кольцо неисправно; незабранные CQE помечены в m_busy
+      return false;
+    }
+    // EAGAIN/EBUSY: освобождаем CQ и повторяем — в полёте остаются
+    // отправленные операции, бросать их нельзя
+
+    unsigned head = *m_cq_head;
+    const unsigned TAIL = load_acquire(m_cq_tail);
+    for (; head != TAIL; ++head, ++reaped) {
+      onComplete(m_cqes[head & *m_cq_mask]);
+    }
+    store_release(m_cq_head, head);
+  }
+  return true;
+}
+
+auto BatchReader::Ring::drain() -> bool {
+  // CQE ждём от каждой брошенной операции и от каждой отмены; отмена лишь
+  // ускоряет, поэтому без места в SQ просто ждём завершения
+  unsigned expected = 0;
+  for (unsigned i = 0; i < m_busy.size(); ++i) {
+    if (!m_busy[i]) {
+      continue;
+    }
+    ++expected;
+    if (m_local_tail - load_acquire(m_sq_head) < m_entries) {
+      auto* sqe = queue();
+      sqe->opcode = IORING_OP_ASYNC_CANCEL;
+      sqe->addr = i;
+      sqe->user_data = CANCEL_TAG;
+      ++expected;
+    }
+  }
+  store_release(m_sq_tail, m_local_tail);
+  unsigned reaped = 0;
+  while (reaped < expected) {
+    // отправляем и то, что ядро не забрало до отказа
+    const unsigned UNSUBMITTED = m_local_tail - load_acquire(m_sq_head);
+    if (::syscall(__NR_io_uring_enter, m_fd, UNSUBMITTED, 1U,
+                  IORING_ENTER_GETEVENTS, nullptr, 0) < 0 &&
+        errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+      return false;
+    }
+    unsigned head = *m_cq_head;
+    const unsigned TAIL = load_acquire(m_cq_tail);
+    for (; head != TAIL; ++head, ++reaped) {
+      const auto& cqe = m_cqes[head & *m_cq_mask];
+      if (cqe.user_data == CANCEL_TAG) {
+        continue;
+      }
+      m_busy[cqe.user_data] = false;
+      if (m_opening && cqe.res >= 0) {
+        ::close(cqe.res);
+      }
+    }
+    store_release(m_cq_head, head);
+  }
+  m_orphans.clear();
+  return true;
+}
+#else
+struct BatchReader::Ring {
+  static auto setup() -> bool { return false; }
+  static auto read(std::vector<Item>& /*items*/) -> size_t { return 0; }
+};
+#endif
+
+auto BatchReader::thread_ring() -> std::shared_ptr<Ring>& {
+  thread_local std::shared_ptr<Ring> ring;
+  return ring;
+}
+
+BatchReader::BatchReader(bool allow_uring) {
+  if (!allow_uring) {
+    return;
+  }
+  // setup и три mmap дороже самого пакета — кольцо одно на поток;
+  // ENOSYS/EPERM не пройдут, повторно не пробуем
+  thread_local bool unavailable = false;
+  auto& ring = thread_ring();
+  if (!ring && !unavailable) {
+    ring = std::make_shared<Ring>();
+    if (!ring->setup()) {
+      ring.reset();
+      unavailable = true;
+    }
+  }
+  m_ring = ring;
+}
+
+BatchReader::BatchReader(BatchReader&& other) noexcept = default;
+auto BatchReader::operator=(BatchReader&& other) noexcept
+    -> BatchReader& = default;
+BatchReader::~BatchReader() = default;
+
+auto BatchReader::uses_io_uring() const -> bool { return m_ring != nullptr; }
+
+auto BatchReader::read_all(std::vector<Item>& items) -> size_t {
+  size_t begin = 0;
+  if (m_ring) {
+    begin = m_ring->read(items);
+    if (begin < items.size()) {
+      // кольцо сломалось — остаток читаем синхронно, поток получит новое
+      if (thread_ring() == m_ring) {
+        thread_ring().reset();
+      }
+      m_ring.reset();
+    }
+  }
+  for (size_t i = begin; i < items.size(); ++i) {
+    auto& item = items[i];
+    read_attr_at(item.m_dirfd, item.m_name.c_str(), item.m_content,
+                 item.m_error);
+  }
+  return static_cast<size_t>(
+      std::count_if(items.begin(), items.end(),
+                    [](const Item& item) { return !item.m_error; }));
+}
+}  // namespace fs_tools
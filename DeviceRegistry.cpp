@@ -0,0 +1,132 @@
+#include "DeviceRegistry.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace fs_tools {
+static_assert(
+    std::atomic<uint64_t>::is_always_lock_free &&
+        std::atomic<const DeviceRegistry::Snapshot*>::is_always_lock_free,
+    "the read path must not fall back to locked atomics");
+
+DeviceRegistry::DeviceRegistry() {
+  const std::lock_guard<std::mutex> LOCK(m_write_mutex);
+  publish_index();
+}
+
+DeviceRegistry::DeviceRegistry(std::vector<std::string> classRoots)
+    : m_index(std::move(classRoots)) {
+  const std::lock_guard<std::mutex> LOCK(m_write_mutex);
+  publish_index();
+}
+
+DeviceRegistry::~DeviceRegistry() {
+  stop();
+  delete m_current.load(std::memory_order_acquire);
+}
+
+auto DeviceRegistry::snapshot() const -> Snapshot {
+  while (true) {
+    const auto EPOCH = m_epoch.load();
+    auto& pinned = m_readers[EPOCH & 1U];
+    pinned.fetch_add(1);
+    // эпоха не сменилась после записи в счётчик: писатель, подменивший
+    // указатель, дождётся этого счётчика, прежде чем освободить старый
+    if (m_epoch.load() == EPOCH) {
+      Snapshot out = *m_current.load();
+      pinned.fetch_sub(1, std::memory_order_release);
+      return out;
+    }
+    pinned.fetch_sub(1, std::memory_order_release);
+  }
+}
+
+auto DeviceRegistry::refresh() -> bool {
+  const std::lock_guard<std::mutex> LOCK(m_write_mutex);
+  if (m_index.refresh() == 0) {
+    return false;
+  }
+  publish_index();
+  return true;
+}
+
+auto DeviceRegistry::invalidate(const std::string& dev_node) -> bool {
+  const std::lock_guard<std::mutex> LOCK(m_write_mutex);
+  const bool FOUND = m_index.invalidate(dev_node);
+  // даже неудачная перепроверка могла выкинуть запись из индекса
+  publish_index();
+  return FOUND;
+}
+
+void DeviceRegistry::publish(DeviceSnapshot snapshot) {
+  const std::lock_guard<std::mutex> LOCK(m_write_mutex);
+  publish_locked(std::move(snapshot));
+}
+
+void DeviceRegistry::publish_index() {
+  publish_locked(DeviceSnapshot(m_index.functions()));
+}
+
+void DeviceRegistry::publish_locked(DeviceSnapshot snapshot) {
+  // снимок собран целиком до подмены: читатели видят либо старый, либо новый
+  const auto* previous = m_current.exchange(new Snapshot(
+      std::make_shared<const DeviceSnapshot>(std::move(snapshot))));
+  m_generation.fetch_add(1, std::memory_order_release);
+  if (previous == nullptr) {
+    return;
+  }
+  // период ожидания: каждая смена эпохи отправляет новых читателей в другой
+  // счётчик, а старый дожидается до нуля; два раза — оба счётчика, так что
+  // никто больше не копирует previous. Копия читателя живёт и после delete
+  for (int flip = 0; flip < 2; ++flip) {
+    const auto EPOCH = m_epoch.fetch_add(1);
+    while (m_readers[EPOCH & 1U].load(std::memory_order_acquire) != 0) {
+      std::this_thread::yield();
+    }
+  }
+  delete previous;
+}
+
+void DeviceRegistry::start(std::chrono::milliseconds interval) {
+  stop();
+  {
+    const std::lock_guard<std::mutex> LOCK(m_stop_mutex);
+    m_stop = false;
+  }
+  m_refresher = std::thread([this, interval] {
+    std::unique_lock<std::mutex> lock(m_stop_mutex);
+    while (!m_stop_cv.wait_for(lock, interval, [this] { return m_stop; })) {
+      lock.unlock();
+      refresh();
+      lock.lock();
+    }
+  });
+}
+
+void DeviceRegistry::stop() {
+  {
+    const std::lock_guard<std::mutex> LOCK(m_stop_mutex);
+    m_stop = true;
+  }
+  m_stop_cv.notify_all();
+  if (m_refresher.joinable()) {
+    m_refresher.join();
+  }
+}
+
+auto DeviceRegistry::Reader::get() -> const DeviceSnapshot& {
+  // счётчик растёт после подмены указателя: увидели новое поколение —
+  // snapshot() вернёт снимок не старше него
+  const auto GENERATION = m_registry->generation();
+  if (!m_snapshot || GENERATION != m_generation) {
+    m_snapshot = m_registry->snapshot();
+    m_generation = GENERATION;
+  }
+  return *m_snapshot;
+}
+}  // namespace fs_tools
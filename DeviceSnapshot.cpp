@@ -0,0 +1,116 @@
+#include "DeviceSnapshot.hpp"
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace fs_tools {
+namespace {
+using Row = FunctionTable::Row;
+
+// ключ строки: dev path отличается от DEVNAME только общим префиксом "/dev/"
+auto key(const Row& row, const StringPool& pool)
+    -> std::pair<std::string_view, std::string_view> {
+  return {pool.view(row.m_dev_name), pool.view(row.m_class_name)};
+}
+}  // namespace
+
+DeviceSnapshot::DeviceSnapshot(const std::vector<UsbFunction>& functions) {
+  // сортируем индексы по ключу, затем добавляем в таблицу уже по порядку
+  std::vector<size_t> order(functions.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  const auto KEY = [&functions](size_t index) {
+    return std::make_pair(std::string_view(functions[index].m_dev_name),
+                          std::string_view(functions[index].m_class_name));
+  };
+  std::stable_sort(order.begin(), order.end(),
+                   [&KEY](size_t first, size_t second) {
+                     return KEY(first) < KEY(second);
+                   });
+
+  for (size_t i = 0; i < order.size(); ++i) {
+    if (i > 0 && KEY(order[i]) == KEY(order[i - 1])) {
+      continue;
+    }
+    m_table.add(functions[order[i]]);
+  }
+}
+
+auto DeviceSnapshot::capture(const std::string& dev_usb_root,
+                             const std::vector<std::string>& classRoots)
+    -> DeviceSnapshot {
+  return DeviceSnapshot(SysFSHelper::list_functions(dev_usb_root, classRoots));
+}
+
+auto DeviceSnapshot::capture() -> DeviceSnapshot {
+  return DeviceSnapshot(SysFSHelper::list_functions());
+}
+
+auto DeviceSnapshot::diff(const DeviceSnapshot& before,
+                          const DeviceSnapshot& after) -> Diff {
+  Diff out;
+  const auto& OLD_ROWS = before.m_table.rows();
+  const auto& NEW_ROWS = after.m_table.rows();
+  const auto& OLD_POOL = before.m_table.pool();
+  const auto& NEW_POOL = after.m_table.pool();
+
+  // слияние двух упорядоченных таблиц; строки сравниваются как string_view,
+  // разворачиваются в UsbFunction только попавшие в результат
+  size_t old_pos = 0;
+  size_t new_pos = 0;
+  while (old_pos < OLD_ROWS.size() || new_pos < NEW_ROWS.size()) {
+    if (new_pos == NEW_ROWS.size()) {
+      out.m_removed.push_back(before.m_table.function(old_pos++));
+      continue;
+    }
+    if (old_pos == OLD_ROWS.size()) {
+      out.m_added.push_back(after.m_table.function(new_pos++));
+      continue;
+    }
+
+    const auto& OLD_ROW = OLD_ROWS[old_pos];
+    const auto& NEW_ROW = NEW_ROWS[new_pos];
+    const auto OLD_KEY = key(OLD_ROW, OLD_POOL);
+    const auto NEW_KEY = key(NEW_ROW, NEW_POOL);
+    if (OLD_KEY < NEW_KEY) {
+      out.m_removed.push_back(before.m_table.function(old_pos++));
+    } else if (NEW_KEY < OLD_KEY) {
+      out.m_added.push_back(after.m_table.function(new_pos++));
+    } else {
+      if (OLD_ROW.m_id != NEW_ROW.m_id ||
+          OLD_POOL.view(OLD_ROW.m_usb_node) !=
+              NEW_POOL.view(NEW_ROW.m_usb_node)) {
+        out.m_changed.push_back({before.m_table.function(old_pos),
+                                 after.m_table.function(new_pos)});
+      }
+      ++old_pos;
+      ++new_pos;
+    }
+  }
+  return out;
+}
+
+auto DeviceSnapshot::find(std::string_view dev_node) const
+    -> std::optional<UsbFunction> {
+  constexpr std::string_view DEV_PATH = "/dev/";
+  if (dev_node.substr(0, DEV_PATH.size()) == DEV_PATH) {
+    dev_node.remove_prefix(DEV_PATH.size());
+  }
+
+  const auto& ROWS = m_table.rows();
+  const auto& POOL = m_table.pool();
+  const auto ITER = std::lower_bound(
+      ROWS.begin(), ROWS.end(), dev_node,
+      [&POOL](const Row& row, std::string_view name) {
+        return POOL.view(row.m_dev_name) < name;
+      });
+  if (ITER == ROWS.end() || POOL.view(ITER->m_dev_name) != dev_node) {
+    return std::nullopt;
+  }
+  return FunctionTable::expand(*ITER, POOL);
+}
+}  // namespace fs_tools
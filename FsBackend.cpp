@@ -0,0 +1,68 @@
+#include "FsBackend.hpp"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace fs_tools {
+auto FsBackend::posix() -> const FsBackend& {
+  static const PosixBackend BACKEND;
+  return BACKEND;
+}
+
+auto PosixBackend::list(const std::string& dir, std::vector<DirEntry>& out,
+                        std::error_code& error) const -> bool {
+  out.clear();
+  const auto DIR = DirHandle::open(dir, error);
+  if (!DIR.valid()) {
+    return false;
+  }
+  out = DIR.typed_entries();
+  return true;
+}
+
+auto PosixBackend::stat(const std::string& path, Stat& out, bool follow,
+                        std::error_code& error) const -> bool {
+  struct stat stt{};
+  const int RET =
+      follow ? ::stat(path.c_str(), &stt) : ::lstat(path.c_str(), &stt);
+  if (RET != 0) {
+    error = std::error_code(errno, std::generic_category());
+    return false;
+  }
+  error.clear();
+  out.m_type = mode_to_dtype(stt.st_mode);
+  out.m_inode = stt.st_ino;
+  out.m_size = static_cast<size_t>(stt.st_size);
+  return true;
+}
+
+auto PosixBackend::readlink(const std::string& path, std::string& out,
+                            std::error_code& error) const -> bool {
+  std::array<char, PATH_MAX> buf;
+  const auto LEN = ::readlink(path.c_str(), buf.data(), buf.size());
+  if (LEN < 0) {
+    error = std::error_code(errno, std::generic_category());
+    out.clear();
+    return false;
+  }
+  error.clear();
+  out.assign(buf.data(), static_cast<size_t>(LEN));
+  return true;
+}
+
+auto PosixBackend::realpath(const std::string& path,
+                            std::error_code& error) const -> std::string {
+  return canonical_path(path, error);
+}
+
+auto PosixBackend::read_attr(const std::string& path, std::string& out,
+                             std::error_code& error) const -> bool {
+  return fs_tools::read_attr(path, out, error);
+}
+}  // namespace fs_tools
@@ -0,0 +1,117 @@
+#include "FunctionTable.hpp"
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace fs_tools {
+using namespace std::string_literals;
+
+StringPool::StringPool(const StringPool& other) {
+  // view'хи другого пула указывают в его куски — переинтернировать
+  m_views.reserve(other.m_views.size());
+  m_ids.reserve(other.m_ids.size());
+  for (const auto VIEW : other.m_views) {
+    intern(VIEW);
+  }
+}
+
+auto StringPool::operator=(const StringPool& other) -> StringPool& {
+  if (this != &other) {
+    StringPool copy(other);
+    *this = std::move(copy);
+  }
+  return *this;
+}
+
+auto StringPool::intern(std::string_view str) -> Id {
+  if (auto iter = m_ids.find(str); iter != m_ids.end()) {
+    return iter->second;
+  }
+
+  char* data = nullptr;
+  if (str.size() > CHUNK_SIZE / 4) {
+    // длинная строка — отдельный блок, чтобы не дырявить общий кусок
+    m_large.push_back(std::make_unique<char[]>(str.size()));
+    data = m_large.back().get();
+  } else {
+    if (m_chunks.empty() || m_chunk_used + str.size() > CHUNK_SIZE) {
+      m_chunks.push_back(std::make_unique<char[]>(CHUNK_SIZE));
+      m_chunk_used = 0;
+    }
+    data = m_chunks.back().get() + m_chunk_used;
+    m_chunk_used += str.size();
+  }
+  std::copy(str.begin(), str.end(), data);
+
+  const auto ID = static_cast<Id>(m_views.size());
+  m_views.emplace_back(data, str.size());
+  m_ids.emplace(m_views.back(), ID);
+  return ID;
+}
+
+auto StringPool::find(std::string_view str) const -> std::optional<Id> {
+  if (auto iter = m_ids.find(str); iter != m_ids.end()) {
+    return iter->second;
+  }
+  return std::nullopt;
+}
+
+void StringPool::clear() {
+  m_ids.clear();
+  m_views.clear();
+  m_chunks.clear();
+  m_large.clear();
+  m_chunk_used = 0;
+}
+
+FunctionTable::FunctionTable(const std::vector<UsbFunction>& functions) {
+  m_rows.reserve(functions.size());
+  for (const auto& func : functions) {
+    add(func);
+  }
+}
+
+auto FunctionTable::add(const UsbFunction& func) -> size_t {
+  m_rows.push_back(compact(func, m_pool));
+  return m_rows.size() - 1;
+}
+
+auto FunctionTable::functions() const -> std::vector<UsbFunction> {
+  std::vector<UsbFunction> out;
+  out.reserve(m_rows.size());
+  for (const auto& row : m_rows) {
+    out.push_back(expand(row, m_pool));
+  }
+  return out;
+}
+
+void FunctionTable::clear() {
+  m_rows.clear();
+  m_pool.clear();
+}
+
+auto FunctionTable::compact(const UsbFunction& func, StringPool& pool) -> Row {
+  Row row;
+  row.m_id = func.m_id;
+  row.m_usb_node = pool.intern(func.m_usbNode);
+  row.m_class_name = pool.intern(func.m_class_name);
+  row.m_dev_name = pool.intern(func.m_dev_name);
+  return row;
+}
+
+auto FunctionTable::expand(const Row& row, const StringPool& pool)
+    -> UsbFunction {
+  UsbFunction func;
+  func.m_id = row.m_id;
+  func.m_vid = row.m_id.vid_string();
+  func.m_pid = row.m_id.pid_string();
+  func.m_usbNode = pool.view(row.m_usb_node);
+  func.m_class_name = pool.view(row.m_class_name);
+  func.m_dev_name = pool.view(row.m_dev_name);
+  func.m_dev_path = "/dev/"s + func.m_dev_name;
+  return func;
+}
+}  // namespace fs_tools
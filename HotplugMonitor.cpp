@@ -0,0 +1,260 @@
+#include "HotplugMonitor.hpp"
+
+#include <linux/netlink.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace fs_tools {
+using namespace std::string_literals;
+
+namespace {
+// Ядро шлёт uevent не длиннее UEVENT_BUFFER_SIZE (2048) + заголовок
+constexpr size_t MESSAGE_BUFFER_SIZE = 8192;
+
+// node лежит в поддереве root (или совпадает с ним)
+auto is_under(const std::string& node, const std::string& root) -> bool {
+  return node.rfind(root, 0) == 0 &&
+         (node.size() == root.size() || node[root.size()] == '/');
+}
+}  // namespace
+
+auto HotplugMonitor::open(Callback callback, std::error_code& error,
+                          std::string sysRoot,
+                          std::vector<std::string> classRoots)
+    -> std::optional<HotplugMonitor> {
+  const int FD = ::socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC,
+                          NETLINK_KOBJECT_UEVENT);
+  if (FD < 0) {
+    error = std::error_code(errno, std::generic_category());
+    return std::nullopt;
+  }
+
+  sockaddr_nl addr{};
+  addr.nl_family = AF_NETLINK;
+  addr.nl_pid = 0;
+  addr.nl_groups = 1;  // сообщения ядра, не udev
+  if (::bind(FD, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) !=
+      0) {
+    error = std::error_code(errno, std::generic_category());
+    ::close(FD);
+    return std::nullopt;
+  }
+  // всплеск событий (перезагрузка хаба) не должен переполнить очередь;
+  // FORCE обходит rmem_max, но требует CAP_NET_ADMIN
+  const int SIZE = RECEIVE_BUFFER_SIZE;
+  if (::setsockopt(FD, SOL_SOCKET, SO_RCVBUFFORCE, &SIZE, sizeof(SIZE)) !=
+      0) {
+    ::setsockopt(FD, SOL_SOCKET, SO_RCVBUF, &SIZE, sizeof(SIZE));
+  }
+  error.clear();
+  return HotplugMonitor(FD, std::move(callback), std::move(sysRoot),
+                        std::move(classRoots));
+}
+
+auto HotplugMonitor::adopt(int fd, Callback callback, std::string sysRoot,
+                           std::vector<std::string> classRoots)
+    -> HotplugMonitor {
+  return {fd, std::move(callback), std::move(sysRoot), std::move(classRoots)};
+}
+
+HotplugMonitor::HotplugMonitor(int fd, Callback callback, std::string sysRoot,
+                               std::vector<std::string> classRoots)
+    : m_fd(fd),
+      m_callback(std::move(callback)),
+      m_class_roots(std::move(classRoots)),
+      m_buffer(MESSAGE_BUFFER_SIZE) {
+  // m_usbNode канонический — сравниваем с каноническим корнем
+  std::error_code error;
+  m_sys_root = canonical_path(sysRoot, error);
+  if (error || m_sys_root.empty()) {
+    m_sys_root = std::move(sysRoot);
+  }
+}
+
+HotplugMonitor::HotplugMonitor(HotplugMonitor&& other) noexcept
+    : m_fd(std::exchange(other.m_fd, -1)),
+      m_callback(std::move(other.m_callback)),
+      m_sys_root(std::move(other.m_sys_root)),
+      m_class_roots(std::move(other.m_class_roots)),
+      m_buffer(std::move(other.m_buffer)),
+      m_tracked(std::move(other.m_tracked)) {}
+
+auto HotplugMonitor::operator=(HotplugMonitor&& other) noexcept
+    -> HotplugMonitor& {
+  if (this != &other) {
+    if (m_fd >= 0) {
+      ::close(m_fd);
+    }
+    m_fd = std::exchange(other.m_fd, -1);
+    m_callback = std::move(other.m_callback);
+    m_sys_root = std::move(other.m_sys_root);
+    m_class_roots = std::move(other.m_class_roots);
+    m_buffer = std::move(other.m_buffer);
+    m_tracked = std::move(other.m_tracked);
+  }
+  return *this;
+}
+
+HotplugMonitor::~HotplugMonitor() {
+  if (m_fd >= 0) {
+    ::close(m_fd);
+  }
+}
+
+auto HotplugMonitor::poll(std::chrono::milliseconds timeout) -> size_t {
+  pollfd pfd{};
+  pfd.fd = m_fd;
+  pfd.events = POLLIN;
+  if (::poll(&pfd, 1, static_cast<int>(timeout.count())) <= 0) {
+    return 0;
+  }
+  return dispatch();
+}
+
+auto HotplugMonitor::dispatch() -> size_t {
+  size_t count = 0;
+  while (true) {
+    sockaddr_nl sender{};
+    socklen_t sender_len = sizeof(sender);
+    const ssize_t NUM =
+        ::recvfrom(m_fd, m_buffer.data(), m_buffer.size(), MSG_DONTWAIT,
+                   reinterpret_cast<sockaddr*>(&sender), &sender_len);
+    if (NUM < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == ENOBUFS) {
+        // ядро выбросило события: вызывающему нужно перечитать состояние
+        emit(Action::RESYNC, UsbFunction{}, count);
+        continue;
+      }
+      break;  // EAGAIN — очередь пуста
+    }
+    // по netlink принимаем только сообщения ядра (nl_pid == 0)
+    if (sender_len >= sizeof(sender) && sender.nl_family == AF_NETLINK &&
+        sender.nl_pid != 0) {
+      continue;
+    }
+    count += handle_message(m_buffer.data(), static_cast<size_t>(NUM));
+  }
+  return count;
+}
+
+auto HotplugMonitor::handle_message(const char* data, size_t size) -> size_t {
+  // "action@devpath\0ACTION=...\0DEVPATH=...\0..." — разбираем прямо в буфере
+  const std::string_view CONTENT(data, size);
+  const auto HEADER = CONTENT.substr(0, CONTENT.find('\0'));
+  if (HEADER.find('@') == std::string_view::npos) {
+    return 0;  // не сообщение ядра (например, "libudev" от udevd)
+  }
+
+  using Uevent = SysFSHelper::Uevent;
+  const auto EVENT = Uevent::parse(CONTENT,
+                                   Uevent::ACTION | Uevent::DEVPATH |
+                                       Uevent::SUBSYSTEM | Uevent::DEVNAME |
+                                       Uevent::PRODUCT,
+                                   '\0');
+  if (EVENT.m_action.empty() || EVENT.m_devpath.empty()) {
+    return 0;
+  }
+  const auto SYS_PATH = m_sys_root + std::string(EVENT.m_devpath);
+
+  size_t count = 0;
+  const bool HAS_DEVNAME = !EVENT.m_devname.empty();
+  const std::string* const CLASS_ROOT = class_root(EVENT.m_subsystem);
+  const bool KNOWN_CLASS = CLASS_ROOT != nullptr;
+
+  if (EVENT.m_action == "add" || EVENT.m_action == "bind") {
+    if (!HAS_DEVNAME || !KNOWN_CLASS) {
+      return 0;
+    }
+    auto func = SysFSHelper::resolve_function(*CLASS_ROOT, SYS_PATH,
+                                              EVENT.m_devname);
+    if (!func) {
+      return 0;
+    }
+    auto [iter, inserted] = m_tracked.emplace(func->m_dev_path, *func);
+    if (!inserted) {
+      if (iter->second.m_id == func->m_id &&
+          iter->second.m_usbNode == func->m_usbNode) {
+        return 0;  // повтор (add после bind и т.п.)
+      }
+      emit(Action::REMOVED, iter->second, count);
+      iter->second = *func;
+    }
+    emit(Action::ADDED, *func, count);
+    return count;
+  }
+
+  if (EVENT.m_action != "remove" && EVENT.m_action != "unbind") {
+    return 0;  // change/move/online/offline не меняют набор функций
+  }
+
+  if (HAS_DEVNAME && KNOWN_CLASS) {
+    auto iter = m_tracked.find("/dev/"s.append(EVENT.m_devname));
+    if (iter != m_tracked.end()) {
+      emit(Action::REMOVED, iter->second, count);
+      m_tracked.erase(iter);
+    }
+    return count;
+  }
+
+  if (EVENT.m_subsystem != "usb") {
+    return 0;
+  }
+  // USB-устройство или интерфейс: снять всё, что под ним
+  std::string vid;
+  std::string pid;
+  std::optional<SysFSHelper::UsbId> ids;
+  if (EVENT.has(Uevent::PRODUCT) &&
+      SysFSHelper::parse_ids_from_product(EVENT.m_product, vid, pid)) {
+    ids = SysFSHelper::UsbId::parse(vid, pid);
+  }
+  for (auto iter = m_tracked.begin(); iter != m_tracked.end();) {
+    const auto& func = iter->second;
+    if (is_under(func.m_usbNode, SYS_PATH) &&
+        (!ids || func.m_id == *ids)) {
+      emit(Action::REMOVED, func, count);
+      iter = m_tracked.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+  return count;
+}
+
+void HotplugMonitor::track(const std::vector<UsbFunction>& functions) {
+  for (const auto& func : functions) {
+    m_tracked[func.m_dev_path] = func;
+  }
+}
+
+auto HotplugMonitor::class_root(std::string_view subsystem) const
+    -> const std::string* {
+  if (subsystem.empty()) {
+    return nullptr;
+  }
+  for (const auto& root : m_class_roots) {
+    if (SysFSHelper::class_name_of(root) == subsystem) {
+      return &root;
+    }
+  }
+  return nullptr;
+}
+
+void HotplugMonitor::emit(Action action, const UsbFunction& func,
+                          size_t& count) const {
+  ++count;
+  if (m_callback) {
+    m_callback(Event{action, func});
+  }
+}
+}  // namespace fs_tools
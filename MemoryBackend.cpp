@@ -0,0 +1,311 @@
+#include "MemoryBackend.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace fs_tools {
+namespace {
+auto make_error(int code) -> std::error_code {
+  return {code, std::generic_category()};
+}
+}  // namespace
+
+MemoryBackend::MemoryBackend() {
+  // запись узла — 24 байта: миллион узлов умещается в ~24 МБ плюс таблица
+  static_assert(sizeof(Node) <= 24, "MemoryBackend::Node grew");
+  m_nodes.emplace_back();
+  m_nodes[0].m_name = m_strings.intern("");
+}
+
+auto MemoryBackend::add_dir(std::string_view path) -> bool {
+  return !path.empty() && path[0] == '/' && make_dirs(path) != NONE;
+}
+
+auto MemoryBackend::add_file(std::string_view path, std::string_view content)
+    -> bool {
+  std::string_view name;
+  const Index DIR = make_parent(path, name);
+  if (DIR == NONE) {
+    return false;
+  }
+  Index node = child(DIR, name);
+  if (node == NONE) {
+    node = add_node(DIR, name, DT_REG);
+  } else if (m_nodes[node].m_type != DT_REG) {
+    return false;
+  }
+  m_nodes[node].m_data = m_strings.intern(content);
+  return true;
+}
+
+auto MemoryBackend::add_symlink(std::string_view path, std::string_view target)
+    -> bool {
+  std::string_view name;
+  const Index DIR = make_parent(path, name);
+  if (DIR == NONE || child(DIR, name) != NONE) {
+    return false;
+  }
+  const auto DATA = m_strings.intern(target);
+  m_nodes[add_node(DIR, name, DT_LNK)].m_data = DATA;
+  return true;
+}
+
+auto MemoryBackend::index_bytes() const -> size_t {
+  return m_nodes.capacity() * sizeof(Node) +
+         m_slots.capacity() * sizeof(Index);
+}
+
+auto MemoryBackend::list(const std::string& dir, std::vector<DirEntry>& out,
+                         std::error_code& error) const -> bool {
+  out.clear();
+  const Index NODE = lookup(dir, true, error);
+  if (NODE == NONE) {
+    return false;
+  }
+  if (m_nodes[NODE].m_type != DT_DIR) {
+    error = make_error(ENOTDIR);
+    return false;
+  }
+  for (Index cur = m_nodes[NODE].m_first_child; cur != NONE;
+       cur = m_nodes[cur].m_next_sibling) {
+    DirEntry entry;
+    entry.m_name = m_strings.view(m_nodes[cur].m_name);
+    entry.m_type = m_nodes[cur].m_type;
+    entry.m_inode = cur + 1;
+    out.push_back(std::move(entry));
+  }
+  // дети хранятся в обратном порядке добавления
+  std::reverse(out.begin(), out.end());
+  return true;
+}
+
+auto MemoryBackend::stat(const std::string& path, Stat& out, bool follow,
+                         std::error_code& error) const -> bool {
+  const Index NODE = lookup(path, follow, error);
+  if (NODE == NONE) {
+    return false;
+  }
+  const auto& node = m_nodes[NODE];
+  out.m_type = node.m_type;
+  out.m_inode = NODE + 1;
+  out.m_size = node.m_type == DT_DIR ? 0 : m_strings.view(node.m_data).size();
+  return true;
+}
+
+auto MemoryBackend::readlink(const std::string& path, std::string& out,
+                             std::error_code& error) const -> bool {
+  out.clear();
+  const Index NODE = lookup(path, false, error);
+  if (NODE == NONE) {
+    return false;
+  }
+  if (m_nodes[NODE].m_type != DT_LNK) {
+    error = make_error(EINVAL);
+    return false;
+  }
+  out = m_strings.view(m_nodes[NODE].m_data);
+  return true;
+}
+
+auto MemoryBackend::realpath(const std::string& path,
+                             std::error_code& error) const -> std::string {
+  Index node = lookup(path, true, error);
+  if (node == NONE) {
+    return {};
+  }
+  if (node == 0) {
+    return "/";
+  }
+  std::vector<Index> chain;
+  for (; node != 0; node = m_nodes[node].m_parent) {
+    chain.push_back(node);
+  }
+  std::string out;
+  for (auto iter = chain.rbegin(); iter != chain.rend(); ++iter) {
+    out += '/';
+    out += m_strings.view(m_nodes[*iter].m_name);
+  }
+  return out;
+}
+
+auto MemoryBackend::read_attr(const std::string& path, std::string& out,
+                              std::error_code& error) const -> bool {
+  out.clear();
+  const Index NODE = lookup(path, true, error);
+  if (NODE == NONE) {
+    return false;
+  }
+  if (m_nodes[NODE].m_type == DT_DIR) {
+    error = make_error(EISDIR);
+    return false;
+  }
+  out = m_strings.view(m_nodes[NODE].m_data);
+  return true;
+}
+
+auto MemoryBackend::child(Index dir, std::string_view name) const -> Index {
+  const auto NAME = m_strings.find(name);
+  if (!NAME || m_slots.empty()) {
+    return NONE;
+  }
+  return m_slots[slot_of(dir, *NAME)];
+}
+
+auto MemoryBackend::walk(Index start, std::string_view path, bool follow_last,
+                         int& hops, std::error_code& error) const -> Index {
+  Index cur = !path.empty() && path[0] == '/' ? 0 : start;
+  size_t pos = 0;
+  while (pos < path.size()) {
+    auto end = path.find('/', pos);
+    if (end == std::string_view::npos) {
+      end = path.size();
+    }
+    const auto NAME = path.substr(pos, end - pos);
+    const bool LAST =
+        path.find_first_not_of('/', end) == std::string_view::npos;
+    pos = end + 1;
+    if (NAME.empty() || NAME == ".") {
+      continue;
+    }
+    if (m_nodes[cur].m_type != DT_DIR) {
+      error = make_error(ENOTDIR);
+      return NONE;
+    }
+    if (NAME == "..") {
+      cur = m_nodes[cur].m_parent;
+      continue;
+    }
+    Index next = child(cur, NAME);
+    if (next == NONE) {
+      error = make_error(ENOENT);
+      return NONE;
+    }
+    if (m_nodes[next].m_type == DT_LNK && (!LAST || follow_last)) {
+      if (++hops > MAX_SYMLINKS) {
+        error = make_error(ELOOP);
+        return NONE;
+      }
+      // относительная цель — от каталога самой ссылки
+      next = walk(cur, m_strings.view(m_nodes[next].m_data), true, hops,
+                  error);
+      if (next == NONE) {
+        return NONE;
+      }
+    }
+    cur = next;
+  }
+  error.clear();
+  return cur;
+}
+
+auto MemoryBackend::lookup(std::string_view path, bool follow_last,
+                           std::error_code& error) const -> Index {
+  if (path.empty()) {
+    error = make_error(ENOENT);
+    return NONE;
+  }
+  int hops = 0;
+  return walk(0, path, follow_last, hops, error);
+}
+
+auto MemoryBackend::make_dirs(std::string_view path) -> Index {
+  Index cur = 0;
+  size_t pos = 0;
+  while (pos < path.size()) {
+    auto end = path.find('/', pos);
+    if (end == std::string_view::npos) {
+      end = path.size();
+    }
+    const auto NAME = path.substr(pos, end - pos);
+    pos = end + 1;
+    if (NAME.empty() || NAME == ".") {
+      continue;
+    }
+    if (NAME == "..") {
+      cur = m_nodes[cur].m_parent;
+      continue;
+    }
+    Index next = child(cur, NAME);
+    if (next == NONE) {
+      next = add_node(cur, NAME, DT_DIR);
+    } else if (m_nodes[next].m_type == DT_LNK) {
+      // как mkdir -p: существующая ссылка на каталог проходится насквозь
+      std::error_code error;
+      int hops = 0;
+      next = walk(cur, m_strings.view(m_nodes[next].m_data), true, hops,
+                  error);
+      if (next == NONE) {
+        return NONE;
+      }
+    }
+    if (m_nodes[next].m_type != DT_DIR) {
+      return NONE;
+    }
+    cur = next;
+  }
+  return cur;
+}
+
+auto MemoryBackend::add_node(Index dir, std::string_view name,
+                             unsigned char type) -> Index {
+  const auto INDEX = static_cast<Index>(m_nodes.size());
+  Node node;
+  node.m_parent = dir;
+  node.m_name = m_strings.intern(name);
+  node.m_type = type;
+  node.m_next_sibling = m_nodes[dir].m_first_child;
+  m_nodes.push_back(node);
+  m_nodes[dir].m_first_child = INDEX;
+
+  // заполнение таблицы не выше 1/2
+  if (m_slots.size() < 2 * m_nodes.size()) {
+    grow_slots();
+  } else {
+    m_slots[slot_of(dir, node.m_name)] = INDEX;
+  }
+  return INDEX;
+}
+
+auto MemoryBackend::make_parent(std::string_view path, std::string_view& name)
+    -> Index {
+  if (path.empty() || path[0] != '/') {
+    return NONE;
+  }
+  const auto SLASH = path.find_last_of('/');
+  name = path.substr(SLASH + 1);
+  if (name.empty() || name == "." || name == "..") {
+    return NONE;
+  }
+  return make_dirs(path.substr(0, SLASH));
+}
+
+auto MemoryBackend::slot_of(Index dir, StringPool::Id name) const -> size_t {
+  // splitmix64 от пары (родитель, имя)
+  uint64_t key = (static_cast<uint64_t>(dir) << 32U) | name;
+  key ^= key >> 30U;
+  key *= 0xbf58476d1ce4e5b9ULL;
+  key ^= key >> 27U;
+  key *= 0x94d049bb133111ebULL;
+  key ^= key >> 31U;
+  const size_t MASK = m_slots.size() - 1;
+  for (size_t slot = key & MASK;; slot = (slot + 1) & MASK) {
+    const Index NODE = m_slots[slot];
+    if (NODE == NONE ||
+        (m_nodes[NODE].m_parent == dir && m_nodes[NODE].m_name == name)) {
+      return slot;
+    }
+  }
+}
+
+void MemoryBackend::grow_slots() {
+  m_slots.assign(std::max<size_t>(64, m_slots.size() * 2), NONE);
+  // корень не лежит в таблице: он ничей не ребёнок
+  for (Index i = 1; i < m_nodes.size(); ++i) {
+    m_slots[slot_of(m_nodes[i].m_parent, m_nodes[i].m_name)] = i;
+  }
+}
+}  // namespace fs_tools
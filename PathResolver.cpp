@@ -0,0 +1,96 @@
+#include "PathResolver.hpp"
+
+#include <cerrno>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include "EnumStats.hpp"
+
+namespace fs_tools {
+auto PathResolver::resolve(const std::string& path, std::string& out,
+                           std::error_code& error) -> bool {
+  if (path.empty() || path[0] != '/') {
+    out = m_backend->realpath(path, error);
+    return !error;
+  }
+  // свой же результат (или уже встречавшийся путь) — один поиск
+  if (const auto HIT = m_dentries.find(path); HIT != m_dentries.end()) {
+    out = HIT->second.empty() ? HIT->first : HIT->second;
+    error.clear();
+    return true;
+  }
+  out.clear();
+  int hops = 0;
+  if (!walk(path, out, hops, error)) {
+    out.clear();
+    return false;
+  }
+  if (out.empty()) {
+    out = "/";
+  }
+  error.clear();
+  return true;
+}
+
+auto PathResolver::walk(std::string_view path, std::string& cur, int& hops,
+                        std::error_code& error) -> bool {
+  size_t pos = 0;
+  while (pos < path.size()) {
+    auto end = path.find('/', pos);
+    if (end == std::string_view::npos) {
+      end = path.size();
+    }
+    const auto NAME = path.substr(pos, end - pos);
+    pos = end + 1;
+    if (NAME.empty() || NAME == ".") {
+      continue;
+    }
+    if (NAME == "..") {
+      // префикс канонический — родитель просто отрезается
+      const auto SLASH = cur.find_last_of('/');
+      cur.resize(SLASH == std::string::npos ? 0 : SLASH);
+      continue;
+    }
+
+    // ключ строится прямо в cur: попадание без аллокаций
+    const size_t DIR_SIZE = cur.size();
+    cur += '/';
+    cur += NAME;
+    if (const auto HIT = m_dentries.find(cur); HIT != m_dentries.end()) {
+      if (HIT->second == "/") {
+        cur.clear();
+      } else if (!HIT->second.empty()) {
+        cur = HIT->second;
+      }
+      continue;
+    }
+
+    // промах: один readlink вместо lstat каждого компонента
+    FS_TOOLS_STATS_ADD(m_readlink_calls, 1);
+    if (!m_backend->readlink(cur, m_target, error)) {
+      if (error != std::errc::invalid_argument) {
+        return false;  // ENOENT, ENOTDIR, ...
+      }
+      // не ссылка — путь уже канонический
+      m_dentries.emplace(cur, std::string());
+      continue;
+    }
+    if (++hops > MAX_SYMLINKS) {
+      error = std::error_code(ELOOP, std::generic_category());
+      return false;
+    }
+    std::string key = cur;
+    // m_target переиспользуется вложенным walk
+    const std::string TARGET = std::move(m_target);
+    // относительная цель — от канонического каталога самой ссылки
+    cur.resize(!TARGET.empty() && TARGET[0] == '/' ? 0 : DIR_SIZE);
+    if (!walk(TARGET, cur, hops, error)) {
+      return false;
+    }
+    m_dentries.emplace(std::move(key), cur.empty() ? std::string("/") : cur);
+  }
+  return true;
+}
+}  // namespace fs_tools
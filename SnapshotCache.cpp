@@ -0,0 +1,410 @@
+#include "SnapshotCache.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "FunctionTable.hpp"
+#include "fs_tools.hpp"
+
+namespace fs_tools {
+using namespace std::string_literals;
+
+struct SnapshotCache::Row {
+  uint16_t m_vid;
+  uint16_t m_pid;
+  uint32_t m_usb_node;
+  uint32_t m_class_name;
+  uint32_t m_dev_name;
+};
+
+namespace {
+constexpr char MAGIC[8] = {'F', 'S', 'T', 'S', 'N', 'A', 'P', '\0'};
+constexpr size_t BOOT_ID_SIZE = 40;
+constexpr const char* BOOT_ID_PATH = "/proc/sys/kernel/random/boot_id";
+
+struct Header {
+  char m_magic[sizeof(MAGIC)];
+  uint32_t m_version;
+  uint32_t m_root_count;
+  uint32_t m_row_count;
+  uint32_t m_string_count;
+  uint64_t m_bytes_size;
+  char m_boot_id[BOOT_ID_SIZE];
+};
+
+/** Отпечаток одного корня: меняется при добавлении/удалении/пересоздании. */
+struct RootStamp {
+  uint64_t m_inode;
+  int64_t m_ctime_ns;
+  /** Сумма хешей (имя, d_ino) — не зависит от порядка readdir. */
+  uint64_t m_hash;
+  uint32_t m_entries;
+  /** Путь корня в таблице строк. */
+  uint32_t m_path;
+};
+
+static_assert(sizeof(Header) == 72, "cache header layout");
+static_assert(sizeof(RootStamp) == 32, "cache root stamp layout");
+
+auto mix(uint64_t value) -> uint64_t {
+  // splitmix64: соседние inode не должны гасить друг друга в сумме
+  value += 0x9e3779b97f4a7c15ULL;
+  value = (value ^ (value >> 30U)) * 0xbf58476d1ce4e5b9ULL;
+  value = (value ^ (value >> 27U)) * 0x94d049bb133111ebULL;
+  return value ^ (value >> 31U);
+}
+
+auto fnv1a(std::string_view str) -> uint64_t {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (const char CH : str) {
+    hash = (hash ^ static_cast<unsigned char>(CH)) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+auto stamp_root(const std::string& root) -> RootStamp {
+  RootStamp out{};
+  std::error_code error;
+  const auto DIR = DirHandle::open(root, error);
+  if (!DIR.valid()) {
+    return out;  // отсутствующий корень — нулевой отпечаток
+  }
+  struct stat stt {};
+  if (::fstat(DIR.fd(), &stt) == 0) {
+    out.m_inode = static_cast<uint64_t>(stt.st_ino);
+    out.m_ctime_ns = static_cast<int64_t>(stt.st_ctim.tv_sec) * 1000000000LL +
+                     stt.st_ctim.tv_nsec;
+  }
+  for (const auto& entry : DIR.typed_entries()) {
+    out.m_hash += mix(fnv1a(entry.m_name) ^ entry.m_inode);
+    ++out.m_entries;
+  }
+  return out;
+}
+
+auto same_stamp(const RootStamp& first, const RootStamp& second) -> bool {
+  return first.m_inode == second.m_inode &&
+         first.m_ctime_ns == second.m_ctime_ns &&
+         first.m_hash == second.m_hash && first.m_entries == second.m_entries;
+}
+
+void boot_id(std::string& out) {
+  std::error_code error;
+  if (!read_attr(BOOT_ID_PATH, out, error)) {
+    out.clear();
+  }
+  while (!out.empty() && (out.back() == '\n' || out.back() == '\0')) {
+    out.pop_back();
+  }
+  out.resize(std::min(out.size(), BOOT_ID_SIZE - 1));
+}
+
+template <typename T>
+void append(std::string& out, const T& value) {
+  out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+auto write_file(const std::string& path, const std::string& data,
+                std::error_code& error) -> bool {
+  // пишем рядом и переименовываем: читатель видит старый файл или новый.
+  // Имя уникально (mkostemp) — параллельные rebuild() в одном процессе не
+  // обрезают временный файл друг друга
+  std::string tmp = path + ".tmp.XXXXXX";
+  const int FD = ::mkostemp(tmp.data(), O_CLOEXEC);
+  if (FD < 0) {
+    error = std::error_code(errno, std::generic_category());
+    return false;
+  }
+  ::fchmod(FD, 0644);
+  size_t done = 0;
+  while (done < data.size()) {
+    const auto WRITTEN = ::write(FD, data.data() + done, data.size() - done);
+    if (WRITTEN < 0 && errno == EINTR) {
+      continue;
+    }
+    if (WRITTEN <= 0) {
+      error =
+          std::error_code(errno != 0 ? errno : EIO, std::generic_category());
+      ::close(FD);
+      ::unlink(tmp.c_str());
+      return false;
+    }
+    done += static_cast<size_t>(WRITTEN);
+  }
+  if (::close(FD) != 0 || ::rename(tmp.c_str(), path.c_str()) != 0) {
+    error = std::error_code(errno, std::generic_category());
+    ::unlink(tmp.c_str());
+    return false;
+  }
+  error.clear();
+  return true;
+}
+}  // namespace
+
+auto SnapshotCache::open(const std::string& path, std::error_code& error,
+                         const std::string& dev_usb_root,
+                         const std::vector<std::string>& classRoots)
+    -> std::optional<SnapshotCache> {
+  const int FD = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (FD < 0) {
+    error = std::error_code(errno, std::generic_category());
+    return std::nullopt;
+  }
+  struct stat stt {};
+  if (::fstat(FD, &stt) != 0 ||
+      static_cast<size_t>(stt.st_size) < sizeof(Header)) {
+    ::close(FD);
+    error = std::make_error_code(std::errc::invalid_argument);
+    return std::nullopt;
+  }
+  const auto SIZE = static_cast<size_t>(stt.st_size);
+  void* map = ::mmap(nullptr, SIZE, PROT_READ, MAP_PRIVATE, FD, 0);
+  ::close(FD);
+  if (map == MAP_FAILED) {
+    error = std::error_code(errno, std::generic_category());
+    return std::nullopt;
+  }
+  SnapshotCache cache(map, SIZE);
+
+  // формат: магия, версия, размеры секций и границы строк
+  const auto* header = static_cast<const Header*>(map);
+  const auto* data = static_cast<const char*>(map);
+  const auto INVALID = [&error] {
+    error = std::make_error_code(std::errc::invalid_argument);
+    return std::nullopt;
+  };
+  if (std::memcmp(header->m_magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      header->m_version != VERSION) {
+    return INVALID();
+  }
+  const size_t ROOTS_AT = sizeof(Header);
+  const size_t ROWS_AT = ROOTS_AT + header->m_root_count * sizeof(RootStamp);
+  const size_t STRINGS_AT = ROWS_AT + header->m_row_count * sizeof(Row);
+  const size_t BYTES_AT =
+      STRINGS_AT + header->m_string_count * 2 * sizeof(uint32_t);
+  if (header->m_bytes_size > SIZE || BYTES_AT + header->m_bytes_size != SIZE) {
+    return INVALID();
+  }
+  cache.m_rows = reinterpret_cast<const Row*>(data + ROWS_AT);
+  cache.m_row_count = header->m_row_count;
+  cache.m_strings = reinterpret_cast<const uint32_t*>(data + STRINGS_AT);
+  cache.m_string_count = header->m_string_count;
+  cache.m_bytes = data + BYTES_AT;
+  for (size_t i = 0; i < cache.m_string_count; ++i) {
+    const uint64_t END =
+        uint64_t{cache.m_strings[2 * i]} + cache.m_strings[2 * i + 1];
+    if (END > header->m_bytes_size) {
+      return INVALID();
+    }
+  }
+  const auto* roots = reinterpret_cast<const RootStamp*>(data + ROOTS_AT);
+  for (size_t i = 0; i < header->m_root_count; ++i) {
+    if (roots[i].m_path >= cache.m_string_count) {
+      return INVALID();
+    }
+  }
+  for (size_t i = 0; i < cache.m_row_count; ++i) {
+    const auto& row = cache.m_rows[i];
+    if (std::max({row.m_usb_node, row.m_class_name, row.m_dev_name}) >=
+        cache.m_string_count) {
+      return INVALID();
+    }
+  }
+
+  // актуальность: та же загрузка ядра и те же корни без изменений
+  const auto STALE = [&error] {
+    error = std::error_code(ESTALE, std::generic_category());
+    return std::nullopt;
+  };
+  std::string boot;
+  boot_id(boot);
+  if (std::string_view(header->m_boot_id,
+                       ::strnlen(header->m_boot_id, BOOT_ID_SIZE)) != boot ||
+      header->m_root_count != classRoots.size() + 1) {
+    return STALE();
+  }
+  for (size_t i = 0; i < header->m_root_count; ++i) {
+    const auto& root = i == 0 ? dev_usb_root : classRoots[i - 1];
+    if (cache.string(roots[i].m_path) != root ||
+        !same_stamp(roots[i], stamp_root(root))) {
+      return STALE();
+    }
+  }
+
+  error.clear();
+  return cache;
+}
+
+auto SnapshotCache::rebuild(const std::string& path, std::error_code& error,
+                            const std::string& dev_usb_root,
+                            const std::vector<std::string>& classRoots)
+    -> DeviceSnapshot {
+  // отпечатки до обхода: изменение во время обхода сделает файл устаревшим
+  std::vector<std::string> roots{dev_usb_root};
+  roots.insert(roots.end(), classRoots.begin(), classRoots.end());
+  std::vector<RootStamp> stamps;
+  stamps.reserve(roots.size());
+  for (const auto& root : roots) {
+    stamps.push_back(stamp_root(root));
+  }
+  auto snapshot = DeviceSnapshot::capture(dev_usb_root, classRoots);
+
+  StringPool pool;
+  for (size_t i = 0; i < roots.size(); ++i) {
+    stamps[i].m_path = pool.intern(roots[i]);
+  }
+  const auto& TABLE = snapshot.table();
+  std::vector<Row> rows;
+  rows.reserve(TABLE.size());
+  for (const auto& row : TABLE.rows()) {
+    rows.push_back({row.m_id.m_vid, row.m_id.m_pid,
+                    pool.intern(TABLE.pool().view(row.m_usb_node)),
+                    pool.intern(TABLE.pool().view(row.m_class_name)),
+                    pool.intern(TABLE.pool().view(row.m_dev_name))});
+  }
+
+  Header header{};
+  std::memcpy(header.m_magic, MAGIC, sizeof(MAGIC));
+  header.m_version = VERSION;
+  header.m_root_count = static_cast<uint32_t>(stamps.size());
+  header.m_row_count = static_cast<uint32_t>(rows.size());
+  header.m_string_count = static_cast<uint32_t>(pool.size());
+  std::string boot;
+  boot_id(boot);
+  std::memcpy(header.m_boot_id, boot.data(), boot.size());
+
+  std::string bytes;
+  std::vector<uint32_t> refs;
+  refs.reserve(2 * pool.size());
+  for (StringPool::Id id = 0; id < pool.size(); ++id) {
+    const auto VIEW = pool.view(id);
+    refs.push_back(static_cast<uint32_t>(bytes.size()));
+    refs.push_back(static_cast<uint32_t>(VIEW.size()));
+    bytes.append(VIEW);
+  }
+  header.m_bytes_size = bytes.size();
+
+  std::string out;
+  out.reserve(sizeof(header) + stamps.size() * sizeof(RootStamp) +
+              rows.size() * sizeof(Row) + refs.size() * sizeof(uint32_t) +
+              bytes.size());
+  append(out, header);
+  for (const auto& stamp : stamps) {
+    append(out, stamp);
+  }
+  for (const auto& row : rows) {
+    append(out, row);
+  }
+  for (const auto REF : refs) {
+    append(out, REF);
+  }
+  out += bytes;
+  write_file(path, out, error);
+  return snapshot;
+}
+
+SnapshotCache::SnapshotCache(void* map, size_t size)
+    : m_map(map), m_size(size) {}
+
+SnapshotCache::SnapshotCache(SnapshotCache&& other) noexcept
+    : m_map(std::exchange(other.m_map, nullptr)),
+      m_size(std::exchange(other.m_size, 0)),
+      m_rows(std::exchange(other.m_rows, nullptr)),
+      m_row_count(std::exchange(other.m_row_count, 0)),
+      m_strings(std::exchange(other.m_strings, nullptr)),
+      m_string_count(std::exchange(other.m_string_count, 0)),
+      m_bytes(std::exchange(other.m_bytes, nullptr)) {}
+
+auto SnapshotCache::operator=(SnapshotCache&& other) noexcept
+    -> SnapshotCache& {
+  if (this != &other) {
+    reset();
+    m_map = std::exchange(other.m_map, nullptr);
+    m_size = std::exchange(other.m_size, 0);
+    m_rows = std::exchange(other.m_rows, nullptr);
+    m_row_count = std::exchange(other.m_row_count, 0);
+    m_strings = std::exchange(other.m_strings, nullptr);
+    m_string_count = std::exchange(other.m_string_count, 0);
+    m_bytes = std::exchange(other.m_bytes, nullptr);
+  }
+  return *this;
+}
+
+SnapshotCache::~SnapshotCache() { reset(); }
+
+void SnapshotCache::reset() {
+  if (m_map != nullptr) {
+    ::munmap(m_map, m_size);
+    m_map = nullptr;
+  }
+}
+
+auto SnapshotCache::string(uint32_t id) const -> std::string_view {
+  return {m_bytes + m_strings[2 * id], m_strings[2 * id + 1]};
+}
+
+auto SnapshotCache::expand(const Row& row) const -> UsbFunction {
+  UsbFunction func;
+  func.m_id = SysFSHelper::UsbId{row.m_vid, row.m_pid};
+  func.m_vid = func.m_id.vid_string();
+  func.m_pid = func.m_id.pid_string();
+  func.m_usbNode = string(row.m_usb_node);
+  func.m_class_name = string(row.m_class_name);
+  func.m_dev_name = string(row.m_dev_name);
+  func.m_dev_path = "/dev/"s + func.m_dev_name;
+  return func;
+}
+
+auto SnapshotCache::find(std::string_view dev_node) const
+    -> std::optional<UsbFunction> {
+  constexpr std::string_view DEV_PATH = "/dev/";
+  if (dev_node.substr(0, DEV_PATH.size()) == DEV_PATH) {
+    dev_node.remove_prefix(DEV_PATH.size());
+  }
+  const auto* end = m_rows + m_row_count;
+  const auto* iter = std::lower_bound(
+      m_rows, end, dev_node, [this](const Row& row, std::string_view name) {
+        return string(row.m_dev_name) < name;
+      });
+  if (iter == end || string(iter->m_dev_name) != dev_node) {
+    return std::nullopt;
+  }
+  return expand(*iter);
+}
+
+auto SnapshotCache::find_by_id(const std::string& vid_raw,
+                               const std::string& pid_raw) const
+    -> std::vector<UsbFunction> {
+  std::vector<UsbFunction> out;
+  const auto ID = SysFSHelper::UsbId::parse(vid_raw, pid_raw);
+  if (!ID) {
+    return out;
+  }
+  for (size_t i = 0; i < m_row_count; ++i) {
+    if (m_rows[i].m_vid == ID->m_vid && m_rows[i].m_pid == ID->m_pid) {
+      out.push_back(expand(m_rows[i]));
+    }
+  }
+  return out;
+}
+
+auto SnapshotCache::functions() const -> std::vector<UsbFunction> {
+  std::vector<UsbFunction> out;
+  out.reserve(m_row_count);
+  for (size_t i = 0; i < m_row_count; ++i) {
+    out.push_back(expand(m_rows[i]));
+  }
+  return out;
+}
+}  // namespace fs_tools
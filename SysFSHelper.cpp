@@ -1,277 +1,941 @@
 #include "SysFSHelper.hpp"
 
-#include <fstream>
+#include "BatchReader.hpp"
+#include "EnumStats.hpp"
+#include "FsBackend.hpp"
+#include "HotplugMonitor.hpp"
+#include "UsbDevice.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
 #include <set>
 #include <string>
+#include <string_view>
 #include <system_error>
+#include <thread>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 namespace fs_tools {
 using namespace std::string_literals;
 
-auto SysFSHelper::list_functions(const std::string& /*dev_usb_root*/,
+auto SysFSHelper::list_functions(const std::string& dev_usb_root,
                                  const std::vector<std::string>& classRoots)
     -> std::vector<UsbFunction> {
-  std::vector<UsbFunction> out;
+  return list_functions_at(FsBackend::posix(), dev_usb_root, classRoots);
+}
 
-  for (const auto& classRoot : classRoots) {
-    if (!path_exists(classRoot) || !is_dir(classRoot)) {
+auto SysFSHelper::list_functions(const ParallelOptions& options)
+    -> std::vector<UsbFunction> {
+  return list_functions(options, default_usb_root(), default_class_roots());
+}
+
+auto SysFSHelper::list_functions(const ParallelOptions& options,
+                                 const std::string& dev_usb_root,
+                                 const std::vector<std::string>& classRoots)
+    -> std::vector<UsbFunction> {
+  size_t threads = options.m_threads;
+  if (threads == 0) {
+    threads = std::max(1U, std::thread::hardware_concurrency());
+  }
+  return list_functions_at(FsBackend::posix(), dev_usb_root, classRoots,
+                           threads);
+}
+
+auto SysFSHelper::list_functions(const FsBackend& backend,
+                                 const std::string& dev_usb_root,
+                                 const std::vector<std::string>& classRoots)
+    -> std::vector<UsbFunction> {
+  return list_functions_at(backend, dev_usb_root, classRoots);
+}
+
+auto SysFSHelper::list_functions_at(const FsBackend& backend,
+                                    const std::string& sysUsbRoot,
+                                    const std::vector<std::string>& classRoots,
+                                    size_t threads, const ScanFilter* filter)
+    -> std::vector<UsbFunction> {
+  // Реальная ФС: корень класса открываем один раз, элементы читаем
+  // относительно него; иной бэкенд — по путям
+  const bool POSIX = &backend == &FsBackend::posix();
+  const FsBackend* const BACKEND = POSIX ? nullptr : &backend;
+  std::vector<DirHandle> roots(classRoots.size());
+  // (индекс корня класса, имя элемента)
+  std::vector<std::pair<size_t, std::string>> items;
+  std::vector<DirEntry> entries;
+  std::error_code error;
+  for (size_t r = 0; r < classRoots.size(); ++r) {
+    // класс не подходит — корень даже не открываем
+    if (filter != nullptr && !filter->wants_class(classRoots[r])) {
       continue;
     }
-
-    for (const auto& entryPath : list_dirs(classRoot)) {
-      const std::string UEVENT = entryPath + "/uevent";
-      if (!path_exists(UEVENT)) {
+    {
+      FS_TOOLS_STATS_PHASE(READDIR);
+      if (POSIX) {
+        roots[r] = DirHandle::open(classRoots[r], error);
+        if (!roots[r].valid()) {
+          continue;
+        }
+        entries = roots[r].typed_entries();
+      } else if (!backend.list(classRoots[r], entries, error)) {
         continue;
       }
-
-      std::string content;
-      if (!read_file(UEVENT, content)) {
-        continue;
+    }
+    FS_TOOLS_STATS_ADD(m_dirs_opened, 1);
+    // элементы классов — симлинки (или каталоги); d_type из readdir
+    // отсекает остальное без stat
+    for (auto& entry : entries) {
+      if (entry.is_symlink() || entry.is_dir()) {
+        items.emplace_back(r, std::move(entry.m_name));
       }
+    }
+  }
 
-      // DEVNAME
-      std::string devname;
-      {
-        size_t pos = 0;
-        while (true) {
-          auto eol = content.find('\n', pos);
-          if (std::string line = content.substr(
-                  pos, (eol == std::string::npos ? content.size() : eol) - pos);
-              line.rfind("DEVNAME="s, 0) == 0) {
-            devname = line.substr(size("DEVNAME="s));
-            break;
-          }
-          if (eol == std::string::npos) {
-            break;
-          }
-          pos = eol + 1;
-        }
+  // uevent всех элементов — пакетом через io_uring, если он есть; иначе
+  // каждый поток читает свои сам
+  std::vector<BatchReader::Item> uevents;
+  if (POSIX && items.size() >= BatchReader::MIN_BATCH) {
+    if (BatchReader reader; reader.uses_io_uring()) {
+      uevents.resize(items.size());
+      for (size_t i = 0; i < items.size(); ++i) {
+        uevents[i].m_dirfd = roots[items[i].first].fd();
+        uevents[i].m_name = items[i].second + "/uevent";
       }
-      if (devname.empty()) {
-        continue;
+      FS_TOOLS_STATS_PHASE(READ);
+      const size_t READ_OK = reader.read_all(uevents);
+      FS_TOOLS_STATS_ADD(m_files_read, READ_OK);
+      for (const auto& uevent : uevents) {
+        FS_TOOLS_STATS_ADD(m_bytes_read, uevent.m_content.size());
       }
+    }
+  }
 
-      // Разыменовать device → подняться к USB и взять VID:PID
-      const std::string DEVICE_LINK = entryPath + "/device";
-      if (!path_exists(DEVICE_LINK)) {
-        continue;
+  // Каждый элемент — независимая блокирующая работа (uevent, realpath,
+  // подъём к USB); результат кладём в его слот, поэтому порядок не зависит
+  // от планирования. Кэш предков у каждого потока свой — без блокировок.
+  std::vector<std::optional<UsbFunction>> slots(items.size());
+  std::atomic<size_t> next{0};
+#ifdef FS_TOOLS_STATS
+  EnumStats* const STATS = EnumStats::current();
+#endif
+  auto worker = [&] {
+#ifdef FS_TOOLS_STATS
+    const EnumStats::Scope SCOPE(STATS);  // потоки пула пишут туда же
+#endif
+    // функции одного составного устройства делят предков — каждый uevent
+    // предка читаем один раз за проход
+    AncestorCache ancestors(backend);
+    std::string content;
+    while (true) {
+      const size_t BEGIN = next.fetch_add(PARALLEL_CHUNK);
+      if (BEGIN >= items.size()) {
+        break;
       }
-      std::error_code error;
-      auto node = fs_tools::canonical_path(DEVICE_LINK, error);
-      if (error || node.empty()) {
-        continue;
+      const size_t END = std::min(BEGIN + PARALLEL_CHUNK, items.size());
+      for (size_t i = BEGIN; i < END; ++i) {
+        const auto& [root, name] = items[i];
+        const auto& classRoot = classRoots[root];
+        std::string_view uevent;
+        if (!uevents.empty()) {
+          if (!uevents[i].m_error) {
+            uevent = uevents[i].m_content;
+          }
+        } else if (POSIX ? read_file_at(roots[root].fd(), name + "/uevent",
+                                        content)
+                         : read_file(BACKEND,
+                                     join_path(classRoot, name) + "/uevent",
+                                     content)) {
+          uevent = content;
+        }
+        const auto EVENT = Uevent::parse(uevent, Uevent::DEVNAME);
+        if (EVENT.m_devname.empty()) {
+          FS_TOOLS_STATS_ADD(m_dropped_no_devname, 1);
+          continue;
+        }
+        // имя узла не подходит — без realpath и подъёма к USB-предку
+        if (filter != nullptr && !filter->wants_dev_name(EVENT.m_devname)) {
+          continue;
+        }
+        slots[i] = resolve_function(classRoot, join_path(classRoot, name),
+                                    EVENT.m_devname, &ancestors, BACKEND);
+        if (slots[i] && filter != nullptr &&
+            !filter->wants_function(*slots[i])) {
+          slots[i].reset();
+        }
       }
+    }
+  };
 
-      auto vid_pid = usb_ids_for(node);
-      if (!vid_pid) {
-        continue;
-      }
+  threads = std::min(threads, (items.size() + PARALLEL_CHUNK - 1) /
+                                  PARALLEL_CHUNK);
+  if (threads <= 1) {
+    worker();
+  } else {
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (size_t i = 1; i < threads; ++i) {
+      pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : pool) {
+      thread.join();
+    }
+  }
 
-      UsbFunction func;
-      func.m_vid = vid_pid->first;
-      func.m_pid = vid_pid->second;
-      func.m_usbNode = node;
+  // Отбор по корню USB — только для явно переданного: в стандартном и так
+  // всё, а его разбор стоил бы readlink на каждое устройство. Нечитаемый
+  // корень — без отбора
+  std::unordered_set<std::string> usb_nodes;
+  bool scoped = !sysUsbRoot.empty() && sysUsbRoot != default_usb_root();
+  if (scoped) {
+    FS_TOOLS_STATS_PHASE(READDIR);
+    scoped = backend.list(sysUsbRoot, entries, error);
+  }
+  if (scoped) {
+    FS_TOOLS_STATS_ADD(m_dirs_opened, 1);
+    FS_TOOLS_STATS_PHASE(REALPATH);
+    AncestorCache resolver(backend);
+    for (const auto& entry : entries) {
+      auto node = canonical(join_path(sysUsbRoot, entry.m_name), &resolver,
+                            BACKEND, error);
+      if (!error && !node.empty()) {
+        usb_nodes.insert(std::move(node));
+      }
+    }
+  }
+  auto in_scope = [&usb_nodes](const std::string& node) {
+    if (usb_nodes.count(node) != 0) {
+      return true;  // обычно m_usbNode — сам интерфейс или устройство
+    }
+    for (auto slash = node.find_last_of('/');
+         slash != 0 && slash != std::string::npos;
+         slash = node.find_last_of('/', slash - 1)) {
+      if (usb_nodes.count(node.substr(0, slash)) != 0) {
+        return true;
+      }
+    }
+    return false;
+  };
 
-      auto slash = classRoot.find_last_of('/');
-      func.m_class_name =
-          slash == std::string::npos ? classRoot : classRoot.substr(slash + 1);
-      func.m_dev_name = devname;
-      func.m_dev_path = "/dev/" + devname;
-      out.push_back(std::move(func));
+  std::vector<UsbFunction> out;
+  out.reserve(slots.size());
+  for (auto& slot : slots) {
+    if (slot && (!scoped || in_scope(slot->m_usbNode))) {
+      out.push_back(std::move(*slot));
     }
   }
+  sort_unique(out);
+  return out;
+}
+
+auto SysFSHelper::for_each_function(const Visitor& visitor,
+                                    const std::vector<std::string>& classRoots,
+                                    bool dedup) -> size_t {
+  return for_each_function(visitor, classRoots, dedup, nullptr);
+}
 
-  // dedup по devPath (бывают дубли через разные симлинки)
-  std::sort(out.begin(), out.end(), [](const auto& first, const auto& second) {
-    if (first.m_dev_path != second.m_dev_path) {
-      return first.m_dev_path < second.m_dev_path;
+auto SysFSHelper::for_each_function(const Visitor& visitor,
+                                    const std::vector<std::string>& classRoots,
+                                    bool dedup, const ScanFilter* filter)
+    -> size_t {
+  AncestorCache ancestors;
+  // ключ дедупликации: dev path + VID:PID
+  std::unordered_set<std::string> seen;
+  std::string key;
+  size_t visited = 0;
+  std::error_code error;
+  for (const auto& classRoot : classRoots) {
+    if (filter != nullptr && !filter->wants_class(classRoot)) {
+      continue;
     }
-    if (first.m_vid != second.m_vid) {
-      return first.m_vid < second.m_vid;
+    const auto ROOT = DirHandle::open(classRoot, error);
+    if (!ROOT.valid()) {
+      continue;
     }
-    if (first.m_pid != second.m_pid) {
-      return first.m_pid < second.m_pid;
+    FS_TOOLS_STATS_ADD(m_dirs_opened, 1);
+    for (const auto& entry : ROOT.typed_entries()) {
+      if (!entry.is_symlink() && !entry.is_dir()) {
+        continue;
+      }
+      const auto FUNC = resolve_entry(ROOT, entry.m_name, &ancestors, filter);
+      if (!FUNC || (filter != nullptr && !filter->wants_function(*FUNC))) {
+        continue;
+      }
+      if (dedup) {
+        key = FUNC->m_dev_path;
+        key += '\0';
+        key += std::to_string(FUNC->m_id.key());
+        if (!seen.insert(key).second) {
+          continue;
+        }
+      }
+      ++visited;
+      if (!visitor(*FUNC)) {
+        return visited;
+      }
     }
-    return first.m_class_name < second.m_class_name;
-  });
-  out.erase(std::unique(out.begin(), out.end(),
-                        [](const auto& first, const auto& second) {
-                          return first.m_dev_path == second.m_dev_path &&
-                                 first.m_vid == second.m_vid &&
-                                 first.m_pid == second.m_pid;
-                        }),
-            out.end());
+  }
+  return visited;
+}
 
+auto SysFSHelper::find_by_id(const std::string& vid_raw,
+                             const std::string& pid_raw,
+                             const std::vector<std::string>& classRoots)
+    -> std::vector<UsbFunction> {
+  // USB-идентификаторы — 16-битный hex; иное не совпадёт ни с чем
+  const auto ID = UsbId::parse(vid_raw, pid_raw);
+  std::vector<UsbFunction> out;
+  if (!ID) {
+    return out;
+  }
+  // копируем только совпадения; порядок и дедупликация — как у
+  // list_functions
+  for_each_function(
+      [&](const UsbFunction& func) {
+        if (func.m_id == *ID) {
+          out.push_back(func);
+        }
+        return true;
+      },
+      classRoots, false);
+  sort_unique(out);
   return out;
 }
 
-auto SysFSHelper::find_by_id(const std::string& vid_raw,
-                             const std::string& pid_raw)
+auto SysFSHelper::find_first_by_id(const std::string& vid_raw,
+                                   const std::string& pid_raw,
+                                   const std::vector<std::string>& classRoots)
+    -> std::optional<UsbFunction> {
+  const auto ID = UsbId::parse(vid_raw, pid_raw);
+  std::optional<UsbFunction> out;
+  if (!ID) {
+    return out;
+  }
+  for_each_function(
+      [&](const UsbFunction& func) {
+        if (func.m_id != *ID) {
+          return true;
+        }
+        out = func;
+        return false;
+      },
+      classRoots, false);
+  return out;
+}
+
+auto SysFSHelper::find_by_serial(const std::string& vid_raw,
+                                 const std::string& pid_raw,
+                                 const std::string& serial,
+                                 const std::vector<std::string>& classRoots)
     -> std::vector<UsbFunction> {
-  const auto VID = normalize_id(vid_raw);
-  const auto PID = normalize_id(pid_raw);
   std::vector<UsbFunction> out;
-  for (auto& func : list_functions()) {
-    if (func.m_vid == VID && func.m_pid == PID) {
-      out.push_back(func);
-    }
+  const auto ID = UsbId::parse(vid_raw, pid_raw);
+  if (!ID) {
+    return out;
   }
+  // серийник читается один раз на USB-устройство, а не на каждую функцию
+  std::unordered_map<std::string, bool> matched;
+  for_each_function(
+      [&](const UsbFunction& func) {
+        if (func.m_id != *ID) {
+          return true;
+        }
+        const UsbDevice DEVICE(func);
+        auto [iter, inserted] = matched.try_emplace(DEVICE.path(), false);
+        if (inserted) {
+          iter->second = DEVICE.serial() == serial;
+        }
+        if (iter->second) {
+          out.push_back(func);
+        }
+        return true;
+      },
+      classRoots);
+  sort_unique(out);
   return out;
 }
 
-auto SysFSHelper::find(std::string dev_node) -> std::optional<UsbFunction> {
+auto SysFSHelper::find(std::string dev_node,
+                       const std::vector<std::string>& classRoots)
+    -> std::optional<UsbFunction> {
   // принять как "/dev/ttyUSB0" или "ttyUSB0" или "snd/controlC0"
   auto dev_path = "/dev/"s;
   if (dev_node.rfind(dev_path, 0) == 0) {
     dev_node = dev_node.substr(size(dev_path));
   }
 
+  // быстрый путь: stat узла → st_rdev → /sys/dev/{char,block}/MAJOR:MINOR
+  if (auto fast = find_by_rdev(dev_node, classRoots);
+      fast.m_function || fast.m_error) {
+    return std::move(fast.m_function);
+  }
+
   // найти в известных классах: ищем элемент класса, чей uevent содержит
   // DEVNAME=<devNode> затем по его device-ссылке/иерархии поднимаемся до
   // USB-узла и читаем VID:PID
-  auto classes = default_class_roots();
-  for (const auto& classRoot : classes) {
-    if (!path_exists(classRoot) || !is_dir(classRoot)) {
+  std::string content;
+  std::error_code error;
+  for (const auto& classRoot : classRoots) {
+    const auto ROOT = DirHandle::open(classRoot, error);
+    if (!ROOT.valid()) {
       continue;
     }
-    for (const auto& entryPath : list_dir_fs(classRoot)) {
-      const std::string UEVENT = entryPath + "/uevent";
-      std::string content;
-      if (!path_exists(UEVENT) || !read_file(UEVENT, content)) {
+    FS_TOOLS_STATS_ADD(m_dirs_opened, 1);
+    for (const auto& name : ROOT.entries()) {
+      if (!read_file_at(ROOT.fd(), name + "/uevent", content)) {
         continue;
       }
 
       // Проверим DEVNAME=
-      bool match = false;
-      size_t pos = 0;
-      while (true) {
-        auto eol = content.find('\n', pos);
-        if (std::string line = content.substr(
-                pos, (eol == std::string::npos ? content.size() : eol) - pos);
-            line.rfind("DEVNAME="s, 0) == 0) {
-          if (auto val = line.substr(size("DEVNAME="s)); val == dev_node) {
-            match = true;
-          }
-          break;
-        }
-        if (eol == std::string::npos) {
-          break;
-        }
-        pos = eol + 1;
-      }
-      if (!match) {
+      if (const auto EVENT = Uevent::parse(content, Uevent::DEVNAME);
+          !EVENT.has(Uevent::DEVNAME) || EVENT.m_devname != dev_node) {
         continue;
       }
 
-      // symlink device -> …/usb… интерфейс/узел
-      const std::string DEVICE_LINK = entryPath + "/device";
-      if (!path_exists(DEVICE_LINK)) {
+      if (auto func = resolve_function(classRoot, join_path(classRoot, name),
+                                       dev_node)) {
+        return func;
+      }
+    }
+  }
+  return std::nullopt;
+}
+
+auto SysFSHelper::find_many(const std::vector<std::string>& dev_nodes,
+                            const std::vector<std::string>& classRoots)
+    -> std::vector<FindResult> {
+  std::vector<FindResult> results(dev_nodes.size());
+  AncestorCache ancestors;
+  // DEVNAME → индексы входа, ещё не найденные (одинаковые узлы — вместе)
+  std::unordered_map<std::string, std::vector<size_t>> pending;
+  const auto DEV_PATH = "/dev/"s;
+  for (size_t i = 0; i < dev_nodes.size(); ++i) {
+    auto name = dev_nodes[i];
+    if (name.rfind(DEV_PATH, 0) == 0) {
+      name.erase(0, DEV_PATH.size());
+    }
+    if (name.empty()) {
+      results[i].m_error = std::make_error_code(std::errc::invalid_argument);
+      continue;
+    }
+    pending[name].push_back(i);
+  }
+
+  auto resolve = [&](std::unordered_map<std::string,
+                                        std::vector<size_t>>::iterator iter,
+                     const UsbFunction& func) {
+    for (const size_t INDEX : iter->second) {
+      results[INDEX].m_function = func;
+    }
+    return pending.erase(iter);
+  };
+
+  // 1. быстрый путь через st_rdev для каждого узла; окончательный отказ
+  // тоже снимает узел со скана
+  for (auto iter = pending.begin(); iter != pending.end();) {
+    auto fast = find_by_rdev(iter->first, classRoots, &ancestors);
+    if (fast.m_function) {
+      iter = resolve(iter, *fast.m_function);
+    } else if (fast.m_error) {
+      for (const size_t INDEX : iter->second) {
+        results[INDEX].m_error = fast.m_error;
+      }
+      iter = pending.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+
+  // 2. остаток — один проход по корням классов
+  std::string content;
+  std::error_code error;
+  for (const auto& classRoot : classRoots) {
+    if (pending.empty()) {
+      break;
+    }
+    const auto ROOT = DirHandle::open(classRoot, error);
+    if (!ROOT.valid()) {
+      continue;
+    }
+    FS_TOOLS_STATS_ADD(m_dirs_opened, 1);
+    for (const auto& name : ROOT.entries()) {
+      if (!read_file_at(ROOT.fd(), name + "/uevent", content)) {
         continue;
       }
-      std::error_code error;
-      auto node = canonical_path(DEVICE_LINK, error);
-      if (error || node.empty()) {
+      const auto EVENT = Uevent::parse(content, Uevent::DEVNAME);
+      if (!EVENT.has(Uevent::DEVNAME)) {
         continue;
       }
-
-      auto vid_pid = usb_ids_for(node);
-      if (!vid_pid) {
+      auto iter = pending.find(std::string(EVENT.m_devname));
+      if (iter == pending.end()) {
         continue;
       }
+      if (auto func = resolve_function(classRoot, join_path(classRoot, name),
+                                       iter->first, &ancestors)) {
+        resolve(iter, *func);
+        if (pending.empty()) {
+          break;
+        }
+      }
+    }
+  }
 
-      UsbFunction func;
-      func.m_vid = vid_pid->first;
-      func.m_pid = vid_pid->second;
-      func.m_usbNode = node;
-      // classRoot like "/sys/class/tty" → take tail after last '/'
-      auto slash = classRoot.find_last_of('/');
-      func.m_class_name =
-          slash == std::string::npos ? classRoot : classRoot.substr(slash + 1);
-      func.m_dev_name = dev_node;
-      func.m_dev_path = "/dev/" + dev_node;
-      return func;
+  for (const auto& [name, indices] : pending) {
+    for (const size_t INDEX : indices) {
+      results[INDEX].m_error = std::make_error_code(std::errc::no_such_device);
     }
   }
-  return std::nullopt;
+  return results;
+}
+
+auto SysFSHelper::wait_for(const Predicate& predicate,
+                           std::chrono::milliseconds timeout,
+                           const std::vector<std::string>& classRoots)
+    -> std::optional<UsbFunction> {
+  return wait_for(-1, predicate, timeout, classRoots);
 }
 
-auto SysFSHelper::list_ids()
+auto SysFSHelper::wait_for(int uevent_fd, const Predicate& predicate,
+                           std::chrono::milliseconds timeout,
+                           const std::vector<std::string>& classRoots)
+    -> std::optional<UsbFunction> {
+  // только переданные корни: ни /sys/bus/usb, ни /sys/class здесь не нужны
+  auto probe = [&]() -> std::optional<UsbFunction> {
+    std::optional<UsbFunction> found;
+    for_each_function(
+        [&](const UsbFunction& func) {
+          if (predicate(func)) {
+            found = func;
+          }
+          return !found;
+        },
+        classRoots, false);
+    return found;
+  };
+  // события монитора уже ограничены classRoots
+  return wait_until(probe, predicate, timeout, classRoots, uevent_fd);
+}
+
+auto SysFSHelper::wait_for(const std::string& vid_raw,
+                           const std::string& pid_raw,
+                           std::chrono::milliseconds timeout)
+    -> std::optional<UsbFunction> {
+  const auto ID = UsbId::parse(vid_raw, pid_raw);
+  if (!ID) {
+    return std::nullopt;  // ничто не совпадёт — ждать нечего
+  }
+  return wait_for([&](const UsbFunction& func) { return func.m_id == *ID; },
+                  timeout);
+}
+
+auto SysFSHelper::wait_for(std::string dev_node,
+                           std::chrono::milliseconds timeout)
+    -> std::optional<UsbFunction> {
+  auto dev_path = "/dev/"s;
+  if (dev_node.rfind(dev_path, 0) == 0) {
+    dev_node = dev_node.substr(size(dev_path));
+  }
+  dev_path += dev_node;
+  return wait_until([&] { return find(dev_node); },
+                    [&](const UsbFunction& func) {
+                      return func.m_dev_path == dev_path;
+                    },
+                    timeout, default_class_roots(), -1,
+                    join_path(default_dev_root(), dev_node));
+}
+
+auto SysFSHelper::wait_until(
+    const std::function<std::optional<UsbFunction>()>& probe,
+    const Predicate& predicate, std::chrono::milliseconds timeout,
+    const std::vector<std::string>& classRoots, int uevent_fd,
+    const std::string& dev_path) -> std::optional<UsbFunction> {
+  const auto DEADLINE = std::chrono::steady_clock::now() + timeout;
+  auto remaining = [&DEADLINE] {
+    // вверх, чтобы не проснуться за долю миллисекунды до срока
+    return std::max(std::chrono::ceil<std::chrono::milliseconds>(
+                        DEADLINE - std::chrono::steady_clock::now()),
+                    std::chrono::milliseconds(0));
+  };
+
+  // Подписка до первичной проверки: устройство, появившееся между проверкой и
+  // ожиданием, придёт событием
+  std::optional<UsbFunction> found;
+  bool resync = false;
+  std::error_code error;
+  auto on_event = [&](const HotplugMonitor::Event& event) {
+    if (event.m_action == HotplugMonitor::Action::RESYNC) {
+      resync = true;
+    } else if (!found && event.m_action == HotplugMonitor::Action::ADDED &&
+               predicate(event.m_function)) {
+      found = event.m_function;
+    }
+  };
+  // DEVPATH событий разрешается в той sysfs, где лежат корни классов
+  std::string sys_root = "/sys";
+  if (!classRoots.empty()) {
+    if (const auto POS = classRoots.front().rfind("/class/");
+        POS != std::string::npos) {
+      sys_root = classRoots.front().substr(0, POS);
+    }
+  }
+  std::optional<HotplugMonitor> monitor;
+  if (uevent_fd < 0) {
+    monitor = HotplugMonitor::open(on_event, error, sys_root, classRoots);
+  } else if (const int FD = ::fcntl(uevent_fd, F_DUPFD_CLOEXEC, 0); FD >= 0) {
+    monitor = HotplugMonitor::adopt(FD, on_event, sys_root, classRoots);
+  }
+
+  // Узел может появиться в подкаталоге (/dev/snd, /dev/bus/usb/001),
+  // которого ещё нет: следим за ближайшим существующим каталогом узла и
+  // переставляем наблюдение после каждого пробуждения
+  const auto WATCH_DIR = dev_path.empty()
+                             ? default_dev_root()
+                             : dev_path.substr(0, dev_path.find_last_of('/'));
+  int inotify_fd = -1;
+  auto watch = [&inotify_fd, &WATCH_DIR] {
+    for (auto dir = WATCH_DIR; !dir.empty();
+         dir.resize(dir.find_last_of('/'))) {
+      if (::inotify_add_watch(inotify_fd, dir.c_str(),
+                              IN_CREATE | IN_MOVED_TO | IN_ATTRIB) >= 0) {
+        return true;
+      }
+    }
+    return false;
+  };
+  if (!monitor) {
+    // netlink недоступен (контейнер без CAP/namespace) — ждём изменений /dev
+    inotify_fd = ::inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (inotify_fd >= 0 && !watch()) {
+      ::close(inotify_fd);
+      inotify_fd = -1;
+    }
+  }
+
+  if (auto func = probe()) {
+    if (inotify_fd >= 0) {
+      ::close(inotify_fd);
+    }
+    return func;
+  }
+
+  while (!found && remaining().count() > 0) {
+    if (monitor) {
+      monitor->poll(remaining());
+      // нужное событие могло потеряться при переполнении
+      if (!found && std::exchange(resync, false)) {
+        found = probe();
+      }
+      continue;
+    }
+
+    pollfd pfd{};
+    pfd.fd = inotify_fd;
+    pfd.events = POLLIN;
+    // без netlink и inotify остаётся только редкая перепроверка
+    const auto WAIT = inotify_fd >= 0
+                          ? remaining()
+                          : std::min(remaining(), WAIT_FALLBACK_INTERVAL);
+    if (::poll(&pfd, inotify_fd >= 0 ? 1 : 0, static_cast<int>(WAIT.count())) <
+        0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    if (inotify_fd >= 0) {
+      std::array<char, 4096> events;
+      while (::read(inotify_fd, events.data(), events.size()) > 0) {
+      }
+      watch();  // возможно, появился каталог ближе к узлу
+    }
+    found = probe();
+  }
+
+  if (inotify_fd >= 0) {
+    ::close(inotify_fd);
+  }
+  return found;
+}
+
+auto SysFSHelper::list_ids(const std::string& sysUsbRoot)
     -> std::vector<std::pair<std::string, std::string>> {
-  return list_ids_at(default_usb_root());
+  return list_ids_at(sysUsbRoot);
 }
 
-auto SysFSHelper::normalize_id(std::string str) -> std::string {
-  str = to_lower(std::move(str));
+auto SysFSHelper::list_ids(const FsBackend& backend,
+                           const std::string& sysUsbRoot)
+    -> std::vector<std::pair<std::string, std::string>> {
+  if (&backend == &FsBackend::posix()) {
+    return list_ids_at(sysUsbRoot);
+  }
+  std::set<std::pair<std::string, std::string>> uniq;
+  std::vector<DirEntry> entries;
+  std::error_code error;
+  if (!backend.list(sysUsbRoot, entries, error)) {
+    return {};
+  }
+  FS_TOOLS_STATS_ADD(m_dirs_opened, 1);
+  std::string content;
+  for (const auto& entry : entries) {
+    if (std::string vid, pid;
+        (entry.is_symlink() || entry.is_dir()) &&
+        read_file(&backend, join_path(sysUsbRoot, entry.m_name) + "/uevent",
+                  content) &&
+        parse_ids_from_uevent(content, vid, pid) && !vid.empty() &&
+        !pid.empty()) {
+      uniq.emplace(std::move(vid), std::move(pid));
+    }
+  }
+  return {uniq.begin(), uniq.end()};
+}
+
+auto SysFSHelper::normalize_id(std::string_view str) -> std::string {
   if (str.size() > 2 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) {
-    str = str.substr(2);
+    str.remove_prefix(2);
   }
-  size_t iter = 0;
-  while (iter < str.size() && str[iter] == '0') {
-    ++iter;
+  while (!str.empty() && str.front() == '0') {
+    str.remove_prefix(1);
   }
-  str = str.substr(iter);
   if (str.empty()) {
-    str = "0";
+    return "0";
   }
-  return str;
+  // VID/PID не длиннее 4 символов — строка целиком в SSO, без кучи
+  std::string out(str.size(), '\0');
+  std::transform(str.begin(), str.end(), out.begin(),
+                 [](const unsigned char VAL) {
+                   return static_cast<char>(std::tolower(VAL));
+                 });
+  return out;
+}
+
+auto SysFSHelper::UsbId::parse(std::string_view vid, std::string_view pid)
+    -> std::optional<UsbId> {
+  auto parse_hex = [](std::string_view str) -> std::optional<uint16_t> {
+    if (str.size() > 2 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) {
+      str.remove_prefix(2);
+    }
+    if (str.empty()) {
+      return std::nullopt;
+    }
+    uint32_t value = 0;
+    for (const char CH : str) {
+      const int DIGIT = CH >= '0' && CH <= '9'   ? CH - '0'
+                        : CH >= 'a' && CH <= 'f' ? CH - 'a' + 10
+                        : CH >= 'A' && CH <= 'F' ? CH - 'A' + 10
+                                                 : -1;
+      if (DIGIT < 0) {
+        return std::nullopt;
+      }
+      value = value * 16U + static_cast<uint32_t>(DIGIT);
+      if (value > 0xffffU) {
+        return std::nullopt;
+      }
+    }
+    return static_cast<uint16_t>(value);
+  };
+  const auto VID = parse_hex(vid);
+  const auto PID = parse_hex(pid);
+  if (!VID || !PID) {
+    return std::nullopt;
+  }
+  return UsbId{*VID, *PID};
+}
+
+auto operator==(const SysFSHelper::UsbFunction& first,
+                const SysFSHelper::UsbFunction& second) -> bool {
+  return first.m_dev_path == second.m_dev_path &&
+         first.m_id == second.m_id &&
+         first.m_class_name == second.m_class_name;
+}
+
+auto operator<(const SysFSHelper::UsbFunction& first,
+               const SysFSHelper::UsbFunction& second) -> bool {
+  if (first.m_dev_path != second.m_dev_path) {
+    return first.m_dev_path < second.m_dev_path;
+  }
+  if (first.m_id != second.m_id) {
+    return first.m_id < second.m_id;
+  }
+  return first.m_class_name < second.m_class_name;
+}
+
+auto SysFSHelper::UsbId::vid_string() const -> std::string {
+  std::array<char, 8> buf{};
+  std::snprintf(buf.data(), buf.size(), "%x", static_cast<unsigned>(m_vid));
+  return buf.data();
+}
+
+auto SysFSHelper::UsbId::pid_string() const -> std::string {
+  std::array<char, 8> buf{};
+  std::snprintf(buf.data(), buf.size(), "%x", static_cast<unsigned>(m_pid));
+  return buf.data();
 }
 
 auto SysFSHelper::read_file(const std::string& path, std::string& out) -> bool {
-  std::ifstream stream(path);
-  if (!stream) {
+  return read_file_at(AT_FDCWD, path, out);
+}
+
+auto SysFSHelper::read_file_at(int dirfd, const std::string& name,
+                               std::string& out) -> bool {
+  FS_TOOLS_STATS_PHASE(READ);
+  std::error_code error;
+  if (!read_attr_at(dirfd, name.c_str(), out, error)) {
     return false;
   }
-  out.assign(std::istreambuf_iterator(stream),
-             std::istreambuf_iterator<char>());
+  FS_TOOLS_STATS_ADD(m_files_read, 1);
+  FS_TOOLS_STATS_ADD(m_bytes_read, out.size());
   return true;
 }
 
-auto SysFSHelper::parse_ids_from_uevent(const std::string& content,
-                                        std::basic_string<char>& out_vid,
-                                        std::string& out_pid) -> bool {
-  size_t pos = 0;
-  while (true) {
-    const auto EOL = content.find('\n', pos);
-    if (std::string line = content.substr(
-            pos, (EOL == std::string::npos ? content.size() : EOL) - pos);
-        line.rfind("PRODUCT="s, 0) == 0) {
-      auto val = line.substr(size("PRODUCT="s));
-      const auto STRING1 = val.find('/');
-      const auto STRING2 = STRING1 == std::string::npos
-                               ? std::string::npos
-                               : val.find('/', STRING1 + 1);
-      const std::string VID =
-          STRING1 == std::string::npos ? val : val.substr(0, STRING1);
-      const std::string PID =
-          STRING1 == std::string::npos ? ""
-          : STRING2 == std::string::npos
-              ? val.substr(STRING1 + 1)
-              : val.substr(STRING1 + 1, STRING2 - STRING1 - 1);
-      out_vid = normalize_id(VID);
-      out_pid = normalize_id(PID);
-      return true;
-    }
-    if (EOL == std::string::npos) {
-      break;
+auto SysFSHelper::read_file(const FsBackend* backend, const std::string& path,
+                            std::string& out) -> bool {
+  if (backend == nullptr) {
+    return read_file(path, out);
+  }
+  FS_TOOLS_STATS_PHASE(READ);
+  std::error_code error;
+  if (!backend->read_attr(path, out, error)) {
+    return false;
+  }
+  FS_TOOLS_STATS_ADD(m_files_read, 1);
+  FS_TOOLS_STATS_ADD(m_bytes_read, out.size());
+  return true;
+}
+
+auto SysFSHelper::Uevent::parse(std::string_view content, unsigned keys,
+                                char separator) -> Uevent {
+  struct Field {
+    std::string_view m_name;
+    Key m_key;
+    std::string_view Uevent::*m_member;
+  };
+  static constexpr std::array<Field, 11> FIELDS = {{
+      {"DEVNAME", DEVNAME, &Uevent::m_devname},
+      {"PRODUCT", PRODUCT, &Uevent::m_product},
+      {"MAJOR", MAJOR, &Uevent::m_major},
+      {"MINOR", MINOR, &Uevent::m_minor},
+      {"DEVTYPE", DEVTYPE, &Uevent::m_devtype},
+      {"DRIVER", DRIVER, &Uevent::m_driver},
+      {"BUSNUM", BUSNUM, &Uevent::m_busnum},
+      {"DEVNUM", DEVNUM, &Uevent::m_devnum},
+      {"ACTION", ACTION, &Uevent::m_action},
+      {"DEVPATH", DEVPATH, &Uevent::m_devpath},
+      {"SUBSYSTEM", SUBSYSTEM, &Uevent::m_subsystem},
+  }};
+
+  Uevent out;
+  keys &= ALL;
+  while (!content.empty() && (out.m_found & keys) != keys) {
+    const auto EOL = content.find(separator);
+    const auto LINE = content.substr(0, EOL);
+    content.remove_prefix(EOL == std::string_view::npos ? content.size()
+                                                        : EOL + 1);
+
+    const auto EQ = LINE.find('=');
+    if (EQ == std::string_view::npos) {
+      continue;
+    }
+    const auto NAME = LINE.substr(0, EQ);
+    for (const auto& field : FIELDS) {
+      if ((keys & ~out.m_found & field.m_key) != 0 && NAME == field.m_name) {
+        out.*field.m_member = LINE.substr(EQ + 1);
+        out.m_found |= field.m_key;
+        break;
+      }
     }
-    pos = EOL + 1;
   }
-  return false;
+  return out;
 }
 
-auto SysFSHelper::usb_ids_for(const std::string& start)
-    -> std::optional<std::pair<std::string, std::string>> {
-  std::error_code error;
-  std::string cur = canonical_path(start, error);
+auto SysFSHelper::parse_ids_from_uevent(std::string_view content,
+                                        std::string& out_vid,
+                                        std::string& out_pid) -> bool {
+  const auto EVENT = Uevent::parse(content, Uevent::PRODUCT);
+  return EVENT.has(Uevent::PRODUCT) &&
+         parse_ids_from_product(EVENT.m_product, out_vid, out_pid);
+}
+
+auto SysFSHelper::parse_ids_from_product(std::string_view product,
+                                         std::string& out_vid,
+                                         std::string& out_pid) -> bool {
+  // "vid/pid/bcd"; без '/' — только VID
+  const auto STRING1 = product.find('/');
+  const auto STRING2 = STRING1 == std::string_view::npos
+                           ? std::string_view::npos
+                           : product.find('/', STRING1 + 1);
+  const auto VID = product.substr(0, STRING1);
+  const auto PID =
+      STRING1 == std::string_view::npos
+          ? std::string_view{}
+          : product.substr(STRING1 + 1, STRING2 == std::string_view::npos
+                                            ? std::string_view::npos
+                                            : STRING2 - STRING1 - 1);
+  out_vid = normalize_id(VID);
+  out_pid = normalize_id(PID);
+  return true;
+}
+
+auto SysFSHelper::class_name_of(std::string_view classRoot) -> std::string {
+  // "/sys/class/tty/" → "tty": хвост после последнего '/', без завершающих
+  const auto END = classRoot.find_last_not_of('/');
+  if (END == std::string_view::npos) {
+    return {};
+  }
+  classRoot = classRoot.substr(0, END + 1);
+  const auto SLASH = classRoot.find_last_of('/');
+  return std::string(SLASH == std::string_view::npos
+                         ? classRoot
+                         : classRoot.substr(SLASH + 1));
+}
+
+auto SysFSHelper::canonical(const std::string& path, AncestorCache* cache,
+                            const FsBackend* backend, std::error_code& error)
+    -> std::string {
+  FS_TOOLS_STATS_ADD(m_realpath_calls, 1);
+  if (cache != nullptr) {
+    return cache->m_paths.resolve(path, error);
+  }
+  return backend == nullptr ? canonical_path(path, error)
+                            : backend->realpath(path, error);
+}
+
+auto SysFSHelper::usb_ids_for(const std::string& start,
+                              AncestorCache* cache, const FsBackend* backend)
+    -> std::optional<UsbAncestor> {
+  FS_TOOLS_STATS_PHASE(ANCESTOR_WALK);
+  // start уже канонический (его вернул resolve_function) — без realpath
+  std::string cur = start;
+  std::vector<std::string> visited;
+  std::optional<UsbAncestor> result;
+  bool complete = false;
+  // буфер переживает вызовы: без аллокации на каждый uevent
+  thread_local std::string content;
   for (size_t i = 0; i < MAX_DEV_NUMBER && !cur.empty(); ++i) {
-    if (const std::string UEVENT = cur + "/uevent"; path_exists(UEVENT)) {
-      if (std::string pid, content, vid;
-          read_file(UEVENT, content) &&
-          parse_ids_from_uevent(content, vid, pid)) {
-        if (!vid.empty() && !pid.empty()) {
-          return std::make_pair(vid, pid);
-        }
+    if (cache != nullptr) {
+      if (auto hit = cache->m_ids.find(cur); hit != cache->m_ids.end()) {
+        FS_TOOLS_STATS_ADD(m_cache_hits, 1);
+        result = hit->second;
+        complete = true;
+        break;
+      }
+      visited.push_back(cur);
+    }
+    FS_TOOLS_STATS_ADD(m_ancestor_levels, 1);
+    // отсутствующий uevent — просто ENOENT от open, отдельный lstat не нужен
+    if (std::string pid, vid; read_file(backend, cur + "/uevent", content) &&
+                              parse_ids_from_uevent(content, vid, pid)) {
+      if (const auto ID = UsbId::parse(vid, pid)) {
+        result = UsbAncestor{cur, *ID};
+        complete = true;
+        break;
       }
     }
     const auto SLASH = cur.find_last_of('/');
@@ -280,35 +944,229 @@ auto SysFSHelper::usb_ids_for(const std::string& start)
     }
     cur.erase(SLASH);
   }
-  return std::nullopt;
+
+  // результат верен для каждого пройденного каталога; «нет USB-предка»
+  // запоминаем, только если дошли до корня, а не упёрлись в MAX_DEV_NUMBER
+  complete = complete || cur.empty();
+  if (cache != nullptr && complete) {
+    for (auto& dir : visited) {
+      cache->m_ids.emplace(std::move(dir), result);
+    }
+  }
+  return result;
 }
 
 auto SysFSHelper::list_ids_at(const std::string& sysUsbRoot)
     -> std::vector<std::pair<std::string, std::string>> {
   std::set<std::pair<std::string, std::string>> uniq;
-  if (!path_exists(sysUsbRoot) || !is_dir(sysUsbRoot)) {
+  std::error_code error;
+  const auto ROOT = DirHandle::open(sysUsbRoot, error);
+  if (!ROOT.valid()) {
     return {};
   }
 
-  for (const auto& entryPath : list_dirs(sysUsbRoot)) {
-    if (!is_dir(entryPath)) {
-      continue;
-    }
-    const std::string UEVENT = entryPath + "/uevent";
-    if (!path_exists(UEVENT)) {
-      continue;
+  // элементы /sys/bus/usb/devices — симлинки на каталоги устройств, поэтому
+  // lstat-проверка is_dir() их отбрасывала; берём d_type из readdir, а
+  // симлинк не на каталог отсеет openat (ENOTDIR)
+  FS_TOOLS_STATS_ADD(m_dirs_opened, 1);
+  std::vector<BatchReader::Item> uevents;
+  {
+    FS_TOOLS_STATS_PHASE(READDIR);
+    for (auto& entry : ROOT.typed_entries()) {
+      if (entry.is_symlink() || entry.is_dir()) {
+        entry.m_name += "/uevent";
+        uevents.emplace_back();
+        uevents.back().m_dirfd = ROOT.fd();
+        uevents.back().m_name = std::move(entry.m_name);
+      }
     }
+  }
+  {
+    FS_TOOLS_STATS_PHASE(READ);
+    BatchReader reader(uevents.size() >= BatchReader::MIN_BATCH);
+    const size_t READ_OK = reader.read_all(uevents);
+    FS_TOOLS_STATS_ADD(m_files_read, READ_OK);
+  }
 
-    if (std::string content, vid, pid;
-        read_file(UEVENT, content) &&
-        parse_ids_from_uevent(content, vid, pid) && !vid.empty() &&
-        !pid.empty()) {
+  for (const auto& uevent : uevents) {
+    if (std::string vid, pid;
+        !uevent.m_error && parse_ids_from_uevent(uevent.m_content, vid, pid) &&
+        !vid.empty() && !pid.empty()) {
       uniq.emplace(std::move(vid), std::move(pid));
     }
+    FS_TOOLS_STATS_ADD(m_bytes_read, uevent.m_content.size());
   }
   return {uniq.begin(), uniq.end()};
 }
 
+void SysFSHelper::sort_unique(std::vector<UsbFunction>& funcs) {
+  // dedup по devPath (бывают дубли через разные симлинки); VID:PID
+  // сравниваем числами, а не строками
+  std::sort(funcs.begin(), funcs.end());
+  funcs.erase(std::unique(funcs.begin(), funcs.end(),
+                          [](const auto& first, const auto& second) {
+                            return first.m_dev_path == second.m_dev_path &&
+                                   first.m_id == second.m_id;
+                          }),
+              funcs.end());
+}
+
+auto SysFSHelper::resolve_entry(const DirHandle& classRoot,
+                                const std::string& name, AncestorCache* cache,
+                                const ScanFilter* filter)
+    -> std::optional<UsbFunction> {
+  // свой буфер на поток; DEVNAME ниже — view в него
+  thread_local std::string content;
+  if (!read_file_at(classRoot.fd(), name + "/uevent", content)) {
+    FS_TOOLS_STATS_ADD(m_dropped_no_devname, 1);
+    return std::nullopt;
+  }
+  return resolve_entry_uevent(classRoot, name, content, cache, filter);
+}
+
+auto SysFSHelper::resolve_entry_uevent(const DirHandle& classRoot,
+                                       const std::string& name,
+                                       std::string_view uevent,
+                                       AncestorCache* cache,
+                                       const ScanFilter* filter)
+    -> std::optional<UsbFunction> {
+  // DEVNAME
+  const auto EVENT = Uevent::parse(uevent, Uevent::DEVNAME);
+  if (EVENT.m_devname.empty()) {
+    FS_TOOLS_STATS_ADD(m_dropped_no_devname, 1);
+    return std::nullopt;
+  }
+  if (filter != nullptr && !filter->wants_dev_name(EVENT.m_devname)) {
+    return std::nullopt;
+  }
+  return resolve_function(classRoot.path(), join_path(classRoot.path(), name),
+                          EVENT.m_devname, cache);
+}
+
+auto SysFSHelper::resolve_function(const std::string& classRoot,
+                                   const std::string& entryPath,
+                                   std::string_view devname,
+                                   AncestorCache* cache,
+                                   const FsBackend* backend)
+    -> std::optional<UsbFunction> {
+  // Разыменовать device → подняться к USB и взять VID:PID; нет ссылки —
+  // realpath вернёт ENOENT
+  std::error_code error;
+  std::string node;
+  {
+    FS_TOOLS_STATS_PHASE(REALPATH);
+    // буфер пути ссылки переживает вызовы
+    thread_local std::string link;
+    link.assign(entryPath).append("/device");
+    node = canonical(link, cache, backend, error);
+  }
+  if (error || node.empty()) {
+    FS_TOOLS_STATS_ADD(m_dropped_no_device_link, 1);
+    return std::nullopt;
+  }
+
+  auto ancestor = usb_ids_for(node, cache, backend);
+  if (!ancestor) {
+    FS_TOOLS_STATS_ADD(m_dropped_no_usb_ancestor, 1);
+    return std::nullopt;
+  }
+
+  UsbFunction func;
+  func.m_id = ancestor->m_id;
+  func.m_vid = func.m_id.vid_string();
+  func.m_pid = func.m_id.pid_string();
+  // каталог с PRODUCT=, а не цель device: у ttyUSB это порт, у hidraw —
+  // HID-устройство под интерфейсом
+  func.m_usbNode = std::move(ancestor->m_node);
+  func.m_class_name = class_name_of(classRoot);
+  func.m_dev_name = devname;
+  func.m_dev_path = "/dev/" + func.m_dev_name;
+  return func;
+}
+
+auto SysFSHelper::find_by_rdev(const std::string& dev_node,
+                               const std::vector<std::string>& classRoots,
+                               AncestorCache* cache) -> FindResult {
+  FindResult result;
+  struct stat stt{};
+  if (::stat(join_path(default_dev_root(), dev_node).c_str(), &stt) != 0) {
+    return result;
+  }
+  const char* kind = S_ISCHR(stt.st_mode)   ? "/char/"
+                     : S_ISBLK(stt.st_mode) ? "/block/"
+                                            : nullptr;
+  if (kind == nullptr) {
+    return result;
+  }
+
+  // /sys/dev/char/188:0 → /sys/devices/.../ttyUSB0/tty/ttyUSB0
+  std::error_code error;
+  const auto ENTRY = canonical(
+      default_sys_dev_root() + kind + std::to_string(major(stt.st_rdev)) +
+          ":" + std::to_string(minor(stt.st_rdev)),
+      cache, nullptr, error);
+  if (error || ENTRY.empty()) {
+    return result;
+  }
+
+  // Узел в /dev мог быть переименован правилами udev — сверяем DEVNAME,
+  // чтобы результат совпадал с линейным поиском
+  std::string content;
+  if (!read_file(ENTRY + "/uevent", content)) {
+    return result;
+  }
+  if (const auto EVENT = Uevent::parse(content, Uevent::DEVNAME);
+      !EVENT.has(Uevent::DEVNAME) || EVENT.m_devname != dev_node) {
+    return result;
+  }
+
+  // Класс берём из ссылки subsystem; быстрый путь допустим только для корней
+  // вида /sys/class/<subsystem>, иначе решает линейный поиск
+  const auto SUBSYSTEM = readlink_once(ENTRY + "/subsystem");
+  const auto SLASH = SUBSYSTEM.find_last_of('/');
+  if (SLASH == std::string::npos) {
+    return result;
+  }
+  const auto CLASS_PREFIX = "/sys/class/"s;
+  const auto CLASS_NAME = SUBSYSTEM.substr(SLASH + 1);
+  const auto CLASS_ROOT = CLASS_PREFIX + CLASS_NAME;
+  // корень вызывающего "/sys/class/tty/" — тот же класс; в функцию уходит
+  // он сам, чтобы m_class_name совпал со сканом
+  const std::string* root = nullptr;
+  bool same_name = false;
+  for (const auto& candidate : classRoots) {
+    if (class_name_of(candidate) != CLASS_NAME) {
+      continue;
+    }
+    same_name = true;
+    const auto END = candidate.find_last_not_of('/');
+    if (candidate.compare(0, END + 1, CLASS_ROOT) == 0) {
+      root = &candidate;
+      break;
+    }
+  }
+  // DEVNAME уникален: узел есть ровно в одном классе. Если он не из
+  // переданных стандартных корней или у него нет USB-предка, скан тоже
+  // ничего не найдёт
+  const auto ABSENT = std::make_error_code(std::errc::no_such_device);
+  if (root == nullptr) {
+    // корень того же класса, но не вида /sys/class/<name>, — решает скан
+    if (!same_name &&
+        std::all_of(classRoots.begin(), classRoots.end(),
+                    [&CLASS_PREFIX](const std::string& candidate) {
+                      return candidate.rfind(CLASS_PREFIX, 0) == 0;
+                    })) {
+      result.m_error = ABSENT;
+    }
+    return result;
+  }
+  result.m_function = resolve_function(*root, ENTRY, dev_node, cache);
+  if (!result.m_function) {
+    result.m_error = ABSENT;
+  }
+  return result;
+}
+
 auto SysFSHelper::default_class_roots() -> std::vector<std::string> {
   // Популярные классы, у которых есть DEVNAME в uevent
   return {
@@ -321,4 +1179,8 @@ auto SysFSHelper::default_class_roots() -> std::vector<std::string> {
 auto SysFSHelper::default_usb_root() -> std::string {
   return "/sys/bus/usb/devices";
 }
+
+auto SysFSHelper::default_dev_root() -> std::string { return "/dev"; }
+
+auto SysFSHelper::default_sys_dev_root() -> std::string { return "/sys/dev"; }
 }  // namespace fs_tools
\ No newline at end of file
@@ -0,0 +1,288 @@
+#include "SysFSIndex.hpp"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace fs_tools {
+using namespace std::string_literals;
+
+SysFSIndex::SysFSIndex(std::vector<std::string> classRoots)
+    : m_class_roots(std::move(classRoots)) {
+  rebuild();
+}
+
+auto SysFSIndex::find(std::string dev_node) const
+    -> std::optional<UsbFunction> {
+  auto dev_path = "/dev/"s;
+  if (dev_node.rfind(dev_path, 0) == 0) {
+    dev_node.erase(0, dev_path.size());
+  }
+  const auto NAME = m_strings.find(dev_node);
+  if (!NAME) {
+    return std::nullopt;
+  }
+  auto iter = m_by_dev_name.find(*NAME);
+  if (iter == m_by_dev_name.end() || iter->second.empty()) {
+    return std::nullopt;
+  }
+  return function(iter->second.front());
+}
+
+auto SysFSIndex::find_by_id(const std::string& vid_raw,
+                            const std::string& pid_raw) const
+    -> std::vector<UsbFunction> {
+  const auto ID = SysFSHelper::UsbId::parse(vid_raw, pid_raw);
+  if (!ID) {
+    return {};
+  }
+  return collect(m_by_id, *ID);
+}
+
+auto SysFSIndex::find_by_usb_node(const std::string& usb_node) const
+    -> std::vector<UsbFunction> {
+  const auto NODE = m_strings.find(usb_node);
+  if (!NODE) {
+    return {};
+  }
+  return collect(m_by_usb_node, *NODE);
+}
+
+auto SysFSIndex::functions() const -> std::vector<UsbFunction> {
+  std::vector<UsbFunction> out;
+  out.reserve(m_entries.size());
+  for (const auto& [path, entry] : m_entries) {
+    if (entry.m_function) {
+      out.push_back(FunctionTable::expand(*entry.m_function, m_strings));
+    }
+  }
+  SysFSHelper::sort_unique(out);
+  return out;
+}
+
+auto SysFSIndex::size() const -> size_t {
+  return static_cast<size_t>(
+      std::count_if(m_entries.begin(), m_entries.end(),
+                    [](const auto& item) { return item.second.m_function; }));
+}
+
+auto SysFSIndex::refresh() -> size_t {
+  size_t changed = 0;
+  // кэш предков живёт один проход: перепрошитое устройство на том же пути
+  // должно перечитаться
+  SysFSHelper::AncestorCache ancestors;
+  std::unordered_set<std::string> seen;
+  seen.reserve(m_entries.size());
+
+  std::error_code error;
+  for (const auto& classRoot : m_class_roots) {
+    const auto ROOT = DirHandle::open(classRoot, error);
+    if (!ROOT.valid()) {
+      continue;
+    }
+    // inode из readdir (d_ino) — без lstat на каждый элемент
+    for (const auto& dirent : ROOT.typed_entries()) {
+      const auto& name = dirent.m_name;
+      const auto INODE = dirent.m_inode;
+      auto entryPath = join_path(classRoot, name);
+      seen.insert(entryPath);
+      auto iter = m_entries.find(entryPath);
+      if (iter != m_entries.end() && iter->second.m_inode == INODE) {
+        if (!iter->second.m_retry) {
+          continue;
+        }
+        // прошлый отказ был временным: повторяем, считаем только успех
+        remove_entry(entryPath);
+        add_entry(ROOT, name, INODE, &ancestors);
+        changed += m_entries.at(entryPath).m_function ? 1 : 0;
+        continue;
+      }
+      // новый элемент или пересоздан под тем же именем
+      if (iter != m_entries.end()) {
+        remove_entry(entryPath);
+      }
+      add_entry(ROOT, name, INODE, &ancestors);
+      ++changed;
+    }
+  }
+
+  for (auto iter = m_entries.begin(); iter != m_entries.end();) {
+    if (seen.count(iter->first) != 0) {
+      ++iter;
+      continue;
+    }
+    if (iter->second.m_function) {
+      unlink(iter->first, *iter->second.m_function);
+    }
+    iter = m_entries.erase(iter);
+    ++changed;
+  }
+  return changed;
+}
+
+auto SysFSIndex::invalidate(std::string dev_node) -> bool {
+  auto dev_path = "/dev/"s;
+  if (dev_node.rfind(dev_path, 0) == 0) {
+    dev_node.erase(0, dev_path.size());
+  }
+
+  // копия: remove_entry правит индекс, по которому мы идём
+  std::vector<std::string> entries;
+  if (const auto NAME = m_strings.find(dev_node)) {
+    if (auto iter = m_by_dev_name.find(*NAME); iter != m_by_dev_name.end()) {
+      entries = iter->second;
+    }
+  }
+  // нерезолвленные элементы не попали в индексы — ищем по имени элемента
+  const auto BASE = dev_node.substr(dev_node.find_last_of('/') + 1);
+  for (const auto& [path, entry] : m_entries) {
+    if (!entry.m_function && entry.m_name == BASE) {
+      entries.push_back(path);
+    }
+  }
+
+  bool resolved = false;
+  std::error_code error;
+  for (const auto& entryPath : entries) {
+    const auto& entry = m_entries.at(entryPath);
+    const auto ROOT = DirHandle::open(entry.m_class_root, error);
+    const auto ENTRY_NAME = entry.m_name;
+    remove_entry(entryPath);
+    // элемент мог быть пересоздан: inode перечитывается, а не берётся старый
+    struct stat stt{};
+    if (!ROOT.valid() || !ROOT.stat_at(ENTRY_NAME, stt)) {
+      continue;
+    }
+    add_entry(ROOT, ENTRY_NAME, stt.st_ino);
+    resolved = resolved || m_entries.at(entryPath).m_function.has_value();
+  }
+  return resolved;
+}
+
+void SysFSIndex::rebuild() {
+  m_entries.clear();
+  m_by_dev_name.clear();
+  m_by_id.clear();
+  m_by_usb_node.clear();
+  m_strings.clear();
+  refresh();
+}
+
+void SysFSIndex::add_entry(const DirHandle& classRoot, const std::string& name,
+                           ino_t inode,
+                           SysFSHelper::AncestorCache* ancestors) {
+  const auto ENTRY_PATH = join_path(classRoot.path(), name);
+  Entry entry;
+  entry.m_class_root = classRoot.path();
+  entry.m_name = name;
+  entry.m_inode = inode;
+  if (auto func = SysFSHelper::resolve_entry(classRoot, name, ancestors)) {
+    entry.m_function = FunctionTable::compact(*func, m_strings);
+    link(ENTRY_PATH, *entry.m_function);
+  } else {
+    entry.m_retry = transient_failure(classRoot, name);
+  }
+  m_entries[ENTRY_PATH] = std::move(entry);
+}
+
+auto SysFSIndex::transient_failure(const DirHandle& classRoot,
+                                   const std::string& name) -> bool {
+  // окончательно: нет DEVNAME, нет device-ссылки, предки вне USB; всё
+  // остальное (EMFILE, EIO, ...) может пройти
+  const auto ABSENT = [](const std::error_code& error) {
+    return error == std::errc::no_such_file_or_directory ||
+           error == std::errc::not_a_directory;
+  };
+  std::string content;
+  std::error_code error;
+  if (!classRoot.read_attr_at(name + "/uevent", content, error)) {
+    return !ABSENT(error);
+  }
+  if (SysFSHelper::Uevent::parse(content, SysFSHelper::Uevent::DEVNAME)
+          .m_devname.empty()) {
+    return false;
+  }
+  const auto NODE =
+      canonical_path(join_path(classRoot.path(), name) + "/device", error);
+  if (error) {
+    return !ABSENT(error);
+  }
+  // USB-устройства всегда лежат под корневым хабом "usbN": без PRODUCT= у
+  // предков там — uevent ещё не прочитать
+  for (size_t pos = 0; pos < NODE.size();) {
+    const auto END = std::min(NODE.find('/', pos), NODE.size());
+    const std::string_view PART(NODE.data() + pos, END - pos);
+    if (PART.size() > 3 && PART.rfind("usb", 0) == 0 &&
+        std::all_of(PART.begin() + 3, PART.end(), [](char chr) {
+          return std::isdigit(static_cast<unsigned char>(chr)) != 0;
+        })) {
+      return true;
+    }
+    pos = END + 1;
+  }
+  return false;
+}
+
+void SysFSIndex::remove_entry(const std::string& entryPath) {
+  auto iter = m_entries.find(entryPath);
+  if (iter == m_entries.end()) {
+    return;
+  }
+  if (iter->second.m_function) {
+    unlink(entryPath, *iter->second.m_function);
+  }
+  m_entries.erase(iter);
+}
+
+void SysFSIndex::link(const std::string& entryPath,
+                      const FunctionTable::Row& row) {
+  m_by_dev_name[row.m_dev_name].push_back(entryPath);
+  m_by_id[row.m_id].push_back(entryPath);
+  m_by_usb_node[row.m_usb_node].push_back(entryPath);
+}
+
+void SysFSIndex::unlink(const std::string& entryPath,
+                        const FunctionTable::Row& row) {
+  auto drop = [&entryPath](auto& index, const auto& key) {
+    auto iter = index.find(key);
+    if (iter == index.end()) {
+      return;
+    }
+    auto& paths = iter->second;
+    paths.erase(std::remove(paths.begin(), paths.end(), entryPath),
+                paths.end());
+    if (paths.empty()) {
+      index.erase(iter);
+    }
+  };
+  drop(m_by_dev_name, row.m_dev_name);
+  drop(m_by_id, row.m_id);
+  drop(m_by_usb_node, row.m_usb_node);
+}
+
+template <typename Key, typename Hash>
+auto SysFSIndex::collect(const Index<Key, Hash>& index, const Key& key) const
+    -> std::vector<UsbFunction> {
+  std::vector<UsbFunction> out;
+  auto iter = index.find(key);
+  if (iter == index.end()) {
+    return out;
+  }
+  out.reserve(iter->second.size());
+  for (const auto& entryPath : iter->second) {
+    out.push_back(function(entryPath));
+  }
+  SysFSHelper::sort_unique(out);
+  return out;
+}
+
+auto SysFSIndex::function(const std::string& entryPath) const -> UsbFunction {
+  return FunctionTable::expand(*m_entries.at(entryPath).m_function, m_strings);
+}
+}  // namespace fs_tools
@@ -0,0 +1,89 @@
+#include "UsbDevice.hpp"
+
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "BatchReader.hpp"
+#include "EnumStats.hpp"
+#include "fs_tools.hpp"
+
+namespace fs_tools {
+UsbDevice::UsbDevice(const std::string& usb_node) : m_path(usb_node) {
+  // интерфейс "1-1.2:1.0" лежит прямо в каталоге устройства "1-1.2"
+  const auto SLASH = m_path.find_last_of('/');
+  const auto BASE = SLASH == std::string::npos ? 0 : SLASH + 1;
+  if (SLASH != std::string::npos &&
+      m_path.find(':', BASE) != std::string::npos) {
+    m_path.resize(SLASH);
+  }
+}
+
+void UsbDevice::load(unsigned attributes) const {
+  // в порядке битов Attribute
+  static constexpr std::array<const char*, ATTRIBUTE_COUNT> NAMES{
+      "serial", "busnum", "devnum", "speed", "devpath"};
+  const unsigned MISSING = attributes & ALL & ~m_loaded;
+  if (MISSING == 0) {
+    return;
+  }
+  m_loaded |= MISSING;
+
+  std::error_code error;
+  const auto DIR = DirHandle::open(m_path, error);
+  if (!DIR.valid()) {
+    return;
+  }
+  // один каталог, все атрибуты — относительные имена одной пачкой
+  std::vector<BatchReader::Item> items;
+  std::vector<size_t> slots;
+  for (size_t i = 0; i < ATTRIBUTE_COUNT; ++i) {
+    if ((MISSING & (1U << i)) != 0) {
+      items.emplace_back();
+      items.back().m_dirfd = DIR.fd();
+      items.back().m_name = NAMES[i];
+      slots.push_back(i);
+    }
+  }
+  FS_TOOLS_STATS_PHASE(READ);
+  BatchReader reader(items.size() >= BatchReader::MIN_BATCH);
+  const size_t READ_OK = reader.read_all(items);
+  FS_TOOLS_STATS_ADD(m_files_read, READ_OK);
+
+  for (size_t i = 0; i < items.size(); ++i) {
+    auto& item = items[i];
+    if (item.m_error) {
+      continue;
+    }
+    FS_TOOLS_STATS_ADD(m_bytes_read, item.m_content.size());
+    while (!item.m_content.empty() && item.m_content.back() == '\n') {
+      item.m_content.pop_back();
+    }
+    m_values[slots[i]] = std::move(item.m_content);
+  }
+}
+
+auto UsbDevice::get(Attribute attribute) const
+    -> const std::optional<std::string>& {
+  load(attribute);
+  size_t index = 0;
+  while ((1U << index) != attribute) {
+    ++index;
+  }
+  return m_values[index];
+}
+
+auto UsbDevice::number(Attribute attribute) const -> std::optional<unsigned> {
+  const auto& value = get(attribute);
+  if (!value || value->empty()) {
+    return std::nullopt;
+  }
+  char* end = nullptr;
+  const auto NUMBER = std::strtoul(value->c_str(), &end, 10);
+  if (*end != '\0') {
+    return std::nullopt;
+  }
+  return static_cast<unsigned>(NUMBER);
+}
+}  // namespace fs_tools
@@ -0,0 +1,154 @@
+#include "UsbQuery.hpp"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "FsBackend.hpp"
+#include "UsbDevice.hpp"
+#include "fs_tools.hpp"
+
+namespace fs_tools {
+namespace {
+auto base_name(const std::string& path) -> std::string {
+  const auto SLASH = path.find_last_of('/');
+  return SLASH == std::string::npos ? path : path.substr(SLASH + 1);
+}
+
+auto any_glob(const std::vector<Glob>& globs, const std::string& str)
+    -> bool {
+  return std::any_of(globs.begin(), globs.end(), [&str](const auto& glob) {
+    return glob.matches(str);
+  });
+}
+}  // namespace
+
+auto UsbQuery::class_name(std::string name) -> UsbQuery& {
+  m_classes.push_back(std::move(name));
+  return *this;
+}
+
+auto UsbQuery::id(UsbId id) -> UsbQuery& {
+  m_ids.push_back({id, UsbId{0xffff, 0xffff}});
+  return *this;
+}
+
+auto UsbQuery::vendor(uint16_t vid) -> UsbQuery& {
+  m_ids.push_back({UsbId{vid, 0}, UsbId{0xffff, 0}});
+  return *this;
+}
+
+auto UsbQuery::id_mask(UsbId value, UsbId mask) -> UsbQuery& {
+  m_ids.push_back({value, mask});
+  return *this;
+}
+
+auto UsbQuery::ids(const std::vector<UsbId>& ids) -> UsbQuery& {
+  for (const auto ID : ids) {
+    id(ID);
+  }
+  return *this;
+}
+
+auto UsbQuery::driver(std::string name) -> UsbQuery& {
+  m_drivers.push_back(std::move(name));
+  return *this;
+}
+
+auto UsbQuery::port(std::string glob) -> UsbQuery& {
+  // без FNM_PATHNAME, как раньше: "1-*" совпадает и с "1-2.4"
+  m_ports.emplace_back(std::move(glob), 0);
+  return *this;
+}
+
+auto UsbQuery::dev_name(std::string glob) -> UsbQuery& {
+  m_dev_names.emplace_back(std::move(glob), 0);
+  return *this;
+}
+
+auto UsbQuery::where(Predicate predicate) -> UsbQuery& {
+  m_predicates.push_back(std::move(predicate));
+  return *this;
+}
+
+auto UsbQuery::wants_class(const std::string& classRoot) const -> bool {
+  return m_classes.empty() ||
+         std::find(m_classes.begin(), m_classes.end(),
+                   SysFSHelper::class_name_of(classRoot)) != m_classes.end();
+}
+
+auto UsbQuery::wants_dev_name(const std::string& dev_name) const -> bool {
+  return m_dev_names.empty() || any_glob(m_dev_names, dev_name);
+}
+
+auto UsbQuery::wants_function(const UsbFunction& func) const -> bool {
+  // от дешёвого к дорогому: числа, строки, readlink, чужой код
+  if (!m_ids.empty() &&
+      std::none_of(m_ids.begin(), m_ids.end(), [&func](const auto& filter) {
+        return (func.m_id.m_vid & filter.m_mask.m_vid) ==
+                   (filter.m_value.m_vid & filter.m_mask.m_vid) &&
+               (func.m_id.m_pid & filter.m_mask.m_pid) ==
+                   (filter.m_value.m_pid & filter.m_mask.m_pid);
+      })) {
+    return false;
+  }
+  if (!m_ports.empty() &&
+      !any_glob(m_ports, base_name(UsbDevice(func).path()))) {
+    return false;
+  }
+  if (!m_drivers.empty()) {
+    // m_usbNode — интерфейс (первый каталог с PRODUCT=), а не порт
+    // usb-serial или HID-устройство под ним: нужен драйвер интерфейса
+    const auto DRIVER = base_name(readlink_once(func.m_usbNode + "/driver"));
+    if (DRIVER.empty() || std::find(m_drivers.begin(), m_drivers.end(),
+                                    DRIVER) == m_drivers.end()) {
+      return false;
+    }
+  }
+  return std::all_of(m_predicates.begin(), m_predicates.end(),
+                     [&func](const auto& predicate) { return predicate(func); });
+}
+
+auto UsbQuery::matches(const UsbFunction& func) const -> bool {
+  if (!m_classes.empty() && std::find(m_classes.begin(), m_classes.end(),
+                                      func.m_class_name) == m_classes.end()) {
+    return false;
+  }
+  return wants_dev_name(func.m_dev_name) && wants_function(func);
+}
+
+auto UsbQuery::scan_filter() const -> SysFSHelper::ScanFilter {
+  // каждая стадия — там, где её можно решить: класс — до открытия корня,
+  // имя узла — до realpath, остальное — по разрешённой функции
+  SysFSHelper::ScanFilter filter;
+  if (!m_classes.empty()) {
+    filter.m_class = [this](const std::string& classRoot) {
+      return wants_class(classRoot);
+    };
+  }
+  if (!m_dev_names.empty()) {
+    filter.m_dev_name = [this](const std::string& dev_name) {
+      return wants_dev_name(dev_name);
+    };
+  }
+  filter.m_function = [this](const UsbFunction& func) {
+    return wants_function(func);
+  };
+  return filter;
+}
+
+auto UsbQuery::for_each(const SysFSHelper::Visitor& visitor,
+                        const std::vector<std::string>& classRoots) const
+    -> size_t {
+  const auto FILTER = scan_filter();
+  return SysFSHelper::for_each_function(visitor, classRoots, false, &FILTER);
+}
+
+auto UsbQuery::run(const std::vector<std::string>& classRoots) const
+    -> std::vector<UsbFunction> {
+  const auto FILTER = scan_filter();
+  return SysFSHelper::list_functions_at(FsBackend::posix(), {}, classRoots, 1,
+                                        &FILTER);
+}
+}  // namespace fs_tools
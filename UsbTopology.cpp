@@ -0,0 +1,259 @@
+#include "UsbTopology.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "BatchReader.hpp"
+#include "EnumStats.hpp"
+#include "FsBackend.hpp"
+#include "fs_tools.hpp"
+
+namespace fs_tools {
+namespace {
+constexpr size_t NO_PARENT = static_cast<size_t>(-1);
+
+// "1-1.9" < "1-1.10": числа внутри имён сравниваются как числа
+auto natural_less(std::string_view first, std::string_view second) -> bool {
+  size_t pos1 = 0;
+  size_t pos2 = 0;
+  while (pos1 < first.size() && pos2 < second.size()) {
+    const auto CH1 = static_cast<unsigned char>(first[pos1]);
+    const auto CH2 = static_cast<unsigned char>(second[pos2]);
+    if (std::isdigit(CH1) != 0 && std::isdigit(CH2) != 0) {
+      size_t end1 = pos1;
+      size_t end2 = pos2;
+      while (end1 < first.size() &&
+             std::isdigit(static_cast<unsigned char>(first[end1])) != 0) {
+        ++end1;
+      }
+      while (end2 < second.size() &&
+             std::isdigit(static_cast<unsigned char>(second[end2])) != 0) {
+        ++end2;
+      }
+      // без ведущих нулей в именах sysfs: длиннее — значит больше
+      if (end1 - pos1 != end2 - pos2) {
+        return end1 - pos1 < end2 - pos2;
+      }
+      if (const auto CMP = first.substr(pos1, end1 - pos1)
+                               .compare(second.substr(pos2, end2 - pos2));
+          CMP != 0) {
+        return CMP < 0;
+      }
+      pos1 = end1;
+      pos2 = end2;
+      continue;
+    }
+    if (CH1 != CH2) {
+      return CH1 < CH2;
+    }
+    ++pos1;
+    ++pos2;
+  }
+  return first.size() - pos1 < second.size() - pos2;
+}
+
+// Родитель по имени ядра: "3-1.4:1.0" → "3-1.4" → "3-1" → "usb3";
+// интерфейс корневого хаба "3-0:1.0" → "usb3"
+auto parent_name(std::string_view name) -> std::string {
+  if (name.rfind("usb", 0) == 0) {
+    return {};
+  }
+  if (const auto COLON = name.find(':'); COLON != std::string_view::npos) {
+    const auto DEVICE = name.substr(0, COLON);
+    if (DEVICE.size() > 2 && DEVICE.substr(DEVICE.size() - 2) == "-0") {
+      return "usb" + std::string(DEVICE.substr(0, DEVICE.size() - 2));
+    }
+    return std::string(DEVICE);
+  }
+  if (const auto DOT = name.rfind('.'); DOT != std::string_view::npos) {
+    return std::string(name.substr(0, DOT));
+  }
+  if (const auto DASH = name.find('-'); DASH != std::string_view::npos) {
+    return "usb" + std::string(name.substr(0, DASH));
+  }
+  return {};
+}
+
+/** Узел до раскладки в прямой порядок. */
+struct RawNode {
+  std::string m_name;
+  UsbTopology::Kind m_kind = UsbTopology::Kind::DEVICE;
+  SysFSHelper::UsbId m_id;
+  size_t m_parent = NO_PARENT;
+  std::vector<size_t> m_children;
+  UsbTopology::Index m_function = UsbTopology::NONE;
+};
+}  // namespace
+
+auto UsbTopology::build(const std::string& dev_usb_root,
+                        const std::vector<std::string>& classRoots)
+    -> UsbTopology {
+  UsbTopology out;
+  // два прохода: функции — обход классов как в list_functions(), затем
+  // шина — один листинг dev_usb_root; связываются по имени интерфейса, так
+  // что функции вне шины отпадают и без отбора по dev_usb_root
+  const auto FUNCS =
+      SysFSHelper::list_functions_at(FsBackend::posix(), {}, classRoots);
+
+  std::error_code error;
+  const auto ROOT = DirHandle::open(dev_usb_root, error);
+  if (!ROOT.valid()) {
+    return out;
+  }
+  FS_TOOLS_STATS_ADD(m_dirs_opened, 1);
+  std::vector<RawNode> raw;
+  std::vector<BatchReader::Item> uevents;
+  {
+    FS_TOOLS_STATS_PHASE(READDIR);
+    for (auto& entry : ROOT.typed_entries()) {
+      if (entry.is_symlink() || entry.is_dir()) {
+        uevents.emplace_back();
+        uevents.back().m_dirfd = ROOT.fd();
+        uevents.back().m_name = entry.m_name + "/uevent";
+        raw.emplace_back();
+        raw.back().m_name = std::move(entry.m_name);
+      }
+    }
+  }
+  {
+    FS_TOOLS_STATS_PHASE(READ);
+    BatchReader reader(uevents.size() >= BatchReader::MIN_BATCH);
+    const size_t READ_OK = reader.read_all(uevents);
+    FS_TOOLS_STATS_ADD(m_files_read, READ_OK);
+  }
+  std::string vid;
+  std::string pid;
+  for (size_t i = 0; i < raw.size(); ++i) {
+    auto& node = raw[i];
+    if (node.m_name.rfind("usb", 0) == 0) {
+      node.m_kind = Kind::CONTROLLER;
+    } else if (node.m_name.find(':') != std::string::npos) {
+      node.m_kind = Kind::INTERFACE;
+    }
+    if (uevents[i].m_error) {
+      continue;
+    }
+    FS_TOOLS_STATS_ADD(m_bytes_read, uevents[i].m_content.size());
+    const auto EVENT = SysFSHelper::Uevent::parse(
+        uevents[i].m_content, SysFSHelper::Uevent::PRODUCT);
+    if (EVENT.has(SysFSHelper::Uevent::PRODUCT) &&
+        SysFSHelper::parse_ids_from_product(EVENT.m_product, vid, pid)) {
+      node.m_id = UsbId::parse(vid, pid).value_or(UsbId{});
+    }
+  }
+
+  // имена шины → индексы; затем родители и функции под интерфейсами
+  std::unordered_map<std::string, size_t> by_name;
+  by_name.reserve(raw.size());
+  for (size_t i = 0; i < raw.size(); ++i) {
+    by_name.emplace(raw[i].m_name, i);
+  }
+  const size_t BUS_NODES = raw.size();
+  for (size_t i = 0; i < BUS_NODES; ++i) {
+    if (auto iter = by_name.find(parent_name(raw[i].m_name));
+        iter != by_name.end()) {
+      raw[i].m_parent = iter->second;
+    }
+  }
+  for (const auto& func : FUNCS) {
+    // m_usbNode — интерфейс (или устройство), даже если device-ссылка
+    // функции ведёт глубже: порт usb-serial, HID-устройство
+    const auto SLASH = func.m_usbNode.find_last_of('/');
+    auto iter = by_name.find(func.m_usbNode.substr(SLASH + 1));
+    if (iter == by_name.end()) {
+      continue;
+    }
+    RawNode node;
+    node.m_name = func.m_dev_name;
+    node.m_kind = Kind::FUNCTION;
+    node.m_id = func.m_id;
+    node.m_parent = iter->second;
+    node.m_function = static_cast<Index>(out.m_functions.add(func));
+    raw.push_back(std::move(node));
+  }
+
+  std::vector<size_t> roots;
+  for (size_t i = 0; i < raw.size(); ++i) {
+    if (raw[i].m_parent == NO_PARENT) {
+      roots.push_back(i);
+    } else {
+      raw[raw[i].m_parent].m_children.push_back(i);
+      if (raw[i].m_kind == Kind::DEVICE &&
+          raw[raw[i].m_parent].m_kind == Kind::DEVICE) {
+        raw[raw[i].m_parent].m_kind = Kind::HUB;
+      }
+    }
+  }
+  const auto BY_NAME = [&raw](size_t first, size_t second) {
+    return natural_less(raw[first].m_name, raw[second].m_name);
+  };
+  std::sort(roots.begin(), roots.end(), BY_NAME);
+  for (auto& node : raw) {
+    std::sort(node.m_children.begin(), node.m_children.end(), BY_NAME);
+  }
+
+  // прямой обход: поддерево узла — непрерывный отрезок массива
+  out.m_nodes.reserve(raw.size());
+  struct Frame {
+    size_t m_raw;
+    Index m_index;
+    size_t m_next_child;
+  };
+  std::vector<Frame> stack;
+  const auto EMIT = [&](size_t index, Index parent) {
+    const auto& source = raw[index];
+    Node node;
+    node.m_kind = source.m_kind;
+    node.m_depth = parent == NONE
+                       ? 0
+                       : static_cast<uint16_t>(out.m_nodes[parent].m_depth + 1);
+    node.m_parent = parent;
+    node.m_id = source.m_id;
+    node.m_name = out.m_names.intern(source.m_name);
+    node.m_function = source.m_function;
+    out.m_nodes.push_back(node);
+    stack.push_back({index, static_cast<Index>(out.m_nodes.size() - 1), 0});
+  };
+  for (const size_t ROOT_INDEX : roots) {
+    EMIT(ROOT_INDEX, NONE);
+    while (!stack.empty()) {
+      auto& frame = stack.back();
+      const auto& children = raw[frame.m_raw].m_children;
+      if (frame.m_next_child < children.size()) {
+        EMIT(children[frame.m_next_child++], frame.m_index);
+        continue;
+      }
+      out.m_nodes[frame.m_index].m_end =
+          static_cast<Index>(out.m_nodes.size());
+      stack.pop_back();
+    }
+  }
+
+  out.m_node_of_name.assign(out.m_names.size(), NONE);
+  for (Index i = 0; i < out.m_nodes.size(); ++i) {
+    out.m_node_of_name[out.m_nodes[i].m_name] = i;
+  }
+  return out;
+}
+
+auto UsbTopology::find(std::string_view name) const -> Index {
+  const auto ID = m_names.find(name);
+  return ID ? m_node_of_name[*ID] : NONE;
+}
+
+auto UsbTopology::functions_under(Index index) const
+    -> std::vector<UsbFunction> {
+  std::vector<UsbFunction> out;
+  for (Index i = index; i < m_nodes[index].m_end; ++i) {
+    if (m_nodes[i].m_kind == Kind::FUNCTION) {
+      out.push_back(function(i));
+    }
+  }
+  return out;
+}
+}  // namespace fs_tools
@@ -0,0 +1,33 @@
+#include "BM_allocations.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Замены operator new/delete живут в своей единице трансляции: встроенные
+// в место вызова, они дают ложные -Wmismatched-new-delete (new против free)
+namespace {
+std::atomic<size_t> g_allocations{0};
+}  // namespace
+
+namespace fs_tools::bench {
+auto allocations() -> size_t {
+  return g_allocations.load(std::memory_order_relaxed);
+}
+}  // namespace fs_tools::bench
+
+// Счётчик аллокаций: весь процесс, включая сам benchmark, поэтому
+// сравниваются только значения внутри прогона
+auto operator new(std::size_t size) -> void* {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, std::size_t /*size*/) noexcept {
+  std::free(ptr);
+}
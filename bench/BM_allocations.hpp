@@ -0,0 +1,12 @@
+/**
+ * @file BM_allocations.hpp
+ * @brief Process-wide count of `operator new` calls for the benchmarks.
+ */
+#pragma once
+
+#include <cstddef>
+
+namespace fs_tools::bench {
+/** Allocations so far, the benchmark library's own included. */
+auto allocations() -> size_t;
+}  // namespace fs_tools::bench
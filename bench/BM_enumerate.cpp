@@ -0,0 +1,338 @@
+#include <benchmark/benchmark.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "BM_allocations.hpp"
+#include "DeviceRegistry.hpp"
+#include "FakeSysfs.hpp"
+#include "MemoryBackend.hpp"
+#include "PathResolver.hpp"
+#include "SnapshotCache.hpp"
+#include "SysFSHelper.hpp"
+#include "UsbQuery.hpp"
+#include "UsbTopology.hpp"
+#include "fs_tools.hpp"
+
+namespace fs = std::filesystem;
+using fs_tools::SysFSHelper;
+using fs_tools::testing::FakeSysfs;
+
+namespace {
+// read(2)-подобные вызовы процесса; io_uring их не увеличивает
+auto read_syscalls() -> size_t {
+  std::ifstream io("/proc/self/io");
+  std::string key;
+  size_t value = 0;
+  while (io >> key >> value) {
+    if (key == "syscr:") {
+      return value;
+    }
+  }
+  return 0;
+}
+
+// Деревья строятся один раз на размер (benchmark вызывает функцию несколько
+// раз при подборе числа итераций) и удаляются при выходе
+struct Trees {
+  fs::path m_base = fs::temp_directory_path() /
+                    ("fs_tools_bench-" + std::to_string(::getpid()));
+  std::map<std::pair<int64_t, int64_t>, std::unique_ptr<FakeSysfs>> m_trees;
+
+  ~Trees() {
+    m_trees.clear();
+    std::error_code error;
+    fs::remove_all(m_base, error);
+  }
+};
+
+auto tree(const benchmark::State& state) -> const FakeSysfs& {
+  static Trees trees;
+  const auto KEY = std::make_pair(state.range(0), state.range(1));
+  auto& slot = trees.m_trees[KEY];
+  if (!slot) {
+    fs_tools::testing::FakeSysfsOptions options;
+    options.m_devices = static_cast<size_t>(KEY.first);
+    options.m_functions = static_cast<size_t>(KEY.second);
+    slot = std::make_unique<FakeSysfs>(
+        trees.m_base /
+            (std::to_string(KEY.first) + "x" + std::to_string(KEY.second)),
+        options);
+  }
+  return *slot;
+}
+
+// То же дерево в MemoryBackend: стоимость алгоритма без ядра
+struct MemoryTree {
+  fs_tools::MemoryBackend m_backend;
+  std::unique_ptr<FakeSysfs> m_fake;
+};
+
+auto memory_tree(const benchmark::State& state) -> const MemoryTree& {
+  static std::map<std::pair<int64_t, int64_t>, std::unique_ptr<MemoryTree>>
+      trees;
+  const auto KEY = std::make_pair(state.range(0), state.range(1));
+  auto& slot = trees[KEY];
+  if (!slot) {
+    fs_tools::testing::FakeSysfsOptions options;
+    options.m_devices = static_cast<size_t>(KEY.first);
+    options.m_functions = static_cast<size_t>(KEY.second);
+    slot = std::make_unique<MemoryTree>();
+    slot->m_fake = std::make_unique<FakeSysfs>(slot->m_backend, options);
+  }
+  return *slot;
+}
+
+/** Аллокации и read-вызовы за прогон, в среднем на итерацию. */
+class Meter {
+ public:
+  Meter()
+      : m_allocations(fs_tools::bench::allocations()), m_reads(read_syscalls()) {}
+
+  void report(benchmark::State& state) const {
+    const auto ALLOCS = fs_tools::bench::allocations() - m_allocations;
+    const auto READS = read_syscalls() - m_reads;
+    state.counters["allocs"] = benchmark::Counter(
+        static_cast<double>(ALLOCS), benchmark::Counter::kAvgIterations);
+    state.counters["read_calls"] = benchmark::Counter(
+        static_cast<double>(READS), benchmark::Counter::kAvgIterations);
+  }
+
+ private:
+  size_t m_allocations;
+  size_t m_reads;
+};
+
+void BM_ListFunctions(benchmark::State& state) {
+  const auto& fake = tree(state);
+  const auto ROOTS = fake.class_roots();
+  const Meter METER;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        SysFSHelper::list_functions(fake.usb_root(), ROOTS));
+  }
+  METER.report(state);
+  state.counters["functions"] = static_cast<double>(fake.functions().size());
+}
+
+void BM_ListFunctionsMemory(benchmark::State& state) {
+  const auto& mem = memory_tree(state);
+  const auto ROOTS = mem.m_fake->class_roots();
+  const Meter METER;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(SysFSHelper::list_functions(
+        mem.m_backend, mem.m_fake->usb_root(), ROOTS));
+  }
+  METER.report(state);
+  state.counters["nodes"] = static_cast<double>(mem.m_backend.size());
+  state.counters["index_bytes"] =
+      static_cast<double>(mem.m_backend.index_bytes());
+}
+
+void BM_ListFunctionsParallel(benchmark::State& state) {
+  const auto& fake = tree(state);
+  const auto ROOTS = fake.class_roots();
+  const Meter METER;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(SysFSHelper::list_functions(
+        SysFSHelper::ParallelOptions{4}, fake.usb_root(), ROOTS));
+  }
+  METER.report(state);
+}
+
+void BM_Find(benchmark::State& state) {
+  const auto& fake = tree(state);
+  const auto ROOTS = fake.class_roots();
+  // середина списка; /dev-узла нет, поэтому это линейный поиск по корням
+  const auto DEV = fake.functions()[fake.functions().size() / 2].m_dev_name;
+  const Meter METER;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(SysFSHelper::find(DEV, ROOTS));
+  }
+  METER.report(state);
+}
+
+void BM_FindMany(benchmark::State& state) {
+  const auto& fake = tree(state);
+  const auto ROOTS = fake.class_roots();
+  // каждая восьмая функция, тоже без /dev-узлов
+  std::vector<std::string> nodes;
+  for (size_t i = 0; i < fake.functions().size(); i += 8) {
+    nodes.push_back(fake.functions()[i].m_dev_name);
+  }
+  const Meter METER;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(SysFSHelper::find_many(nodes, ROOTS));
+  }
+  METER.report(state);
+  state.counters["nodes"] = static_cast<double>(nodes.size());
+}
+
+void BM_FindById(benchmark::State& state) {
+  const auto& fake = tree(state);
+  const auto ROOTS = fake.class_roots();
+  const auto& func = fake.functions()[fake.functions().size() / 2];
+  const Meter METER;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        SysFSHelper::find_by_id(func.m_vid, func.m_pid, ROOTS));
+  }
+  METER.report(state);
+}
+
+void BM_FindFirstById(benchmark::State& state) {
+  const auto& fake = tree(state);
+  const auto ROOTS = fake.class_roots();
+  const auto& func = fake.functions()[fake.functions().size() / 2];
+  const Meter METER;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        SysFSHelper::find_first_by_id(func.m_vid, func.m_pid, ROOTS));
+  }
+  METER.report(state);
+}
+
+// чтение опубликованного снимка вместо обхода sysfs
+void BM_RegistryRead(benchmark::State& state) {
+  const auto& fake = tree(state);
+  const fs_tools::DeviceRegistry REGISTRY(fake.class_roots());
+  fs_tools::DeviceRegistry::Reader reader(REGISTRY);
+  const auto DEV = fake.functions()[fake.functions().size() / 2].m_dev_name;
+  const Meter METER;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(reader.get().find(DEV));
+  }
+  METER.report(state);
+}
+
+// холодный старт CLI: открыть и проверить кеш, ответить на один запрос
+void BM_CacheOpenFind(benchmark::State& state) {
+  const auto& fake = tree(state);
+  const auto ROOTS = fake.class_roots();
+  const auto PATH = (fake.root() / "cache.bin").string();
+  std::error_code error;
+  fs_tools::SnapshotCache::rebuild(PATH, error, fake.usb_root(), ROOTS);
+  const auto DEV = fake.functions()[fake.functions().size() / 2].m_dev_name;
+  const Meter METER;
+  for (auto _ : state) {
+    auto cache =
+        fs_tools::SnapshotCache::open(PATH, error, fake.usb_root(), ROOTS);
+    benchmark::DoNotOptimize(cache->find(DEV));
+  }
+  METER.report(state);
+}
+
+// выборочный запрос: один класс и одно имя — остальное отсекается до realpath
+void BM_QuerySelective(benchmark::State& state) {
+  const auto& fake = tree(state);
+  const auto ROOTS = fake.class_roots();
+  const auto QUERY =
+      fs_tools::UsbQuery().class_name("tty").dev_name("ttyUSB1*");
+  const Meter METER;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(QUERY.run(ROOTS));
+  }
+  METER.report(state);
+}
+
+void BM_TopologyBuild(benchmark::State& state) {
+  const auto& fake = tree(state);
+  const auto ROOTS = fake.class_roots();
+  const Meter METER;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        fs_tools::UsbTopology::build(fake.usb_root(), ROOTS));
+  }
+  METER.report(state);
+}
+
+void BM_ListIds(benchmark::State& state) {
+  const auto& fake = tree(state);
+  const Meter METER;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(SysFSHelper::list_ids(fake.usb_root()));
+  }
+  METER.report(state);
+}
+
+void BM_ListDirGlob(benchmark::State& state) {
+  const auto& fake = tree(state);
+  // интерфейсы "N-M:1.0": суффикс, сравнение без fnmatch
+  const fs_tools::Glob INTERFACES("*:1.0");
+  const Meter METER;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        fs_tools::list_dir_fs(fake.usb_root(), INTERFACES));
+  }
+  METER.report(state);
+}
+
+// device-ссылки всех элементов классов
+auto device_links(const FakeSysfs& fake) -> std::vector<std::string> {
+  std::vector<std::string> links;
+  for (const auto& func : fake.functions()) {
+    const auto ENTRY = func.m_dev_name.substr(func.m_dev_name.rfind('/') + 1);
+    links.push_back((fake.root() / "sys/class" / func.m_class_name / ENTRY /
+                     "device")
+                        .string());
+  }
+  return links;
+}
+
+void BM_CanonicalPath(benchmark::State& state) {
+  const auto LINKS = device_links(tree(state));
+  const Meter METER;
+  std::error_code error;
+  for (auto _ : state) {
+    for (const auto& link : LINKS) {
+      benchmark::DoNotOptimize(fs_tools::canonical_path(link, error));
+    }
+  }
+  METER.report(state);
+}
+
+void BM_PathResolver(benchmark::State& state) {
+  const auto LINKS = device_links(tree(state));
+  const Meter METER;
+  std::error_code error;
+  std::string out;
+  for (auto _ : state) {
+    // новый кэш на итерацию — стоимость одного прохода перечисления
+    fs_tools::PathResolver resolver;
+    for (const auto& link : LINKS) {
+      resolver.resolve(link, out, error);
+      benchmark::DoNotOptimize(out);
+    }
+  }
+  METER.report(state);
+}
+
+// устройства × функции: стенд разработчика, типичный шкаф, стресс
+void sizes(benchmark::internal::Benchmark* bench) {
+  bench->Args({8, 2})->Args({64, 3})->Args({512, 4});
+}
+}  // namespace
+
+BENCHMARK(BM_ListFunctions)->Apply(sizes);
+// последний размер — парк машин, только в памяти
+BENCHMARK(BM_ListFunctionsMemory)->Apply(sizes)->Args({16384, 4});
+BENCHMARK(BM_ListFunctionsParallel)->Apply(sizes);
+BENCHMARK(BM_Find)->Apply(sizes);
+BENCHMARK(BM_FindMany)->Apply(sizes);
+BENCHMARK(BM_FindById)->Apply(sizes);
+BENCHMARK(BM_FindFirstById)->Apply(sizes);
+BENCHMARK(BM_RegistryRead)->Apply(sizes);
+BENCHMARK(BM_CacheOpenFind)->Apply(sizes);
+BENCHMARK(BM_QuerySelective)->Apply(sizes);
+BENCHMARK(BM_TopologyBuild)->Apply(sizes);
+BENCHMARK(BM_ListIds)->Apply(sizes);
+BENCHMARK(BM_ListDirGlob)->Apply(sizes);
+BENCHMARK(BM_CanonicalPath)->Apply(sizes);
+BENCHMARK(BM_PathResolver)->Apply(sizes);
+
+BENCHMARK_MAIN();
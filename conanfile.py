@@ -14,11 +14,20 @@ class ProtoLibConan(ConanFile):
 
     package_type = "library"
     settings = "os", "arch", "compiler", "build_type"
-    options = {"shared": [True, False]}
-    default_options = {"shared": False}
+    options = {
+        "shared": [True, False],
+        "io_uring": [True, False],
+        "stats": [True, False],
+    }
+    default_options = {"shared": False, "io_uring": True, "stats": False}
 
     exports_sources = (
-        "CMakeLists.txt", "install.cmake", "include/**", "cmake/**", "SysFSHelper.cpp",
+        "CMakeLists.txt", "install.cmake", "include/**", "cmake/**",
+        "SysFSHelper.cpp", "SysFSIndex.cpp", "HotplugMonitor.cpp",
+        "BatchReader.cpp", "FunctionTable.cpp", "DeviceSnapshot.cpp",
+        "DeviceRegistry.cpp", "SnapshotCache.cpp", "UsbDevice.cpp",
+        "UsbQuery.cpp", "UsbTopology.cpp", "FsBackend.cpp",
+        "MemoryBackend.cpp", "PathResolver.cpp",
     )
 
     def layout(self):
@@ -41,6 +50,8 @@ class ProtoLibConan(ConanFile):
             "BUILD_TESTING": "OFF",
             "SOFTWARE_VERSION": full,
             "PROJECT_SEMVER": core,
+            "FS_TOOLS_IO_URING": "ON" if self.options.io_uring else "OFF",
+            "FS_TOOLS_STATS": "ON" if self.options.stats else "OFF",
         })
         cmake.build()
         self.output.info(f"[fs_tools] generate(): SOFTWARE_VERSION={self.version}")
@@ -60,3 +71,5 @@ class ProtoLibConan(ConanFile):
 
         c["fs_tools"].set_property("cmake_target_name", "fs_tools::fs_tools")
         c["fs_tools"].libs = ["fs_tools"]  # <-- ВАЖНО: имя файла libfs_tools.a без префикса/расширения
+        if self.options.stats:
+            c["fs_tools"].defines = ["FS_TOOLS_STATS"]
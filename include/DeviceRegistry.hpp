@@ -0,0 +1,151 @@
+/**
+ * @file DeviceRegistry.hpp
+ * @brief Process-wide USB device state shared by many reader threads.
+ * @details
+ * One writer (the registry's own refresher thread, a `HotplugMonitor`
+ * callback, or both) keeps a `SysFSIndex` up to date and publishes each new
+ * state as an immutable `DeviceSnapshot`. Readers never walk sysfs: they take
+ * the current snapshot by pointer, so the refresh cost is paid once however
+ * many threads query it.
+ *
+ * Publication is read-copy-update: the writer builds the next snapshot off to
+ * the side, swaps a raw pointer to it and bumps a generation counter; readers
+ * that still hold the old snapshot keep it alive until they let go.
+ *
+ * The read path takes no lock. `std::atomic_load` on a `shared_ptr` would:
+ * libstdc++ guards it with a mutex from a global pool. Instead a reader pins
+ * the current epoch in one of two counters, copies the `shared_ptr` the raw
+ * pointer names and unpins; the writer frees a replaced pointer only after
+ * two epoch flips have drained both counters (a grace period, as in SRCU).
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DeviceSnapshot.hpp"
+#include "SysFSIndex.hpp"
+
+namespace fs_tools {
+/** @ingroup usb_helpers */
+/**
+ * @brief Shared, periodically refreshed `DeviceSnapshot`.
+ * @details `snapshot()` and `Reader::get()` may be called from any number
+ * of threads; writers (`refresh()`, `invalidate()`, `publish()`) are
+ * serialized internally.
+ */
+class DeviceRegistry {
+ public:
+  using Snapshot = std::shared_ptr<const DeviceSnapshot>;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Scan the default class roots and publish the first snapshot.
+   */
+  DeviceRegistry();
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Scan @p classRoots and publish the first snapshot.
+   */
+  explicit DeviceRegistry(std::vector<std::string> classRoots);
+
+  DeviceRegistry(const DeviceRegistry&) = delete;
+  auto operator=(const DeviceRegistry&) -> DeviceRegistry& = delete;
+  ~DeviceRegistry();
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Current snapshot; never null.
+   * @details Lock-free: a few atomic operations on the epoch counters and
+   * one reference-count increment. Hot loops should prefer a per-thread
+   * `Reader`.
+   */
+  [[nodiscard]] auto snapshot() const -> Snapshot;
+
+  /** @brief Number of snapshots published so far (starts at 1). */
+  [[nodiscard]] auto generation() const -> uint64_t {
+    return m_generation.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Refresh the index and publish a snapshot if anything changed.
+   * @return `true` if a new snapshot was published.
+   */
+  auto refresh() -> bool;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Re-resolve @p dev_node (e.g. on a hotplug `change`) and publish.
+   * @return `true` if the node is indexed and still resolvable.
+   */
+  auto invalidate(const std::string& dev_node) -> bool;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Publish a snapshot built elsewhere.
+   * @details Stays current until the next `publish()` or effective
+   * `refresh()`.
+   */
+  void publish(DeviceSnapshot snapshot);
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Start a thread that calls `refresh()` every @p interval.
+   * @details Restarts the thread if one is already running.
+   */
+  void start(std::chrono::milliseconds interval);
+
+  /** @brief Stop the refresher thread, if any, and wait for it. */
+  void stop();
+
+  /**
+   * @brief Per-thread read handle.
+   * @details Caches the snapshot and reloads it only when the registry's
+   * generation moved, so steady-state reads are a single atomic load of the
+   * counter. Not shareable between threads; the registry must outlive it.
+   */
+  class Reader {
+   public:
+    explicit Reader(const DeviceRegistry& registry) : m_registry(&registry) {}
+
+    /**
+     * @brief Current snapshot.
+     * @details Valid until the next `get()` on this reader.
+     */
+    auto get() -> const DeviceSnapshot&;
+
+   private:
+    const DeviceRegistry* m_registry;
+    uint64_t m_generation = 0;
+    Snapshot m_snapshot;
+  };
+
+ private:
+  /** Publish the index state; caller holds `m_write_mutex`. */
+  void publish_index();
+  void publish_locked(DeviceSnapshot snapshot);
+
+  std::mutex m_write_mutex;
+  SysFSIndex m_index;
+  /** Owned; replaced only by the writer, freed after a grace period. */
+  std::atomic<const Snapshot*> m_current{nullptr};
+  /** Readers pin `m_epoch & 1` in `m_readers` around the copy. */
+  std::atomic<uint64_t> m_epoch{0};
+  mutable std::atomic<uint64_t> m_readers[2]{};
+  std::atomic<uint64_t> m_generation{0};
+
+  std::thread m_refresher;
+  std::mutex m_stop_mutex;
+  std::condition_variable m_stop_cv;
+  bool m_stop = false;
+};
+}  // namespace fs_tools
@@ -0,0 +1,108 @@
+/**
+ * @file DeviceSnapshot.hpp
+ * @brief Immutable, ordered view of the USB functions present at one moment.
+ * @details
+ * Periodic pollers keep the previous `DeviceSnapshot`, capture a new one and
+ * ask `DeviceSnapshot::diff()` what was plugged in, unplugged, or replaced
+ * under the same device node (e.g. a re-enumeration with a different
+ * VID:PID). Rows are kept sorted by (dev path, class), so the diff is a
+ * single merge over two sorted tables instead of sorting and comparing
+ * strings in application code.
+ */
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "FunctionTable.hpp"
+#include "SysFSHelper.hpp"
+
+namespace fs_tools {
+/** @ingroup usb_helpers */
+/**
+ * @brief Sorted set of `UsbFunction`s keyed by (dev path, class).
+ */
+class DeviceSnapshot {
+ public:
+  using UsbFunction = SysFSHelper::UsbFunction;
+
+  /** Same key in both snapshots, different VID:PID or USB node. */
+  struct Change {
+    UsbFunction m_before;
+    UsbFunction m_after;
+  };
+
+  /** What turns the first snapshot into the second one. */
+  struct Diff {
+    std::vector<UsbFunction> m_added;
+    std::vector<UsbFunction> m_removed;
+    std::vector<Change> m_changed;
+
+    [[nodiscard]] auto empty() const -> bool {
+      return m_added.empty() && m_removed.empty() && m_changed.empty();
+    }
+  };
+
+  DeviceSnapshot() = default;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Snapshot of @p functions in any order.
+   * @details Of several functions sharing a key, the first one is kept.
+   * Accepts the output of `SysFSHelper::list_functions()` or
+   * `SysFSIndex::functions()`.
+   */
+  explicit DeviceSnapshot(const std::vector<UsbFunction>& functions);
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Enumerate the system now via `SysFSHelper::list_functions()`.
+   * @param dev_usb_root USB sysfs root to use.
+   * @param classRoots   Sysfs class roots to scan.
+   */
+  static auto capture(const std::string& dev_usb_root,
+                      const std::vector<std::string>& classRoots)
+      -> DeviceSnapshot;
+  /** @brief `capture()` over SysFSHelper's default roots. */
+  static auto capture() -> DeviceSnapshot;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Compare two snapshots.
+   * @return Added and removed functions plus changed pairs, each in
+   * snapshot order.
+   */
+  static auto diff(const DeviceSnapshot& before, const DeviceSnapshot& after)
+      -> Diff;
+
+  [[nodiscard]] auto size() const -> size_t { return m_table.size(); }
+  [[nodiscard]] auto empty() const -> bool { return m_table.empty(); }
+
+  /** @brief Function at position @p index (snapshot order). */
+  [[nodiscard]] auto function(size_t index) const -> UsbFunction {
+    return m_table.function(index);
+  }
+
+  /** @brief Every function, in snapshot order. */
+  [[nodiscard]] auto functions() const -> std::vector<UsbFunction> {
+    return m_table.functions();
+  }
+
+  /**
+   * @brief Function providing @p dev_node ("ttyUSB0" or "/dev/ttyUSB0").
+   * @details Binary search; with several classes on one node, the first
+   * in class order.
+   */
+  [[nodiscard]] auto find(std::string_view dev_node) const
+      -> std::optional<UsbFunction>;
+
+  [[nodiscard]] auto table() const -> const FunctionTable& { return m_table; }
+
+ private:
+  /** Rows ordered by (dev name, class name), no duplicate keys. */
+  FunctionTable m_table;
+};
+}  // namespace fs_tools
@@ -0,0 +1,161 @@
+/**
+ * @file EnumStats.hpp
+ * @brief Opt-in counters and per-phase timings for sysfs enumeration.
+ * @details
+ * Install an `EnumStats` for the current thread with `EnumStats::Scope`, run
+ * any `SysFSHelper` call, and read what it did: directories opened, files and
+ * bytes read, realpath calls, links read on path cache misses, ancestor
+ * levels climbed, ancestor cache hits, entries dropped per reason, and
+ * monotonic time per phase. Parallel enumeration forwards the scope to its
+ * workers.
+ *
+ * The hooks inside the library are `FS_TOOLS_STATS_*` macros that expand to
+ * nothing unless the library is built with `-DFS_TOOLS_STATS=ON`; check
+ * `EnumStats::ENABLED` to know whether the counters will move at all.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace fs_tools {
+/** @ingroup usb_helpers */
+/**
+ * @brief What one or more `SysFSHelper` calls spent their work on.
+ * @details Counters are atomic so one object can collect from several
+ * threads. Phases nest: `ANCESTOR_WALK` includes the `READ` time of the
+ * ancestor `uevent` files, `READDIR` covers listing class and bus roots.
+ */
+struct EnumStats {
+#ifdef FS_TOOLS_STATS
+  static constexpr bool ENABLED = true;
+#else
+  static constexpr bool ENABLED = false;
+#endif
+
+  /** Timed phases. */
+  enum Phase : unsigned {
+    READDIR,
+    READ,
+    REALPATH,
+    ANCESTOR_WALK,
+    PHASE_COUNT,
+  };
+
+  using Counter = std::atomic<uint64_t>;
+
+  Counter m_dirs_opened{0};
+  Counter m_files_read{0};
+  Counter m_bytes_read{0};
+  /** Canonicalizations requested (one per `device` link resolved). */
+  Counter m_realpath_calls{0};
+  /** `readlink` calls made by `PathResolver` on cache misses. */
+  Counter m_readlink_calls{0};
+  /** Directories visited while climbing to the USB ancestor. */
+  Counter m_ancestor_levels{0};
+  /** Ancestor walks answered by the per-pass cache. */
+  Counter m_cache_hits{0};
+  /** Class entries without a readable `DEVNAME`. */
+  Counter m_dropped_no_devname{0};
+  /** Class entries whose `device` link does not resolve. */
+  Counter m_dropped_no_device_link{0};
+  /** Class entries with no `PRODUCT=` ancestor. */
+  Counter m_dropped_no_usb_ancestor{0};
+  /** Nanoseconds per `Phase`. */
+  std::array<Counter, PHASE_COUNT> m_phase_ns{};
+
+  /** @brief Time spent in @p phase so far. */
+  [[nodiscard]] auto phase_time(Phase phase) const -> std::chrono::nanoseconds {
+    return std::chrono::nanoseconds(m_phase_ns[phase].load());
+  }
+
+  /** @brief Zero every counter and timing. */
+  void reset() {
+    for (auto* counter :
+         {&m_dirs_opened, &m_files_read, &m_bytes_read, &m_realpath_calls,
+          &m_readlink_calls, &m_ancestor_levels, &m_cache_hits,
+          &m_dropped_no_devname, &m_dropped_no_device_link,
+          &m_dropped_no_usb_ancestor}) {
+      counter->store(0);
+    }
+    for (auto& phase : m_phase_ns) {
+      phase.store(0);
+    }
+  }
+
+  /** @brief Stats object collecting for this thread, or `nullptr`. */
+  static auto current() -> EnumStats*& {
+    thread_local EnumStats* stats = nullptr;
+    return stats;
+  }
+
+  /** @brief Add @p value to @p counter of the current stats, if any. */
+  static void add(Counter EnumStats::* counter, uint64_t value) {
+    if (auto* stats = current()) {
+      (stats->*counter).fetch_add(value, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * @brief Collect into @p stats on this thread until the scope ends.
+   * @details Scopes nest; the previous target is restored on exit.
+   */
+  class Scope {
+   public:
+    explicit Scope(EnumStats* stats) : m_previous(current()) {
+      current() = stats;
+    }
+    Scope(const Scope&) = delete;
+    auto operator=(const Scope&) -> Scope& = delete;
+    ~Scope() { current() = m_previous; }
+
+   private:
+    EnumStats* m_previous;
+  };
+
+  /** @brief Adds its lifetime to a phase of the current stats. */
+  class PhaseTimer {
+   public:
+    explicit PhaseTimer(Phase phase) : m_stats(current()), m_phase(phase) {
+      if (m_stats != nullptr) {
+        m_start = std::chrono::steady_clock::now();
+      }
+    }
+    PhaseTimer(const PhaseTimer&) = delete;
+    auto operator=(const PhaseTimer&) -> PhaseTimer& = delete;
+    ~PhaseTimer() {
+      if (m_stats != nullptr) {
+        const auto ELAPSED = std::chrono::steady_clock::now() - m_start;
+        m_stats->m_phase_ns[m_phase].fetch_add(
+            static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(ELAPSED)
+                    .count()),
+            std::memory_order_relaxed);
+      }
+    }
+
+   private:
+    EnumStats* m_stats;
+    Phase m_phase;
+    std::chrono::steady_clock::time_point m_start;
+  };
+};
+}  // namespace fs_tools
+
+// Хуки библиотеки: без FS_TOOLS_STATS аргументы не вычисляются (sizeof лишь
+// помечает их использованными), поэтому побочных эффектов в них быть не должно
+#ifdef FS_TOOLS_STATS
+#define FS_TOOLS_STATS_CONCAT_(first, second) first##second
+#define FS_TOOLS_STATS_CONCAT(first, second) \
+  FS_TOOLS_STATS_CONCAT_(first, second)
+#define FS_TOOLS_STATS_ADD(counter, value) \
+  ::fs_tools::EnumStats::add(&::fs_tools::EnumStats::counter, (value))
+#define FS_TOOLS_STATS_PHASE(phase)                                  \
+  const ::fs_tools::EnumStats::PhaseTimer FS_TOOLS_STATS_CONCAT(     \
+      fs_tools_stats_phase_, __LINE__)(::fs_tools::EnumStats::phase)
+#else
+#define FS_TOOLS_STATS_ADD(counter, value) static_cast<void>(sizeof(value))
+#define FS_TOOLS_STATS_PHASE(phase) static_cast<void>(0)
+#endif
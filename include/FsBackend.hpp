@@ -0,0 +1,108 @@
+/**
+ * @file FsBackend.hpp
+ * @brief Filesystem operations enumeration needs, behind one interface.
+ * @details
+ * Enumeration touches the filesystem through five operations: list a
+ * directory, stat, readlink, realpath and read a small attribute.
+ * `FsBackend` names exactly those, so the same algorithms can run over
+ * the real `/sys` (`PosixBackend`) or over a synthetic tree held in memory
+ * (`MemoryBackend`): fleet-sized trees in CI without touching disk, and
+ * algorithmic cost measured apart from kernel cost.
+ *
+ * Paths are absolute and '/'-separated. Errors are reported like the POSIX
+ * calls would (`ENOENT`, `ENOTDIR`, `ELOOP`, ...) through `std::error_code`.
+ */
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "fs_tools.hpp"
+
+namespace fs_tools {
+/** @ingroup usb_helpers */
+/**
+ * @brief Read-only filesystem interface used by enumeration.
+ * @details Implementations must allow concurrent calls of the `const`
+ * members.
+ */
+class FsBackend {
+ public:
+  /** Result of `stat()`. */
+  struct Stat {
+    /** `DT_DIR`, `DT_LNK`, `DT_REG`, ... */
+    unsigned char m_type = DT_UNKNOWN;
+    ino_t m_inode = 0;
+    /** File size; target length for symlinks. */
+    size_t m_size = 0;
+  };
+
+  FsBackend() = default;
+  FsBackend(const FsBackend&) = delete;
+  auto operator=(const FsBackend&) -> FsBackend& = delete;
+  FsBackend(FsBackend&&) = delete;
+  auto operator=(FsBackend&&) -> FsBackend& = delete;
+  virtual ~FsBackend() = default;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Entries of directory @p dir (without "." and ".."), typed like
+   * `readdir`; order unspecified.
+   */
+  virtual auto list(const std::string& dir, std::vector<DirEntry>& out,
+                    std::error_code& error) const -> bool = 0;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief `stat(2)` (@p follow) or `lstat(2)` of @p path.
+   */
+  virtual auto stat(const std::string& path, Stat& out, bool follow,
+                    std::error_code& error) const -> bool = 0;
+
+  /** @brief Target of symlink @p path, as stored. */
+  virtual auto readlink(const std::string& path, std::string& out,
+                        std::error_code& error) const -> bool = 0;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Absolute path of @p path with every symlink, "." and ".."
+   * resolved; empty on error.
+   */
+  virtual auto realpath(const std::string& path, std::error_code& error) const
+      -> std::string = 0;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Whole content of regular file @p path into @p out (capacity is
+   * kept).
+   */
+  virtual auto read_attr(const std::string& path, std::string& out,
+                         std::error_code& error) const -> bool = 0;
+
+  /** @brief Process-wide `PosixBackend`. */
+  static auto posix() -> const FsBackend&;
+};
+
+/** @ingroup usb_helpers */
+/**
+ * @brief `FsBackend` over the real filesystem (`opendir`, `lstat`,
+ * `realpath`, ...).
+ */
+class PosixBackend final : public FsBackend {
+ public:
+  auto list(const std::string& dir, std::vector<DirEntry>& out,
+            std::error_code& error) const -> bool override;
+  auto stat(const std::string& path, Stat& out, bool follow,
+            std::error_code& error) const -> bool override;
+  auto readlink(const std::string& path, std::string& out,
+                std::error_code& error) const -> bool override;
+  auto realpath(const std::string& path, std::error_code& error) const
+      -> std::string override;
+  auto read_attr(const std::string& path, std::string& out,
+                 std::error_code& error) const -> bool override;
+};
+}  // namespace fs_tools
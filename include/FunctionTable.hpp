@@ -0,0 +1,149 @@
+/**
+ * @file FunctionTable.hpp
+ * @brief Compact storage for large sets of `UsbFunction`s.
+ * @details
+ * A `UsbFunction` carries six strings. Kept by the thousand (indexes,
+ * snapshots), most of them repeat: every function of an interface shares its
+ * USB node path, and there are only a handful of class names. `StringPool`
+ * stores each distinct string once in arena chunks, and `FunctionTable`
+ * keeps one fixed-size `Row` (numeric `UsbId` + pool ids) per function,
+ * expanding back to `UsbFunction` only on request.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "SysFSHelper.hpp"
+
+namespace fs_tools {
+/** @ingroup usb_helpers */
+/**
+ * @brief Append-only string interner.
+ * @details Strings live in fixed-size arena chunks, so interning thousands of
+ * paths costs a few allocations, and views stay valid for the pool's
+ * lifetime (including after a move).
+ */
+class StringPool {
+ public:
+  using Id = uint32_t;
+
+  StringPool() = default;
+  StringPool(const StringPool& other);
+  auto operator=(const StringPool& other) -> StringPool&;
+  StringPool(StringPool&& other) noexcept = default;
+  auto operator=(StringPool&& other) noexcept -> StringPool& = default;
+  ~StringPool() = default;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Id of @p str, adding it on first use.
+   */
+  auto intern(std::string_view str) -> Id;
+
+  /** @brief Id of @p str if it was interned. */
+  [[nodiscard]] auto find(std::string_view str) const -> std::optional<Id>;
+
+  /** @brief String behind @p id. */
+  [[nodiscard]] auto view(Id id) const -> std::string_view {
+    return m_views[id];
+  }
+
+  /** @brief Number of distinct strings. */
+  [[nodiscard]] auto size() const -> size_t { return m_views.size(); }
+
+  void clear();
+
+ private:
+  static constexpr size_t CHUNK_SIZE = 16U * 1024U;
+
+  /** Arena chunks; the last one is being filled. */
+  std::vector<std::unique_ptr<char[]>> m_chunks;
+  size_t m_chunk_used = 0;
+  /** Strings too long to share a chunk. */
+  std::vector<std::unique_ptr<char[]>> m_large;
+  std::vector<std::string_view> m_views;
+  std::unordered_map<std::string_view, Id> m_ids;
+};
+
+/** @ingroup usb_helpers */
+/**
+ * @brief `UsbFunction`s stored as 16-byte rows over a `StringPool`.
+ */
+class FunctionTable {
+ public:
+  using UsbFunction = SysFSHelper::UsbFunction;
+  using UsbId = SysFSHelper::UsbId;
+
+  /** One function; string fields are pool ids. */
+  struct Row {
+    UsbId m_id;
+    StringPool::Id m_usb_node = 0;
+    StringPool::Id m_class_name = 0;
+    /** "ttyUSB0"; the dev path is "/dev/" + this. */
+    StringPool::Id m_dev_name = 0;
+
+    friend auto operator==(const Row& first, const Row& second) -> bool {
+      return first.m_id == second.m_id &&
+             first.m_usb_node == second.m_usb_node &&
+             first.m_class_name == second.m_class_name &&
+             first.m_dev_name == second.m_dev_name;
+    }
+    friend auto operator!=(const Row& first, const Row& second) -> bool {
+      return !(first == second);
+    }
+  };
+
+  FunctionTable() = default;
+
+  /** @brief Table holding @p functions in the given order. */
+  explicit FunctionTable(const std::vector<UsbFunction>& functions);
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Append one function.
+   * @return Its row index.
+   */
+  auto add(const UsbFunction& func) -> size_t;
+
+  [[nodiscard]] auto size() const -> size_t { return m_rows.size(); }
+  [[nodiscard]] auto empty() const -> bool { return m_rows.empty(); }
+  [[nodiscard]] auto rows() const -> const std::vector<Row>& { return m_rows; }
+  [[nodiscard]] auto row(size_t index) const -> const Row& {
+    return m_rows[index];
+  }
+  [[nodiscard]] auto pool() const -> const StringPool& { return m_pool; }
+
+  /** @brief Full `UsbFunction` for row @p index. */
+  [[nodiscard]] auto function(size_t index) const -> UsbFunction {
+    return expand(m_rows[index], m_pool);
+  }
+
+  /** @brief Every row expanded, in table order. */
+  [[nodiscard]] auto functions() const -> std::vector<UsbFunction>;
+
+  void clear();
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Intern the strings of @p func into @p pool.
+   */
+  static auto compact(const UsbFunction& func, StringPool& pool) -> Row;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Rebuild a `UsbFunction` from a row of @p pool.
+   */
+  static auto expand(const Row& row, const StringPool& pool) -> UsbFunction;
+
+ private:
+  StringPool m_pool;
+  std::vector<Row> m_rows;
+};
+}  // namespace fs_tools
@@ -0,0 +1,154 @@
+/**
+ * @file HotplugMonitor.hpp
+ * @brief Incremental USB function updates from kernel uevents.
+ * @details
+ * Listens on a `NETLINK_KOBJECT_UEVENT` socket (or any datagram fd carrying
+ * the same payload, e.g. one end of a socketpair in tests), parses
+ * add/remove/bind/unbind messages and reports `UsbFunction` deltas through a
+ * callback, so callers no longer need to poll `list_functions()`.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include "SysFSHelper.hpp"
+
+namespace fs_tools {
+/** @ingroup usb_helpers */
+/**
+ * @brief Kernel uevent listener that emits `UsbFunction` additions/removals.
+ * @details
+ * - `add`/`bind` of a class device (`DEVNAME` + a `SUBSYSTEM` naming one of
+ *   the monitor's class roots) is resolved through sysfs exactly like
+ *   `SysFSHelper::find()` and reported as `Action::ADDED`.
+ * - `remove` of a class device, and `remove`/`unbind` of a USB device or
+ *   interface, report every tracked function at or below that `DEVPATH` as
+ *   `Action::REMOVED`. For USB devices the `PRODUCT=` ids are checked against
+ *   the tracked functions.
+ * - If the socket receive queue overflowed (`ENOBUFS`), uevents were lost:
+ *   one `Action::RESYNC` event with an empty function is reported. Re-list
+ *   the functions and `track()` them again.
+ *
+ * Functions that existed before the monitor was created are unknown to it;
+ * pass them to `track()` to get removals for them as well.
+ * @note Not thread-safe; drive it from one thread (e.g. your event loop via
+ * `fd()` + `dispatch()`, or `poll()`).
+ */
+class HotplugMonitor {
+ public:
+  using UsbFunction = SysFSHelper::UsbFunction;
+
+  /** Kind of change reported to the callback. */
+  enum class Action {
+    ADDED,
+    REMOVED,
+    /** Events were dropped by the kernel; the tracked set may be stale. */
+    RESYNC
+  };
+
+  /** One delta: what happened and to which function. */
+  struct Event {
+    Action m_action;
+    UsbFunction m_function;
+  };
+
+  using Callback = std::function<void(const Event&)>;
+
+  /** Receive buffer requested at `open()`; a replug burst fits in it. */
+  static constexpr int RECEIVE_BUFFER_SIZE = 4 * 1024 * 1024;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Open a kernel uevent netlink socket.
+   * @details The receive buffer is raised to `RECEIVE_BUFFER_SIZE`
+   * (`SO_RCVBUFFORCE` when permitted, else `SO_RCVBUF` up to
+   * `net.core.rmem_max`).
+   * @param callback Receiver of `Event`s.
+   * @param error    Set on failure (e.g. EPERM in restricted containers).
+   * @param sysRoot  Sysfs mount point used to resolve `DEVPATH` (default
+   * "/sys").
+   * @param classRoots Class roots whose devices are reported, matched by
+   * `SUBSYSTEM` (default: default_class_roots()).
+   * @return Monitor, or `std::nullopt` if the socket cannot be opened/bound.
+   */
+  static auto open(Callback callback, std::error_code& error,
+                   std::string sysRoot = "/sys",
+                   std::vector<std::string> classRoots =
+                       SysFSHelper::default_class_roots())
+      -> std::optional<HotplugMonitor>;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Wrap an existing datagram fd carrying uevent payloads.
+   * @details Takes ownership of @p fd. Intended for tests (socketpair) and
+   * for callers that already own a netlink socket.
+   */
+  static auto adopt(int fd, Callback callback, std::string sysRoot = "/sys",
+                    std::vector<std::string> classRoots =
+                        SysFSHelper::default_class_roots()) -> HotplugMonitor;
+
+  HotplugMonitor(const HotplugMonitor&) = delete;
+  auto operator=(const HotplugMonitor&) -> HotplugMonitor& = delete;
+  HotplugMonitor(HotplugMonitor&& other) noexcept;
+  auto operator=(HotplugMonitor&& other) noexcept -> HotplugMonitor&;
+  ~HotplugMonitor();
+
+  /** @brief Underlying fd, for integration into an external poll loop. */
+  [[nodiscard]] auto fd() const -> int { return m_fd; }
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Wait up to @p timeout for messages, then dispatch all pending ones.
+   * @return Number of events delivered to the callback.
+   */
+  auto poll(std::chrono::milliseconds timeout) -> size_t;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Dispatch all messages already queued on the fd without blocking.
+   * @details Reports `Action::RESYNC` if the queue overflowed.
+   * @return Number of events delivered to the callback.
+   */
+  auto dispatch() -> size_t;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Process one raw uevent payload ("action@devpath\0KEY=VAL\0...").
+   * @details Entry point for injected message sources.
+   * @return Number of events delivered to the callback.
+   */
+  auto handle_message(const char* data, size_t size) -> size_t;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Register already-present functions so their removal is reported.
+   */
+  void track(const std::vector<UsbFunction>& functions);
+
+ private:
+  HotplugMonitor(int fd, Callback callback, std::string sysRoot,
+                 std::vector<std::string> classRoots);
+
+  /** Element of `m_class_roots` for @p subsystem, or `nullptr`. */
+  [[nodiscard]] auto class_root(std::string_view subsystem) const
+      -> const std::string*;
+
+  void emit(Action action, const UsbFunction& func, size_t& count) const;
+
+  int m_fd = -1;
+  Callback m_callback;
+  std::string m_sys_root;
+  std::vector<std::string> m_class_roots;
+  std::vector<char> m_buffer;
+  /** Dev path ("/dev/ttyUSB0") → function reported as ADDED. */
+  std::unordered_map<std::string, UsbFunction> m_tracked;
+};
+}  // namespace fs_tools
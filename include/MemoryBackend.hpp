@@ -0,0 +1,133 @@
+/**
+ * @file MemoryBackend.hpp
+ * @brief In-memory `FsBackend` for synthetic sysfs trees.
+ * @details
+ * Holds a directory tree of millions of nodes without touching disk. A
+ * node is one fixed-size record (parent, name, first child, next sibling,
+ * content) in a single vector; names, file contents and link targets are
+ * interned in a `StringPool`, so the thousands of `uevent`, `device` and
+ * `../..` repeats of a sysfs tree are stored once. Child lookup goes
+ * through one open-addressing table keyed by (parent, name) instead of a
+ * map per directory.
+ *
+ * Build the tree with `add_dir()` / `add_file()` / `add_symlink()`, then
+ * read it from any number of threads; building is not synchronized with
+ * reading.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "FsBackend.hpp"
+#include "FunctionTable.hpp"
+
+namespace fs_tools {
+/** @ingroup usb_helpers */
+/**
+ * @brief Compact in-memory filesystem tree.
+ *
+ * @code
+ * fs_tools::MemoryBackend mem;
+ * mem.add_file("/sys/devices/usb1/1-1/uevent", "PRODUCT=1a86/7523/264\n");
+ * mem.add_symlink("/sys/bus/usb/devices/1-1", "../../../devices/usb1/1-1");
+ * auto ids = fs_tools::SysFSHelper::list_ids(mem, "/sys/bus/usb/devices");
+ * @endcode
+ */
+class MemoryBackend final : public FsBackend {
+ public:
+  using Index = uint32_t;
+
+  static constexpr Index NONE = UINT32_MAX;
+  /** Symlinks followed by one lookup before `ELOOP`, as in Linux. */
+  static constexpr int MAX_SYMLINKS = 40;
+
+  /** Empty tree: just "/". */
+  MemoryBackend();
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Create directory @p path and missing parents (like `mkdir -p`).
+   * @return `false` if a component exists and is not a directory.
+   */
+  auto add_dir(std::string_view path) -> bool;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Create (or overwrite) regular file @p path, creating parents.
+   */
+  auto add_file(std::string_view path, std::string_view content) -> bool;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Create symlink @p path → @p target (stored as given; relative
+   * targets resolve against the link's directory), creating parents.
+   * @return `false` if @p path already exists.
+   */
+  auto add_symlink(std::string_view path, std::string_view target) -> bool;
+
+  /** @brief Number of nodes, "/" included. */
+  [[nodiscard]] auto size() const -> size_t { return m_nodes.size(); }
+
+  /** @brief Bytes held by the node records and the lookup table. */
+  [[nodiscard]] auto index_bytes() const -> size_t;
+
+  auto list(const std::string& dir, std::vector<DirEntry>& out,
+            std::error_code& error) const -> bool override;
+  auto stat(const std::string& path, Stat& out, bool follow,
+            std::error_code& error) const -> bool override;
+  auto readlink(const std::string& path, std::string& out,
+                std::error_code& error) const -> bool override;
+  auto realpath(const std::string& path, std::error_code& error) const
+      -> std::string override;
+  auto read_attr(const std::string& path, std::string& out,
+                 std::error_code& error) const -> bool override;
+
+ private:
+  struct Node {
+    Index m_parent = 0;
+    StringPool::Id m_name = 0;
+    Index m_first_child = NONE;
+    Index m_next_sibling = NONE;
+    /** File content or link target. */
+    StringPool::Id m_data = 0;
+    /** `DT_DIR`, `DT_REG` or `DT_LNK`. */
+    unsigned char m_type = DT_DIR;
+  };
+
+  /** Child @p name of directory @p dir, or `NONE`. */
+  [[nodiscard]] auto child(Index dir, std::string_view name) const -> Index;
+
+  /**
+   * Resolve @p path starting at @p start (absolute paths restart at "/").
+   * @p hops counts followed symlinks across the whole lookup.
+   */
+  auto walk(Index start, std::string_view path, bool follow_last, int& hops,
+            std::error_code& error) const -> Index;
+
+  auto lookup(std::string_view path, bool follow_last,
+              std::error_code& error) const -> Index;
+
+  /** Directory @p path, creating missing components. */
+  auto make_dirs(std::string_view path) -> Index;
+
+  /** New node @p name of @p type under directory @p dir. */
+  auto add_node(Index dir, std::string_view name, unsigned char type) -> Index;
+
+  /** Split @p path into its parent directory (created) and last name. */
+  auto make_parent(std::string_view path, std::string_view& name) -> Index;
+
+  [[nodiscard]] auto slot_of(Index dir, StringPool::Id name) const -> size_t;
+  void grow_slots();
+
+  std::vector<Node> m_nodes;
+  /** Names, file contents and link targets. */
+  StringPool m_strings;
+  /** Open addressing: (parent, name) → node; `NONE` marks a free slot. */
+  std::vector<Index> m_slots;
+};
+}  // namespace fs_tools
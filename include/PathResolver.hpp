@@ -0,0 +1,85 @@
+/**
+ * @file PathResolver.hpp
+ * @brief Canonical path resolution with a per-pass dentry cache.
+ * @details
+ * `realpath(3)` walks and `lstat`s every component of its argument, and
+ * sysfs device paths are deep (`/sys/devices/pci0000:00/0000:00:14.0/usb1/
+ * 1-1/1-1.4/1-1.4:1.0/tty/ttyUSB0`). During one enumeration pass the
+ * `device` links of all class entries share almost all of those
+ * components. `PathResolver` remembers, like the kernel's dentry cache,
+ * what every (canonical directory, name) pair it has seen resolves to:
+ * a plain entry maps to itself, a symlink to the canonical path of its
+ * target. A miss costs one `readlink`; a relative target is resolved
+ * against the cached canonical directory of the link. Paths it returned
+ * are themselves cached, so resolving them again is a single lookup.
+ *
+ * The cache is not invalidated: use one resolver per pass (it lives in
+ * `SysFSHelper::AncestorCache`) or `clear()` it. Not thread-safe; use one
+ * per thread.
+ */
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+
+#include "FsBackend.hpp"
+
+namespace fs_tools {
+/** @ingroup usb_helpers */
+/**
+ * @brief Caching replacement for `canonical_path()`.
+ */
+class PathResolver {
+ public:
+  /** Symlinks followed by one lookup before `ELOOP`, as in Linux. */
+  static constexpr int MAX_SYMLINKS = 40;
+
+  explicit PathResolver(const FsBackend& backend = FsBackend::posix())
+      : m_backend(&backend) {}
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Canonical form of absolute @p path into @p out.
+   * @details Once the components are cached, no system call is made and,
+   * with @p out reused, nothing is allocated. Relative paths are passed to
+   * the backend's `realpath()` uncached.
+   * @return `false` (with @p error set, @p out empty) if a component is
+   * missing, not a directory, or links loop.
+   */
+  auto resolve(const std::string& path, std::string& out,
+               std::error_code& error) -> bool;
+
+  /** @brief `resolve()` into a new string; empty on error. */
+  auto resolve(const std::string& path, std::error_code& error)
+      -> std::string {
+    std::string out;
+    resolve(path, out, error);
+    return out;
+  }
+
+  /** @brief Number of cached (directory, name) entries. */
+  [[nodiscard]] auto size() const -> size_t { return m_dentries.size(); }
+
+  void clear() { m_dentries.clear(); }
+
+ private:
+  /**
+   * Resolve the components of @p path onto canonical prefix @p cur ("" is
+   * "/"); @p hops counts followed links across the whole lookup.
+   */
+  auto walk(std::string_view path, std::string& cur, int& hops,
+            std::error_code& error) -> bool;
+
+  const FsBackend* m_backend;
+  /**
+   * Canonical directory + "/" + name → canonical path; empty value: the
+   * entry is not a link, its key is already canonical.
+   */
+  std::unordered_map<std::string, std::string> m_dentries;
+  /** `readlink` buffer, reused across misses. */
+  std::string m_target;
+};
+}  // namespace fs_tools
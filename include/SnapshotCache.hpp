@@ -0,0 +1,136 @@
+/**
+ * @file SnapshotCache.hpp
+ * @brief Memory-mapped on-disk copy of a `DeviceSnapshot` for cold starts.
+ * @details
+ * Short-lived tools pay a full sysfs enumeration on every run. A
+ * `SnapshotCache` file stores the enumeration result in a compact binary
+ * layout (fixed-size rows plus one string table) together with validation
+ * stamps: the kernel boot id and, for the USB root and every class root,
+ * its inode, ctime, entry count and a hash of all (name, d_ino) pairs. A
+ * device plugged, unplugged or re-enumerated changes at least one of those,
+ * so `open()` only has to list a few directories to prove the file current;
+ * queries then run straight on the mapping.
+ *
+ * Layout (native byte order, format `VERSION`):
+ *
+ *     header | root stamps | rows (sorted by dev name) | string refs | bytes
+ *
+ * Typical use:
+ *
+ *     std::error_code ec;
+ *     if (auto cache = fs_tools::SnapshotCache::open(path, ec)) {
+ *       return cache->find("ttyUSB0");
+ *     }
+ *     return fs_tools::SnapshotCache::rebuild(path, ec).find("ttyUSB0");
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "DeviceSnapshot.hpp"
+#include "SysFSHelper.hpp"
+
+namespace fs_tools {
+/** @ingroup usb_helpers */
+/**
+ * @brief Read-only view of a validated cache file.
+ * @note Move-only; the mapping is released on destruction.
+ */
+class SnapshotCache {
+ public:
+  using UsbFunction = SysFSHelper::UsbFunction;
+
+  /** Bumped on any layout change; older files are treated as stale. */
+  static constexpr uint32_t VERSION = 1;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Map @p path and check it against the live roots.
+   * @param path       Cache file.
+   * @param error      errno of `open`/`mmap`, `invalid_argument` for a
+   * truncated or foreign file (or another `VERSION`), `ESTALE` if the boot
+   * id or any root stamp differs.
+   * @param dev_usb_root USB sysfs root the cache must describe.
+   * @param classRoots Class roots the cache must describe, same order.
+   * @return Cache, or `std::nullopt` on any error.
+   */
+  static auto open(
+      const std::string& path, std::error_code& error,
+      const std::string& dev_usb_root = SysFSHelper::default_usb_root(),
+      const std::vector<std::string>& classRoots =
+          SysFSHelper::default_class_roots()) -> std::optional<SnapshotCache>;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Scan the roots live and rewrite @p path.
+   * @details Roots are stamped before the scan, so a change racing with it
+   * makes the next `open()` fail rather than serve a stale result. The file
+   * is written next to @p path and renamed into place.
+   * @param error Set if the file could not be written; the scan result is
+   * returned either way.
+   * @return The live snapshot.
+   */
+  static auto rebuild(
+      const std::string& path, std::error_code& error,
+      const std::string& dev_usb_root = SysFSHelper::default_usb_root(),
+      const std::vector<std::string>& classRoots =
+          SysFSHelper::default_class_roots()) -> DeviceSnapshot;
+
+  SnapshotCache(const SnapshotCache&) = delete;
+  auto operator=(const SnapshotCache&) -> SnapshotCache& = delete;
+  SnapshotCache(SnapshotCache&& other) noexcept;
+  auto operator=(SnapshotCache&& other) noexcept -> SnapshotCache&;
+  ~SnapshotCache();
+
+  /** @brief Number of cached functions. */
+  [[nodiscard]] auto size() const -> size_t { return m_row_count; }
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Same as `SysFSHelper::find()`, answered from the file.
+   * @details Binary search over the rows; no allocation unless found.
+   */
+  [[nodiscard]] auto find(std::string_view dev_node) const
+      -> std::optional<UsbFunction>;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Same as `SysFSHelper::find_by_id()`, answered from the file.
+   */
+  [[nodiscard]] auto find_by_id(const std::string& vid_raw,
+                                const std::string& pid_raw) const
+      -> std::vector<UsbFunction>;
+
+  /** @brief Every cached function, in dev path order. */
+  [[nodiscard]] auto functions() const -> std::vector<UsbFunction>;
+
+  /** @brief Cached state as a regular `DeviceSnapshot`. */
+  [[nodiscard]] auto snapshot() const -> DeviceSnapshot {
+    return DeviceSnapshot(functions());
+  }
+
+ private:
+  struct Row;
+
+  SnapshotCache(void* map, size_t size);
+
+  [[nodiscard]] auto string(uint32_t id) const -> std::string_view;
+  [[nodiscard]] auto expand(const Row& row) const -> UsbFunction;
+  void reset();
+
+  void* m_map = nullptr;
+  size_t m_size = 0;
+  const Row* m_rows = nullptr;
+  size_t m_row_count = 0;
+  /** Pairs of (offset, size) into `m_bytes`. */
+  const uint32_t* m_strings = nullptr;
+  size_t m_string_count = 0;
+  const char* m_bytes = nullptr;
+};
+}  // namespace fs_tools
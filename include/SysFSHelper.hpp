@@ -18,10 +18,18 @@
  */
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "PathResolver.hpp"
 #include "fs_tools.hpp"
 
 namespace fs_tools {
@@ -35,6 +43,51 @@ class SysFSHelper {
  public:
   /** @ingroup usb_helpers */
 
+  /**
+   * @ingroup usb_helpers
+   * @brief Numeric USB vendor/product pair.
+   * @details Four bytes instead of two heap strings; compares and hashes as
+   * one 32-bit key.
+   */
+  struct UsbId {
+    uint16_t m_vid = 0;
+    uint16_t m_pid = 0;
+
+    /** @brief Vendor in the high half, product in the low half. */
+    [[nodiscard]] constexpr auto key() const -> uint32_t {
+      return (static_cast<uint32_t>(m_vid) << 16U) | m_pid;
+    }
+
+    /**
+     * @ingroup usb_helpers
+     * @brief Parse hex identifiers in any form accepted by `normalize_id()`.
+     * @return Pair, or `std::nullopt` if either is not hex or exceeds 0xffff.
+     */
+    static auto parse(std::string_view vid, std::string_view pid)
+        -> std::optional<UsbId>;
+
+    /** @brief Vendor as normalized hex (same form as `UsbFunction::m_vid`). */
+    [[nodiscard]] auto vid_string() const -> std::string;
+
+    /** @brief Product as normalized hex (same form as `UsbFunction::m_pid`). */
+    [[nodiscard]] auto pid_string() const -> std::string;
+
+    friend constexpr auto operator==(UsbId first, UsbId second) -> bool {
+      return first.key() == second.key();
+    }
+    friend constexpr auto operator!=(UsbId first, UsbId second) -> bool {
+      return first.key() != second.key();
+    }
+    friend constexpr auto operator<(UsbId first, UsbId second) -> bool {
+      return first.key() < second.key();
+    }
+
+    /** Hasher for unordered containers (also `std::hash<UsbId>`). */
+    struct Hash {
+      auto operator()(UsbId id) const noexcept -> size_t { return id.key(); }
+    };
+  };
+
   /**
    * @ingroup usb_helpers
    * @brief Represents a single USB-related device function discovered in sysfs.
@@ -42,18 +95,25 @@ class SysFSHelper {
    * or sound node) that can be traced back to a USB ancestor via its sysfs
    * path. Contains the resolved VID/PID, sysfs and /dev locations, and class
    * metadata.
+   *
+   * `m_id` is the identity; `m_vid`/`m_pid` are its string form, filled in
+   * by the library for display and older callers and never read back.
+   * Records returned by `list_functions()` and friends are plain values
+   * with their own heap strings; interned storage is `FunctionTable`.
    */
   struct UsbFunction {
     /** Vendor ID in normalized lowercase hexadecimal form (no prefix, no
-     * leading zeros). */
+     * leading zeros). Output only: edit `m_id` instead. */
     std::string m_vid;
 
     /** Product ID in normalized lowercase hexadecimal form (no prefix, no
-     * leading zeros). */
+     * leading zeros). Output only: edit `m_id` instead. */
     std::string m_pid;
 
-    /** Absolute sysfs path of the corresponding USB ancestor (e.g.
-     * "/sys/bus/usb/devices/1-1"). */
+    /** Canonical sysfs path of the nearest USB ancestor, i.e. the first
+     * directory above the class device whose `uevent` has `PRODUCT=`. That
+     * is usually the interface ("/sys/devices/.../1-1/1-1:1.0"); `UsbDevice`
+     * maps it to the device. */
     std::string m_usbNode;
 
     /** Class name (subsystem) that provided the device node — for example:
@@ -69,10 +129,92 @@ class SysFSHelper {
      * "/dev/ttyUSB0", "/dev/hidraw0", "/dev/video0", "/dev/sda", or
      * "/dev/snd/controlC0". */
     std::string m_dev_path;
+
+    /** VID:PID as integers; the only one compared, sorted and hashed. */
+    UsbId m_id;
+
+    /** Same dev path, `m_id` and class. */
+    friend auto operator==(const UsbFunction& first,
+                           const UsbFunction& second) -> bool;
+    /** `list_functions()` order: dev path, then `m_id`, then class. */
+    friend auto operator<(const UsbFunction& first, const UsbFunction& second)
+        -> bool;
+  };
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Non-owning view of selected keys of one `uevent` payload.
+   * @details Produced by `parse()` in a single pass over the buffer without
+   * heap allocation; every field is a view into that buffer and is only valid
+   * while it is alive. Missing keys stay empty — check `has()` to tell an
+   * absent key from an empty value.
+   */
+  struct Uevent {
+    /** Keys understood by `parse()`; combine with `|` to request several. */
+    enum Key : unsigned {
+      DEVNAME = 1U << 0U,
+      PRODUCT = 1U << 1U,
+      MAJOR = 1U << 2U,
+      MINOR = 1U << 3U,
+      DEVTYPE = 1U << 4U,
+      DRIVER = 1U << 5U,
+      BUSNUM = 1U << 6U,
+      DEVNUM = 1U << 7U,
+      ACTION = 1U << 8U,
+      DEVPATH = 1U << 9U,
+      SUBSYSTEM = 1U << 10U,
+      ALL = (1U << 11U) - 1U,
+    };
+
+    std::string_view m_devname;
+    std::string_view m_product;
+    std::string_view m_major;
+    std::string_view m_minor;
+    std::string_view m_devtype;
+    std::string_view m_driver;
+    std::string_view m_busnum;
+    std::string_view m_devnum;
+    std::string_view m_action;
+    std::string_view m_devpath;
+    std::string_view m_subsystem;
+    /** Mask of keys that were present. */
+    unsigned m_found = 0;
+
+    /** @brief Whether @p key was present in the parsed payload. */
+    [[nodiscard]] auto has(Key key) const -> bool {
+      return (m_found & key) != 0;
+    }
+
+    /**
+     * @ingroup usb_helpers
+     * @brief Extract the requested @p keys from a `uevent` payload.
+     * @details Lines are `KEY=value` separated by @p separator ('\n' in sysfs
+     * files, '\0' in netlink messages); lines without '=' are skipped and
+     * the first occurrence of a key wins. Stops as soon as every requested
+     * key has been seen.
+     */
+    static auto parse(std::string_view content, unsigned keys = ALL,
+                      char separator = '\n') -> Uevent;
+  };
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Options for the parallel `list_functions()` overload.
+   */
+  struct ParallelOptions {
+    /** Worker threads including the caller; 0 → hardware concurrency. */
+    size_t m_threads = 0;
   };
 
   static constexpr size_t MAX_DEV_NUMBER = 100;
 
+  /** Class entries handed to a worker at a time by parallel enumeration. */
+  static constexpr size_t PARALLEL_CHUNK = 8;
+
+  /** Re-check interval of `wait_for()` when neither netlink nor inotify is
+   * available. */
+  static constexpr std::chrono::milliseconds WAIT_FALLBACK_INTERVAL{100};
+
   /**
    * @ingroup usb_helpers
    * @brief List USB functions discovered from sysfs.
@@ -85,7 +227,12 @@ class SysFSHelper {
    * (dev path, VID, PID). No path normalization beyond canonicalization is
    * performed.
    *
-   * @param dev_usb_root USB sysfs root to use (default: default_usb_root()).
+   * @param dev_usb_root USB sysfs root (default: default_usb_root()). A
+   * non-default root restricts the result to functions whose USB node is, or
+   * lies under, the target of one of its entries; empty, default or
+   * unreadable: no restriction. Only the `list_functions()` overloads apply
+   * it — for_each_function(), find(), UsbQuery and the other
+   * enumerations ignore the USB root.
    * @param classRoots   Sysfs class roots to scan (default:
    * default_class_roots()).
    * @return Vector of discovered functions with resolved dev path, class, and
@@ -96,17 +243,109 @@ class SysFSHelper {
       const std::vector<std::string>& classRoots = default_class_roots())
       -> std::vector<UsbFunction>;
 
+  /**
+   * @ingroup usb_helpers
+   * @brief List USB functions, resolving class entries on a worker pool.
+   * @details Directory listing stays serial; the per-entry work (read
+   * `uevent`, resolve the `device` link, climb to the USB ancestor) is
+   * spread over at most @p options.m_threads threads pulling chunks of
+   * entries from a shared cursor. The result is identical to the serial
+   * overload, including order. Scans the default roots.
+   * @param options Pool size.
+   */
+  static auto list_functions(const ParallelOptions& options)
+      -> std::vector<UsbFunction>;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Parallel `list_functions()` over explicit roots.
+   * @details Takes all three arguments on purpose: a two-argument call always
+   * means the serial overload above.
+   */
+  static auto list_functions(const ParallelOptions& options,
+                             const std::string& dev_usb_root,
+                             const std::vector<std::string>& classRoots)
+      -> std::vector<UsbFunction>;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief `list_functions()` over @p backend instead of the real
+   * filesystem (e.g. a `MemoryBackend` tree).
+   * @details Same implementation and result; entries are resolved serially
+   * through the backend's path operations.
+   */
+  static auto list_functions(const FsBackend& backend,
+                             const std::string& dev_usb_root,
+                             const std::vector<std::string>& classRoots)
+      -> std::vector<UsbFunction>;
+
+  /** Receives functions from `for_each_function()`; `false` stops the scan. */
+  using Visitor = std::function<bool(const UsbFunction&)>;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Stream USB functions to @p visitor as they are resolved.
+   * @details Same resolution as `list_functions()`, but nothing is collected
+   * or sorted: each function is handed over right after its class entry is
+   * resolved, in class-root then directory order, and the scan ends as soon
+   * as the visitor returns `false`.
+   * @param visitor    Callback; return `false` to stop.
+   * @param classRoots Sysfs class roots to scan (default:
+   * default_class_roots()).
+   * @param dedup      Skip functions already visited with the same dev path
+   * and VID:PID (hash set instead of the sort of `list_functions()`).
+   * @return Number of functions passed to @p visitor.
+   */
+  static auto for_each_function(
+      const Visitor& visitor,
+      const std::vector<std::string>& classRoots = default_class_roots(),
+      bool dedup = true) -> size_t;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief First USB function with the given identifiers.
+   * @details Stops scanning at the first match; which of several matching
+   * functions is returned depends on directory order. Use `find_by_id()` for
+   * all of them.
+   */
+  static auto find_first_by_id(
+      const std::string& vid_raw, const std::string& pid_raw,
+      const std::vector<std::string>& classRoots = default_class_roots())
+      -> std::optional<UsbFunction>;
+
   /**
    * @ingroup usb_helpers
    * @brief Find USB functions by vendor/product identifiers.
-   * @details Normalizes both @p vid_raw and @p pid_raw (accepts hex
+   * @details Parses both @p vid_raw and @p pid_raw into a `UsbId` (accepts hex
    * with/without `0x` prefix, any case, and leading zeros) and filters the
-   * result of `list_functions()`.
+   * functions streamed by `for_each_function()` by `UsbFunction::m_id`, so
+   * only matches are copied. Input that is not a 16-bit hex value matches
+   * nothing.
    * @param vid_raw Vendor ID string.
    * @param pid_raw Product ID string.
-   * @return All functions whose normalized VID and PID match the inputs.
+   * @param classRoots Sysfs class roots to scan (default:
+   * default_class_roots()).
+   * @return All functions whose normalized VID and PID match the inputs,
+   * sorted and deduplicated like `list_functions()`.
    */
-  static auto find_by_id(const std::string& vid_raw, const std::string& pid_raw)
+  static auto find_by_id(
+      const std::string& vid_raw, const std::string& pid_raw,
+      const std::vector<std::string>& classRoots = default_class_roots())
+      -> std::vector<UsbFunction>;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Functions of the devices with @p vid_raw:@p pid_raw and serial
+   * number @p serial.
+   * @details Picks one of several identical adapters in a single pass:
+   * `serial` is read (via `UsbDevice`) once per matching USB device, only
+   * for devices whose VID:PID already matched.
+   * @return Matching functions sorted like `find_by_id()`.
+   */
+  static auto find_by_serial(
+      const std::string& vid_raw, const std::string& pid_raw,
+      const std::string& serial,
+      const std::vector<std::string>& classRoots = default_class_roots())
       -> std::vector<UsbFunction>;
 
   /**
@@ -114,23 +353,126 @@ class SysFSHelper {
    * @brief Resolve a device node to its USB function (VID:PID, class, sysfs
    * path).
    * @details Accepts forms like "/dev/ttyUSB0", "ttyUSB0" or "snd/controlC0".
-   * Strips a leading "/dev/" if present, scans known class roots for a matching
-   * `DEVNAME`, follows the `device` symlink, and ascends to the nearest USB
-   * ancestor to extract `PRODUCT=vid/pid/...`.
-   * @param dev_node Device node name or path.
+   * Strips a leading "/dev/" if present, then tries the fast path: stats the
+   * /dev node and jumps straight to `/sys/dev/{char,block}/MAJOR:MINOR` via
+   * its `st_rdev`. If the node does not exist, is not a device, or maps to a
+   * class outside @p classRoots, falls back to scanning the class roots for a
+   * matching `DEVNAME`. Either way it follows the `device` symlink and ascends
+   * to the nearest USB ancestor to extract `PRODUCT=vid/pid/...`.
+   * @param dev_node   Device node name or path.
+   * @param classRoots Sysfs class roots to consider (default:
+   * default_class_roots()).
    * @return Matching USB function, or `std::nullopt` if not found.
    */
-  static auto find(std::string dev_node) -> std::optional<UsbFunction>;
+  static auto find(std::string dev_node, const std::vector<std::string>&
+                                             classRoots = default_class_roots())
+      -> std::optional<UsbFunction>;
+
+  /** Outcome of one `find_many()` lookup. */
+  struct FindResult {
+    /** Resolved function, empty on error. */
+    std::optional<UsbFunction> m_function;
+    /** `invalid_argument` for an empty name, `no_such_device` if no USB
+     * function provides the node. */
+    std::error_code m_error;
+  };
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Resolve many device nodes at once.
+   * @details Equivalent to calling `find()` for each node, but the rdev fast
+   * path runs first for all of them and whatever is left is matched in a
+   * single scan of @p classRoots (ending as soon as every node is found),
+   * with one ancestor cache shared by all lookups. Startup cost is linear in
+   * the number of class entries instead of nodes × entries.
+   * @param dev_nodes  Device node names or paths, in the forms `find()`
+   * accepts; duplicates are fine.
+   * @param classRoots Sysfs class roots to consider (default:
+   * default_class_roots()).
+   * @return One result per input, in input order.
+   */
+  static auto find_many(
+      const std::vector<std::string>& dev_nodes,
+      const std::vector<std::string>& classRoots = default_class_roots())
+      -> std::vector<FindResult>;
+
+  /** Predicate used by `wait_for()` to select a function. */
+  using Predicate = std::function<bool(const UsbFunction&)>;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Block until a function matching @p predicate is resolvable.
+   * @details Subscribes to kernel uevents first (falling back to inotify on
+   * /dev when netlink is unavailable), then checks the current state, so an
+   * already-present device returns immediately and one that appears between
+   * the check and the wait is not missed. Wakes only on events; no sleep
+   * loop.
+   * @param predicate  Selector applied to candidate functions.
+   * @param timeout    Maximum time to wait.
+   * @param classRoots Sysfs class roots to consider, both for the check and
+   * for hotplug events, whose `DEVPATH` is resolved under the sysfs mount
+   * holding the first root ("<sys>/class/<name>"; default:
+   * default_class_roots()).
+   * @return First matching function, or `std::nullopt` on timeout.
+   */
+  static auto wait_for(const Predicate& predicate,
+                       std::chrono::milliseconds timeout,
+                       const std::vector<std::string>& classRoots =
+                           default_class_roots())
+      -> std::optional<UsbFunction>;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief `wait_for()` woken by uevents from @p uevent_fd.
+   * @details @p uevent_fd is any fd `HotplugMonitor::adopt()` accepts (a
+   * netlink socket the caller already owns, one end of a socketpair); it is
+   * duplicated, not taken over. Without events the current state is not
+   * re-checked until the timeout.
+   */
+  static auto wait_for(int uevent_fd, const Predicate& predicate,
+                       std::chrono::milliseconds timeout,
+                       const std::vector<std::string>& classRoots =
+                           default_class_roots())
+      -> std::optional<UsbFunction>;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Block until a function with the given VID:PID is resolvable.
+   * @details Identifiers are normalized like in `find_by_id()`.
+   * @return First matching function, or `std::nullopt` on timeout (at once
+   * if the identifiers do not parse).
+   */
+  static auto wait_for(const std::string& vid_raw, const std::string& pid_raw,
+                       std::chrono::milliseconds timeout)
+      -> std::optional<UsbFunction>;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Block until @p dev_node ("/dev/ttyUSB0" or "ttyUSB0") resolves.
+   * @details Uses `find()` for the initial and fallback checks.
+   * @return Resolved function, or `std::nullopt` on timeout.
+   */
+  static auto wait_for(std::string dev_node, std::chrono::milliseconds timeout)
+      -> std::optional<UsbFunction>;
 
   /**
    * @ingroup usb_helpers
    * @brief List all unique (VID, PID) pairs present under the USB sysfs root.
-   * @details Iterates child directories of @p sysUsbRoot (default from
-   * `default_usb_root()`), reads each `uevent`, and parses
-   * `PRODUCT=vid/pid/...`. Returns a deduplicated list of pairs.
+   * @details Iterates child directories (and the symlinks to them that
+   * /sys/bus/usb/devices consists of) of @p sysUsbRoot, reads each `uevent`,
+   * and parses `PRODUCT=vid/pid/...`. Returns a deduplicated list of pairs.
+   * @param sysUsbRoot USB sysfs root to use (default: default_usb_root()).
    * @return Vector of unique (VID, PID) pairs.
    */
-  static auto list_ids() -> std::vector<std::pair<std::string, std::string>>;
+  static auto list_ids(const std::string& sysUsbRoot = default_usb_root())
+      -> std::vector<std::pair<std::string, std::string>>;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief `list_ids()` over @p backend instead of the real filesystem.
+   */
+  static auto list_ids(const FsBackend& backend, const std::string& sysUsbRoot)
+      -> std::vector<std::pair<std::string, std::string>>;
 
   /**
    * @ingroup usb_helpers
@@ -141,46 +483,255 @@ class SysFSHelper {
    * @param str Hex string to normalize.
    * @return Normalized lowercase hex.
    */
-  static auto normalize_id(std::string str) -> std::string;
+  static auto normalize_id(std::string_view str) -> std::string;
 
  private:
+  friend class HotplugMonitor;
+  friend class SnapshotCache;
+  friend class SysFSIndex;
+  friend class UsbQuery;
+  friend class UsbTopology;
+
   // ===== Internal helpers and variants with explicit roots (for tests) =====
 
   /**
    * @ingroup usb_helpers
    * @brief Read entire file into a string; returns false if it cannot be
-   * opened.
+   * opened or read.
+   * @details Thin wrapper over `read_attr()`; @p out keeps its capacity.
    */
   static auto read_file(const std::string&, std::string&) -> bool;
 
+  /**
+   * @ingroup usb_helpers
+   * @brief `read_file()` relative to @p dirfd; feeds `EnumStats`.
+   */
+  static auto read_file_at(int dirfd, const std::string& name,
+                           std::string& out) -> bool;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief `read_file()` through @p backend (`nullptr`: the real
+   * filesystem); feeds `EnumStats`.
+   */
+  static auto read_file(const FsBackend* backend, const std::string& path,
+                        std::string& out) -> bool;
+
   /**
    * @ingroup usb_helpers
    * @brief Extract VID and PID from a sysfs `uevent` payload.
    * @details Parses the `PRODUCT=vid/pid/...` line; outputs normalized
    * lowercase hex via `normalize_id()`.
    */
-  static auto parse_ids_from_uevent(const std::string& content,
-                                    std::basic_string<char>& out_vid,
-                                    std::string& out_pid) -> bool;
+  static auto parse_ids_from_uevent(std::string_view content,
+                                    std::string& out_vid, std::string& out_pid)
+      -> bool;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Split a `PRODUCT` value ("vid/pid/bcd") into normalized VID and
+   * PID.
+   */
+  static auto parse_ids_from_product(std::string_view product,
+                                     std::string& out_vid,
+                                     std::string& out_pid) -> bool;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Class name of a class root: "/sys/class/tty/" → "tty".
+   * @details Trailing '/' are ignored; this is the `m_class_name` every
+   * function found under @p classRoot reports.
+   */
+  static auto class_name_of(std::string_view classRoot) -> std::string;
+
+  /** Nearest USB ancestor found by `usb_ids_for()`. */
+  struct UsbAncestor {
+    /** Canonical directory whose `uevent` has `PRODUCT=`. */
+    std::string m_node;
+    UsbId m_id;
+  };
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Per-pass memo of link resolution and of `usb_ids_for()`.
+   * @details Valid for one enumeration pass (or one index refresh); sibling
+   * functions of a composite device then resolve the shared prefix of their
+   * `device` links and read each ancestor `uevent` once.
+   */
+  struct AncestorCache {
+    AncestorCache() = default;
+    /** Cache resolving links through @p backend. */
+    explicit AncestorCache(const FsBackend& backend) : m_paths(backend) {}
+
+    /**
+     * Canonical sysfs directory → its nearest USB ancestor, or
+     * `std::nullopt` for "no USB ancestor".
+     */
+    std::unordered_map<std::string, std::optional<UsbAncestor>> m_ids;
+    /** Canonical prefixes of the links resolved so far. */
+    PathResolver m_paths;
+  };
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Canonical form of @p path; through `cache->m_paths` when a
+   * @p cache is given, else `realpath` (of @p backend, if non-null).
+   * @details Counts one `m_realpath_calls`.
+   */
+  static auto canonical(const std::string& path, AncestorCache* cache,
+                        const FsBackend* backend, std::error_code& error)
+      -> std::string;
 
   /**
    * @ingroup usb_helpers
    * @brief Ascend the sysfs tree to find the nearest USB ancestor that exposes
    * VID:PID.
-   * @details Canonicalizes @p start; checks `uevent` in each parent directory
-   * up to `MAX_DEV_NUMBER` ascents and returns the first parsed pair.
+   * @details @p start must already be canonical (as `resolve_function()`
+   * produces it); it is not resolved again. Checks `uevent` in each parent
+   * directory up to `MAX_DEV_NUMBER` ascents and returns the first directory
+   * with a parsable `PRODUCT=`, with its ids. With a @p cache, stops at the
+   * first memoized directory and records the answer for every directory it
+   * climbed through. A non-null @p backend replaces the POSIX calls.
    */
-  static auto usb_ids_for(const std::string& start)
-      -> std::optional<std::pair<std::string, std::string>>;
+  static auto usb_ids_for(const std::string& start,
+                          AncestorCache* cache = nullptr,
+                          const FsBackend* backend = nullptr)
+      -> std::optional<UsbAncestor>;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Sort functions by dev path and drop duplicates by (dev path, VID,
+   * PID).
+   */
+  static void sort_unique(std::vector<UsbFunction>& funcs);
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Early rejection for a scan (`UsbQuery`), one stage per point.
+   * @details Each stage is asked as soon as it can be decided; an empty one
+   * keeps everything. `m_class` gets the class root before it is opened,
+   * `m_dev_name` the entry's `DEVNAME` before `device` is resolved,
+   * `m_function` the resolved function.
+   */
+  struct ScanFilter {
+    std::function<bool(const std::string&)> m_class;
+    std::function<bool(const std::string&)> m_dev_name;
+    std::function<bool(const UsbFunction&)> m_function;
+
+    [[nodiscard]] auto wants_class(const std::string& classRoot) const
+        -> bool {
+      return !m_class || m_class(classRoot);
+    }
+    [[nodiscard]] auto wants_dev_name(std::string_view dev_name) const
+        -> bool {
+      return !m_dev_name || m_dev_name(std::string(dev_name));
+    }
+    [[nodiscard]] auto wants_function(const UsbFunction& func) const
+        -> bool {
+      return !m_function || m_function(func);
+    }
+  };
+
+  /**
+   * @ingroup usb_helpers
+   * @brief `for_each_function()` that skips what @p filter rejects (null:
+   * nothing), each stage before the work it saves.
+   */
+  static auto for_each_function(const Visitor& visitor,
+                                const std::vector<std::string>& classRoots,
+                                bool dedup, const ScanFilter* filter)
+      -> size_t;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Resolve one class entry (e.g. "ttyUSB0" under "/sys/class/tty").
+   * @details Reads `<name>/uevent` relative to the open @p classRoot →
+   * `DEVNAME`, then delegates to `resolve_function()`. A `DEVNAME` that
+   * @p filter rejects gives `std::nullopt` without resolving the entry.
+   */
+  static auto resolve_entry(const DirHandle& classRoot, const std::string& name,
+                            AncestorCache* cache = nullptr,
+                            const ScanFilter* filter = nullptr)
+      -> std::optional<UsbFunction>;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief `resolve_entry()` with the entry's `uevent` already read (e.g. by
+   * `BatchReader`).
+   */
+  static auto resolve_entry_uevent(const DirHandle& classRoot,
+                                   const std::string& name,
+                                   std::string_view uevent,
+                                   AncestorCache* cache = nullptr,
+                                   const ScanFilter* filter = nullptr)
+      -> std::optional<UsbFunction>;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Build a UsbFunction for one class entry.
+   * @details Follows `<entryPath>/device`, obtains `(VID, PID)` via
+   * `usb_ids_for()` and fills class/dev names. Returns `std::nullopt` if the
+   * entry has no device link or no USB ancestor. A non-null @p backend
+   * replaces the POSIX calls.
+   */
+  static auto resolve_function(const std::string& classRoot,
+                               const std::string& entryPath,
+                               std::string_view devname,
+                               AncestorCache* cache = nullptr,
+                               const FsBackend* backend = nullptr)
+      -> std::optional<UsbFunction>;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Fast reverse lookup through `/sys/dev/{char,block}/MAJOR:MINOR`.
+   * @details Stats `/dev/<dev_node>`, follows the rdev link to the class
+   * device, and checks its `DEVNAME` and `subsystem` against @p classRoots.
+   * @return `m_function` if found; `m_error` = `no_such_device` if the class
+   * device was found and the linear scan could not do better (it has no
+   * USB ancestor, or its class is not among @p classRoots, all of them
+   * "/sys/class/<name>"); neither if the linear scan has to decide. Roots
+   * are compared by `class_name_of()`, so "/sys/class/tty/" matches.
+   */
+  static auto find_by_rdev(const std::string& dev_node,
+                           const std::vector<std::string>& classRoots,
+                           AncestorCache* cache = nullptr) -> FindResult;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Common body of the `wait_for()` family.
+   * @details @p probe inspects the current sysfs state (initially and after
+   * /dev changes in inotify mode); @p predicate filters hotplug additions
+   * of devices under @p classRoots. Events come from @p uevent_fd (owned by
+   * the caller) or, if it is negative, from a new netlink socket. Without
+   * netlink, inotify watches the directory of @p dev_path (its nearest
+   * existing ancestor until it appears), or /dev if it is empty.
+   */
+  static auto wait_until(
+      const std::function<std::optional<UsbFunction>()>& probe,
+      const Predicate& predicate, std::chrono::milliseconds timeout,
+      const std::vector<std::string>& classRoots, int uevent_fd = -1,
+      const std::string& dev_path = {}) -> std::optional<UsbFunction>;
 
   /**
    * @ingroup usb_helpers
    * @brief Enumerate USB functions by scanning the given sysfs class roots.
-   * @details For each class entry: read `uevent` → get `DEVNAME` → follow
-   * `device` symlink → obtain `(VID, PID)` via `usb_ids_for()` → deduplicate.
+   * @details The one implementation behind every `list_functions()`
+   * overload, all filesystem access through @p backend. For each class
+   * entry: read `uevent` → get `DEVNAME` → follow `device` symlink → obtain
+   * `(VID, PID)` via `usb_ids_for()` (sharing one `AncestorCache` per thread
+   * across the pass) → keep it if its USB node lies under an entry of
+   * @p sysUsbRoot (only for a non-default, readable root) → deduplicate.
+   * With @p threads > 1 entries are resolved on a bounded worker pool. On
+   * the real filesystem each class root is opened once and entries are read
+   * relative to it, batch-read through io_uring when available. A non-null
+   * @p filter drops entries at the earliest stage it decides (see
+   * `ScanFilter`).
    */
-  static auto list_functions_at(const std::string& sysUsbRoot,
-                                const std::vector<std::string>& classRoots)
+  static auto list_functions_at(const FsBackend& backend,
+                                const std::string& sysUsbRoot,
+                                const std::vector<std::string>& classRoots,
+                                size_t threads = 1,
+                                const ScanFilter* filter = nullptr)
       -> std::vector<UsbFunction>;
 
   /**
@@ -203,5 +754,23 @@ class SysFSHelper {
    * @brief Default sysfs USB device root ("/sys/bus/usb/devices").
    */
   static auto default_usb_root() -> std::string;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Default device node directory ("/dev").
+   */
+  static auto default_dev_root() -> std::string;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Default sysfs rdev index ("/sys/dev").
+   */
+  static auto default_sys_dev_root() -> std::string;
 };
-}  // namespace fs_tools
\ No newline at end of file
+}  // namespace fs_tools
+
+namespace std {
+template <>
+struct hash<fs_tools::SysFSHelper::UsbId>
+    : fs_tools::SysFSHelper::UsbId::Hash {};
+}  // namespace std
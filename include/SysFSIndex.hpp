@@ -0,0 +1,156 @@
+/**
+ * @file SysFSIndex.hpp
+ * @brief Persistent in-process index of USB functions discovered via sysfs.
+ * @details
+ * `SysFSHelper` rebuilds its view of sysfs on every call. `SysFSIndex` builds
+ * the `UsbFunction` set once, keeps hash indexes keyed by dev path, by
+ * (VID, PID) and by USB node, and refreshes only the class entries that
+ * appeared, disappeared or were explicitly invalidated.
+ */
+#pragma once
+
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "FunctionTable.hpp"
+#include "SysFSHelper.hpp"
+
+namespace fs_tools {
+/** @ingroup usb_helpers */
+/**
+ * @brief Opt-in cache of `SysFSHelper` results with O(1) lookups.
+ * @details Queries never touch the filesystem; call `refresh()` (cheap
+ * directory listings, full resolution only for new entries) or
+ * `invalidate()` to pick up changes.
+ * Functions are stored as `FunctionTable::Row`s over one `StringPool`, so a
+ * large index holds each USB node path and class name once; strings of
+ * vanished devices stay in the pool until `rebuild()`.
+ * @note Not thread-safe: synchronize externally if shared between threads.
+ */
+class SysFSIndex {
+ public:
+  using UsbFunction = SysFSHelper::UsbFunction;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Build the index over the given sysfs class roots.
+   * @param classRoots Sysfs class roots to scan (default:
+   * SysFSHelper::default_class_roots()).
+   */
+  explicit SysFSIndex(std::vector<std::string> classRoots =
+                          SysFSHelper::default_class_roots());
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Look up a function by device node ("/dev/ttyUSB0" or "ttyUSB0").
+   * @return Indexed function, or `std::nullopt` if not indexed.
+   */
+  [[nodiscard]] auto find(std::string dev_node) const
+      -> std::optional<UsbFunction>;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Look up functions by vendor/product identifiers.
+   * @details Inputs are parsed with `SysFSHelper::UsbId::parse()`.
+   * @return Matching functions sorted by dev path; empty if either
+   * identifier is not hex or exceeds 0xffff.
+   */
+  [[nodiscard]] auto find_by_id(const std::string& vid_raw,
+                                const std::string& pid_raw) const
+      -> std::vector<UsbFunction>;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Look up all functions that share a USB node.
+   * @return Matching functions sorted by dev path.
+   */
+  [[nodiscard]] auto find_by_usb_node(const std::string& usb_node) const
+      -> std::vector<UsbFunction>;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief All indexed functions in `SysFSHelper::list_functions()` order.
+   */
+  [[nodiscard]] auto functions() const -> std::vector<UsbFunction>;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Number of indexed class entries that resolved to a USB function.
+   */
+  [[nodiscard]] auto size() const -> size_t;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Re-list the class roots and update only what changed.
+   * @details Entries that vanished are dropped, new entries are resolved, and
+   * entries whose sysfs inode changed (re-created under the same name) are
+   * re-resolved, as are entries whose last resolution failed transiently
+   * (a read or link error other than ENOENT, or a USB device below a root
+   * hub whose `uevent` was not readable yet). Other unchanged entries cost
+   * one `readdir` record and no file reads.
+   * @return Number of entries added, removed or re-resolved; a retry that
+   * fails again is not counted.
+   */
+  auto refresh() -> size_t;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Re-resolve the entry that currently provides @p dev_node.
+   * @details Entries that were seen but could not be resolved (e.g. the
+   * USB ancestor's `uevent` was not there yet) are retried by entry name.
+   * The entry's inode is re-read, so a later `refresh()` does not resolve
+   * it again.
+   * @return `true` if the node is resolvable now.
+   */
+  auto invalidate(std::string dev_node) -> bool;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Drop everything and rebuild from scratch.
+   */
+  void rebuild();
+
+ private:
+  /** One class entry (e.g. "/sys/class/tty/ttyUSB0") seen during a scan. */
+  struct Entry {
+    std::string m_class_root;
+    /** Entry name under the class root ("ttyUSB0"). */
+    std::string m_name;
+    ino_t m_inode = 0;
+    /** Empty if the entry has no DEVNAME, device link or USB ancestor. */
+    std::optional<FunctionTable::Row> m_function;
+    /** Unresolved for a reason that may go away; `refresh()` retries. */
+    bool m_retry = false;
+  };
+
+  /** Key → class entry paths; tiny vectors, so erase is a linear scan. */
+  template <typename Key, typename Hash = std::hash<Key>>
+  using Index = std::unordered_map<Key, std::vector<std::string>, Hash>;
+  /** Keyed by pool id of the dev name / USB node. */
+  using PoolIndex = Index<StringPool::Id>;
+  using IdIndex = Index<SysFSHelper::UsbId, SysFSHelper::UsbId::Hash>;
+
+  void add_entry(const DirHandle& classRoot, const std::string& name,
+                 ino_t inode, SysFSHelper::AncestorCache* ancestors = nullptr);
+  void remove_entry(const std::string& entryPath);
+  /** Whether a failed resolution of @p name may succeed later. */
+  static auto transient_failure(const DirHandle& classRoot,
+                                const std::string& name) -> bool;
+  void link(const std::string& entryPath, const FunctionTable::Row& row);
+  void unlink(const std::string& entryPath, const FunctionTable::Row& row);
+  template <typename Key, typename Hash>
+  [[nodiscard]] auto collect(const Index<Key, Hash>& index,
+                             const Key& key) const -> std::vector<UsbFunction>;
+  [[nodiscard]] auto function(const std::string& entryPath) const
+      -> UsbFunction;
+
+  std::vector<std::string> m_class_roots;
+  std::unordered_map<std::string, Entry> m_entries;
+  StringPool m_strings;
+  PoolIndex m_by_dev_name;
+  IdIndex m_by_id;
+  PoolIndex m_by_usb_node;
+};
+}  // namespace fs_tools
@@ -0,0 +1,97 @@
+/**
+ * @file UsbDevice.hpp
+ * @brief Lazily loaded sysfs attributes of the USB device behind a function.
+ * @details
+ * VID:PID is not enough to pick one of several identical adapters. The USB
+ * device directory that `SysFSHelper` already located (`m_usbNode`, or its
+ * parent when that is an interface) also carries `serial`, `busnum`,
+ * `devnum`, `speed` and `devpath`. `UsbDevice` reads them on first access
+ * and keeps them; `load()` fetches several in one batch relative to the
+ * device directory, so callers pay only for what they touch.
+ */
+#pragma once
+
+#include <array>
+#include <optional>
+#include <string>
+
+#include "SysFSHelper.hpp"
+
+namespace fs_tools {
+/** @ingroup usb_helpers */
+/**
+ * @brief Attribute view of one USB device directory.
+ * @note Accessors fill a cache and are not thread-safe.
+ */
+class UsbDevice {
+ public:
+  /** Attribute bits for `load()`. */
+  enum Attribute : unsigned {
+    SERIAL = 1U << 0U,
+    BUSNUM = 1U << 1U,
+    DEVNUM = 1U << 2U,
+    SPEED = 1U << 3U,
+    DEVPATH = 1U << 4U,
+    ALL = SERIAL | BUSNUM | DEVNUM | SPEED | DEVPATH,
+  };
+
+  /**
+   * @ingroup usb_helpers
+   * @brief View of the device at @p usb_node.
+   * @details An interface path ("…/1-1.2:1.0") is mapped to its device
+   * directory ("…/1-1.2") without touching the filesystem.
+   */
+  explicit UsbDevice(const std::string& usb_node);
+
+  /** @brief View of the device that provides @p func. */
+  explicit UsbDevice(const SysFSHelper::UsbFunction& func)
+      : UsbDevice(func.m_usbNode) {}
+
+  /** @brief USB device directory. */
+  [[nodiscard]] auto path() const -> const std::string& { return m_path; }
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Read every attribute in @p attributes not loaded yet, in one
+   * batch.
+   */
+  void load(unsigned attributes) const;
+
+  /** @brief iSerial string; `std::nullopt` if the device has none. */
+  [[nodiscard]] auto serial() const -> const std::optional<std::string>& {
+    return get(SERIAL);
+  }
+
+  /** @brief Bus number. */
+  [[nodiscard]] auto busnum() const -> std::optional<unsigned> {
+    return number(BUSNUM);
+  }
+
+  /** @brief Device address on the bus; changes on every re-enumeration. */
+  [[nodiscard]] auto devnum() const -> std::optional<unsigned> {
+    return number(DEVNUM);
+  }
+
+  /** @brief Link speed in Mbit/s as sysfs reports it ("1.5", "480", ...). */
+  [[nodiscard]] auto speed() const -> const std::optional<std::string>& {
+    return get(SPEED);
+  }
+
+  /** @brief Port path below the root hub ("1.4.2"); stable per port. */
+  [[nodiscard]] auto devpath() const -> const std::optional<std::string>& {
+    return get(DEVPATH);
+  }
+
+ private:
+  static constexpr size_t ATTRIBUTE_COUNT = 5;
+
+  [[nodiscard]] auto get(Attribute attribute) const
+      -> const std::optional<std::string>&;
+  [[nodiscard]] auto number(Attribute attribute) const
+      -> std::optional<unsigned>;
+
+  std::string m_path;
+  mutable unsigned m_loaded = 0;
+  mutable std::array<std::optional<std::string>, ATTRIBUTE_COUNT> m_values;
+};
+}  // namespace fs_tools
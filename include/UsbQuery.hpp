@@ -0,0 +1,133 @@
+/**
+ * @file UsbQuery.hpp
+ * @brief Composable filters over USB functions, evaluated during the scan.
+ * @details
+ * Filtering `list_functions()` output pays for resolving every class entry.
+ * `UsbQuery` collects predicates first and evaluates each one at the earliest
+ * point it can be decided:
+ *
+ * 1. class filter — only the matching class roots are listed at all;
+ * 2. dev name glob — checked right after the entry's `uevent`, before the
+ *    `device` link is resolved and the USB ancestor is searched;
+ * 3. VID/PID, port glob, driver and custom predicates — checked on the
+ *    resolved function, cheapest first (`driver` costs one `readlink`).
+ *
+ * Filters of different kinds are AND-ed; repeated filters of one kind
+ * (two classes, several ids or globs) are OR-ed, except `where()`
+ * predicates, which must all hold.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "SysFSHelper.hpp"
+#include "fs_tools.hpp"
+
+namespace fs_tools {
+/** @ingroup usb_helpers */
+/**
+ * @brief Builder and evaluator of a USB function query.
+ *
+ * @code
+ * // all tty functions of vendor 0403 on hub port 1-2.*
+ * auto funcs = fs_tools::UsbQuery()
+ *                  .class_name("tty")
+ *                  .vendor(0x0403)
+ *                  .port("1-2.*")
+ *                  .run();
+ * @endcode
+ */
+class UsbQuery {
+ public:
+  using UsbFunction = SysFSHelper::UsbFunction;
+  using UsbId = SysFSHelper::UsbId;
+  using Predicate = std::function<bool(const UsbFunction&)>;
+
+  /** @brief Keep functions of class @p name ("tty", "hidraw", ...). */
+  auto class_name(std::string name) -> UsbQuery&;
+
+  /** @brief Keep functions with exactly @p id. */
+  auto id(UsbId id) -> UsbQuery&;
+
+  /** @brief Keep functions of vendor @p vid, any product. */
+  auto vendor(uint16_t vid) -> UsbQuery&;
+
+  /**
+   * @brief Keep functions whose id matches @p value on the bits set in
+   * @p mask (e.g. a product range 0x7000–0x70ff: value 1a86:7000,
+   * mask ffff:ff00).
+   */
+  auto id_mask(UsbId value, UsbId mask) -> UsbQuery&;
+
+  /** @brief Keep functions with any of @p ids. */
+  auto ids(const std::vector<UsbId>& ids) -> UsbQuery&;
+
+  /** @brief Keep functions whose interface is bound to driver @p name. */
+  auto driver(std::string name) -> UsbQuery&;
+
+  /**
+   * @brief Keep functions whose USB device name (bus-port path, e.g.
+   * "1-2.4") matches the fnmatch(3) pattern @p glob.
+   */
+  auto port(std::string glob) -> UsbQuery&;
+
+  /** @brief Keep functions whose DEVNAME matches @p glob ("ttyUSB*"). */
+  auto dev_name(std::string glob) -> UsbQuery&;
+
+  /** @brief Keep functions accepted by @p predicate; evaluated last. */
+  auto where(Predicate predicate) -> UsbQuery&;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Scan @p classRoots, calling @p visitor for each match.
+   * @details Streams through `SysFSHelper::for_each_function()` without
+   * deduplication.
+   * @return Number of matches visited; stops when @p visitor returns false.
+   */
+  auto for_each(const SysFSHelper::Visitor& visitor,
+                const std::vector<std::string>& classRoots =
+                    SysFSHelper::default_class_roots()) const -> size_t;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief All matches, through the `list_functions()` scan: same order and
+   * deduplication, but no USB-root restriction.
+   */
+  [[nodiscard]] auto run(const std::vector<std::string>& classRoots =
+                             SysFSHelper::default_class_roots()) const
+      -> std::vector<UsbFunction>;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Evaluate every filter on an already resolved @p func (e.g. from
+   * a `DeviceSnapshot` or `SysFSIndex`).
+   */
+  [[nodiscard]] auto matches(const UsbFunction& func) const -> bool;
+
+ private:
+  struct IdFilter {
+    UsbId m_value;
+    UsbId m_mask;
+  };
+
+  [[nodiscard]] auto wants_class(const std::string& classRoot) const -> bool;
+  [[nodiscard]] auto wants_dev_name(const std::string& dev_name) const
+      -> bool;
+  /** Filters decided by the resolved function (stage 3). */
+  [[nodiscard]] auto wants_function(const UsbFunction& func) const -> bool;
+  /** The three stages above, for the `SysFSHelper` scans. */
+  [[nodiscard]] auto scan_filter() const -> SysFSHelper::ScanFilter;
+
+  std::vector<std::string> m_classes;
+  std::vector<IdFilter> m_ids;
+  std::vector<std::string> m_drivers;
+  /** Compiled once here, matched per entry without `fnmatch` parsing. */
+  std::vector<Glob> m_ports;
+  std::vector<Glob> m_dev_names;
+  std::vector<Predicate> m_predicates;
+};
+}  // namespace fs_tools
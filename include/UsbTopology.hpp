@@ -0,0 +1,149 @@
+/**
+ * @file UsbTopology.hpp
+ * @brief Bus → hub → device → interface → function tree in one flat array.
+ * @details
+ * `UsbFunction::m_usbNode` says where a function lives, but not which
+ * functions share a device or which devices sit behind which hub.
+ * `UsbTopology` builds that tree once from the names under
+ * `/sys/bus/usb/devices` (`usb3` → `3-1` → `3-1.4` → `3-1.4:1.0`; the kernel
+ * names encode the parent, so no link is resolved) and hangs every
+ * enumerated class function under its interface.
+ *
+ * Nodes are stored in preorder in one vector and refer to each other by
+ * index. A subtree is the contiguous range `[i, node(i).m_end)`, so parent,
+ * first child, next sibling and "everything behind hub 3-1" are O(1) range
+ * computations with no pointer chasing; names live in one `StringPool`.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "FunctionTable.hpp"
+#include "SysFSHelper.hpp"
+
+namespace fs_tools {
+/** @ingroup usb_helpers */
+/**
+ * @brief Index-based USB topology snapshot.
+ */
+class UsbTopology {
+ public:
+  using UsbFunction = SysFSHelper::UsbFunction;
+  using UsbId = SysFSHelper::UsbId;
+  using Index = uint32_t;
+
+  static constexpr Index NONE = UINT32_MAX;
+
+  enum class Kind : uint8_t {
+    /** Root hub of a host controller ("usb3"). */
+    CONTROLLER,
+    /** USB device with devices behind it. */
+    HUB,
+    DEVICE,
+    INTERFACE,
+    /** Class device (`/dev` node) of an interface. */
+    FUNCTION,
+  };
+
+  struct Node {
+    Kind m_kind = Kind::DEVICE;
+    /** 0 for controllers. */
+    uint16_t m_depth = 0;
+    Index m_parent = NONE;
+    /** One past the last node of this subtree. */
+    Index m_end = 0;
+    /** From `PRODUCT=`; for functions, the function's id. */
+    UsbId m_id;
+    /** "usb3", "3-1.4", "3-1.4:1.0", "ttyUSB0". */
+    StringPool::Id m_name = 0;
+    /** Row in `functions()` for `Kind::FUNCTION`, else `NONE`. */
+    Index m_function = NONE;
+  };
+
+  UsbTopology() = default;
+
+  /**
+   * @ingroup usb_helpers
+   * @brief Enumerate @p classRoots, list @p dev_usb_root once, and link the
+   * two.
+   * @details Two passes, not one: the functions are enumerated like
+   * `list_functions()`, then the bus tree is built from one listing of
+   * @p dev_usb_root; each function is attached by the name of its
+   * `m_usbNode`. The class walk only reaches USB nodes that own a class
+   * device, so controllers, hubs and function-less devices have to come
+   * from the bus listing anyway. Functions whose USB node is not listed
+   * under @p dev_usb_root are left out of the tree.
+   */
+  static auto build(
+      const std::string& dev_usb_root = SysFSHelper::default_usb_root(),
+      const std::vector<std::string>& classRoots =
+          SysFSHelper::default_class_roots()) -> UsbTopology;
+
+  [[nodiscard]] auto size() const -> size_t { return m_nodes.size(); }
+  [[nodiscard]] auto nodes() const -> const std::vector<Node>& {
+    return m_nodes;
+  }
+  [[nodiscard]] auto node(Index index) const -> const Node& {
+    return m_nodes[index];
+  }
+  [[nodiscard]] auto name(Index index) const -> std::string_view {
+    return m_names.view(m_nodes[index].m_name);
+  }
+
+  /** @brief Node named @p name ("3-1", "3-1:1.0", "ttyUSB0"), or `NONE`. */
+  [[nodiscard]] auto find(std::string_view name) const -> Index;
+
+  /** @brief First controller, or `NONE` if the tree is empty. */
+  [[nodiscard]] auto first_root() const -> Index {
+    return m_nodes.empty() ? NONE : 0;
+  }
+
+  [[nodiscard]] auto parent(Index index) const -> Index {
+    return m_nodes[index].m_parent;
+  }
+
+  [[nodiscard]] auto first_child(Index index) const -> Index {
+    return index + 1 < m_nodes[index].m_end ? index + 1 : NONE;
+  }
+
+  /** @brief Next node with the same parent (or next controller). */
+  [[nodiscard]] auto next_sibling(Index index) const -> Index {
+    const auto END = m_nodes[index].m_end;
+    const auto PARENT = m_nodes[index].m_parent;
+    const auto LIMIT = PARENT == NONE ? static_cast<Index>(m_nodes.size())
+                                      : m_nodes[PARENT].m_end;
+    return END < LIMIT ? END : NONE;
+  }
+
+  /** @brief Node range `[first, last)` of @p index and all below it. */
+  [[nodiscard]] auto subtree(Index index) const -> std::pair<Index, Index> {
+    return {index, m_nodes[index].m_end};
+  }
+
+  /** @brief Function of a `Kind::FUNCTION` node. */
+  [[nodiscard]] auto function(Index index) const -> UsbFunction {
+    return m_functions.function(m_nodes[index].m_function);
+  }
+
+  /** @brief Every function in the subtree of @p index, in tree order. */
+  [[nodiscard]] auto functions_under(Index index) const
+      -> std::vector<UsbFunction>;
+
+  /** @brief All attached functions as compact rows. */
+  [[nodiscard]] auto functions() const -> const FunctionTable& {
+    return m_functions;
+  }
+
+ private:
+  std::vector<Node> m_nodes;
+  StringPool m_names;
+  /** Pool id of a name → its node. */
+  std::vector<Index> m_node_of_name;
+  FunctionTable m_functions;
+};
+}  // namespace fs_tools
@@ -7,8 +7,13 @@
  * operations:
  *   - Existence/type checks via lstat(2)
  *   - Simple path join
- *   - Directory listing (non-recursive)
+ *   - Directory listing (non-recursive), optionally typed straight from
+ *     readdir(3) (`DirEntry`: name, d_type, inode)
  *   - One-shot symlink read
+ *   - Small attribute reads via open(2)/read(2) into a reusable buffer
+ *   - Directory-descriptor-relative traversal (`DirHandle`: openat/fstatat/
+ *     readlinkat), so repeated lookups under one directory skip the full
+ *     path walk
  *   - Single-directory creation
  *
  * All functions are header-only and intend to be minimal and portable across
@@ -18,6 +23,7 @@
  */
 #pragma once
 #include <dirent.h>
+#include <fcntl.h>
 #include <fnmatch.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -28,6 +34,7 @@
 #include <cstring>
 #include <string>
 #include <system_error>
+#include <utility>
 #include <vector>
 
 namespace fs_tools {
@@ -165,25 +172,122 @@ namespace fs_tools {
 }
 
 /**
- * @brief List regular files in a directory that match a POSIX pattern
+ * @brief `fnmatch(3)` pattern compiled once for repeated matching.
+ * @details
+ * The pattern is classified up front, and the common shapes skip
+ * `fnmatch(3)` entirely:
+ *   - "*" — matches any name (no comparison at all)
+ *   - "ttyUSB0" — literal, one `memcmp`
+ *   - "ttyUSB*" / "*.bin" — prefix / suffix, one `memcmp`
+ *   - anything else ("file?.txt", "[a-z]*", escapes, extra @p flags) —
+ *     `fnmatch(3)` with the stored pattern
+ *
+ * Fast paths give the same answers as `fnmatch(pattern, name, flags)`; with
+ * `FNM_PATHNAME` a '*' never matches a '/'. An empty pattern matches
+ * nothing. Immutable after construction, so one `Glob` can be shared by
+ * any number of calls and threads.
+ */
+class Glob {
+ public:
+  enum class Kind : unsigned char {
+    NOTHING,
+    ANY,
+    LITERAL,
+    PREFIX,
+    SUFFIX,
+    GENERAL
+  };
+
+  explicit Glob(std::string pattern, int flags = FNM_PATHNAME)
+      : m_pattern(std::move(pattern)), m_flags(flags) {
+    if (m_pattern.empty()) {
+      m_kind = Kind::NOTHING;
+      return;
+    }
+    const auto META = m_pattern.find_first_of("*?[\\");
+    // FNM_PATHNAME меняет только поведение '*' относительно '/' — учтено ниже;
+    // прочие флаги (регистр, точка, ...) — только общий путь
+    if ((m_flags & ~FNM_PATHNAME) != 0) {
+      m_kind = Kind::GENERAL;
+    } else if (META == std::string::npos) {
+      m_kind = Kind::LITERAL;
+      m_fixed = m_pattern;
+    } else if (m_pattern == "*") {
+      m_kind = Kind::ANY;
+    } else if (META == m_pattern.size() - 1 && m_pattern.back() == '*') {
+      m_kind = Kind::PREFIX;
+      m_fixed = m_pattern.substr(0, META);
+    } else if (META == 0 && m_pattern[0] == '*' &&
+               m_pattern.find_first_of("*?[\\", 1) == std::string::npos) {
+      m_kind = Kind::SUFFIX;
+      m_fixed = m_pattern.substr(1);
+    } else {
+      m_kind = Kind::GENERAL;
+    }
+  }
+
+  /** @brief Whether @p name matches. */
+  [[nodiscard]] auto matches(const char* name) const -> bool {
+    switch (m_kind) {
+      case Kind::NOTHING:
+        return false;
+      case Kind::GENERAL:
+        return ::fnmatch(m_pattern.c_str(), name, m_flags) == 0;
+      default:
+        break;
+    }
+    const size_t SIZE = std::strlen(name);
+    if (m_kind == Kind::LITERAL) {
+      return SIZE == m_fixed.size() &&
+             std::memcmp(name, m_fixed.data(), SIZE) == 0;
+    }
+    if (SIZE < m_fixed.size()) {
+      return false;
+    }
+    // часть имени, съеденная '*'
+    const char* wild = name;
+    if (m_kind == Kind::PREFIX) {
+      if (std::memcmp(name, m_fixed.data(), m_fixed.size()) != 0) {
+        return false;
+      }
+      wild = name + m_fixed.size();
+    } else if (m_kind == Kind::SUFFIX &&
+               std::memcmp(name + SIZE - m_fixed.size(), m_fixed.data(),
+                           m_fixed.size()) != 0) {
+      return false;
+    }
+    const size_t WILD_SIZE = SIZE - m_fixed.size();
+    return (m_flags & FNM_PATHNAME) == 0 ||
+           std::memchr(wild, '/', WILD_SIZE) == nullptr;
+  }
+
+  [[nodiscard]] auto matches(const std::string& name) const -> bool {
+    return matches(name.c_str());
+  }
+
+  [[nodiscard]] auto kind() const -> Kind { return m_kind; }
+  [[nodiscard]] auto pattern() const -> const std::string& {
+    return m_pattern;
+  }
+
+ private:
+  std::string m_pattern;
+  /** Literal part for LITERAL/PREFIX/SUFFIX. */
+  std::string m_fixed;
+  int m_flags;
+  Kind m_kind = Kind::GENERAL;
+};
+
+/**
+ * @brief List regular files in a directory that match a compiled pattern
  * (non-recursive).
  * @param dir Directory path to scan.
- * @param pattern POSIX fnmatch pattern (e.g., "*.bin", "config_*",
- * "file?.txt").
+ * @param glob Pattern compiled once (see `Glob`); may be reused across calls.
  * @return Vector of file paths matching the pattern.
- * @details
- * - Only includes regular files (not directories).
- * - Uses POSIX `fnmatch(3)` with `FNM_PATHNAME` for matching.
- * - Important: an empty @p pattern matches **nothing**; pass "*" to match all
- * entries.
- * - Common patterns:
- *   - "*.bin" — all `.bin` files
- *   - "file_*" — files starting with `file_`
- *   - "config_??.txt" — config files with 2 chars between
- * - Returns an empty vector on error.
+ * @details Same as the string overload; a "*" pattern skips matching.
  */
 [[maybe_unused]] inline auto list_dir_fs(const std::string& dir,
-                        const std::string& pattern = "*")
+                                         const Glob& glob)
     -> std::vector<std::string> {
   std::vector<std::string> out;
   DIR* fs_dir = ::opendir(dir.c_str());
@@ -191,6 +295,7 @@ namespace fs_tools {
     return out;
   }
 
+  const bool ANY = glob.kind() == Glob::Kind::ANY;
   while (const auto* subdir = ::readdir(fs_dir)) {
     if (std::strcmp(subdir->d_name, ".") == 0 ||
         std::strcmp(subdir->d_name, "..") == 0) {
@@ -198,7 +303,7 @@ namespace fs_tools {
     }
 
     // Check pattern match
-    if (::fnmatch(pattern.c_str(), subdir->d_name, FNM_PATHNAME) != 0) {
+    if (!ANY && !glob.matches(subdir->d_name)) {
       continue;
     }
 
@@ -216,6 +321,32 @@ namespace fs_tools {
   return out;
 }
 
+/**
+ * @brief List regular files in a directory that match a POSIX pattern
+ * (non-recursive).
+ * @param dir Directory path to scan.
+ * @param pattern POSIX fnmatch pattern (e.g., "*.bin", "config_*",
+ * "file?.txt").
+ * @return Vector of file paths matching the pattern.
+ * @details
+ * - Only includes regular files (not directories).
+ * - Matches like POSIX `fnmatch(3)` with `FNM_PATHNAME`; the pattern is
+ *   compiled into a `Glob` once per call, not per entry. Callers listing
+ *   repeatedly should keep a `Glob` and use the overload above.
+ * - Important: an empty @p pattern matches **nothing**; pass "*" to match all
+ * entries.
+ * - Common patterns:
+ *   - "*.bin" — all `.bin` files
+ *   - "file_*" — files starting with `file_`
+ *   - "config_??.txt" — config files with 2 chars between
+ * - Returns an empty vector on error.
+ */
+[[maybe_unused]] inline auto list_dir_fs(const std::string& dir,
+                        const std::string& pattern = "*")
+    -> std::vector<std::string> {
+  return list_dir_fs(dir, Glob(pattern));
+}
+
 /**
  * @brief List entries in a directory (non-recursive).
  * @param dir Directory path to scan.
@@ -245,6 +376,112 @@ namespace fs_tools {
   return out;
 }
 
+/**
+ * @brief One directory entry as reported by readdir(3).
+ * @details @p m_type is a `DT_*` constant. Without symlink following it is
+ * what the filesystem reported (sysfs, ext4, tmpfs fill it in, so no stat is
+ * needed); `DT_UNKNOWN` is resolved with a single `fstatat(2)`.
+ */
+struct DirEntry {
+  /** Entry name (no directory prefix). */
+  std::string m_name;
+  /** `DT_DIR`, `DT_LNK`, `DT_REG`, ... */
+  unsigned char m_type = DT_UNKNOWN;
+  /** Inode number from `d_ino`. */
+  ino_t m_inode = 0;
+
+  [[nodiscard]] auto is_dir() const -> bool { return m_type == DT_DIR; }
+  [[nodiscard]] auto is_symlink() const -> bool { return m_type == DT_LNK; }
+  [[nodiscard]] auto is_reg() const -> bool { return m_type == DT_REG; }
+};
+
+/**
+ * @brief Convert `st_mode` to the matching `DT_*` constant.
+ */
+[[maybe_unused]] inline auto mode_to_dtype(mode_t mode) -> unsigned char {
+  switch (mode & S_IFMT) {
+    case S_IFDIR:
+      return DT_DIR;
+    case S_IFREG:
+      return DT_REG;
+    case S_IFLNK:
+      return DT_LNK;
+    case S_IFCHR:
+      return DT_CHR;
+    case S_IFBLK:
+      return DT_BLK;
+    case S_IFIFO:
+      return DT_FIFO;
+    case S_IFSOCK:
+      return DT_SOCK;
+    default:
+      return DT_UNKNOWN;
+  }
+}
+
+/**
+ * @brief List typed entries of an already-open directory descriptor.
+ * @param dirfd Directory descriptor (not consumed; a private one is opened).
+ * @param follow_symlinks If `true`, entries of type `DT_LNK` report the type
+ * of their target (one `fstatat(2)` per symlink; broken links stay `DT_LNK`).
+ * @return Entries except "." and ".." in readdir order; empty on error.
+ */
+[[maybe_unused]] inline auto list_entries_at(int dirfd,
+                                             bool follow_symlinks = false)
+    -> std::vector<DirEntry> {
+  std::vector<DirEntry> out;
+  const int FD = ::openat(dirfd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (FD < 0) {
+    return out;
+  }
+  DIR* fs_dir = ::fdopendir(FD);
+  if (fs_dir == nullptr) {
+    ::close(FD);
+    return out;
+  }
+  while (const auto* subdir = ::readdir(fs_dir)) {
+    if (subdir->d_name[0] == '.' &&
+        (subdir->d_name[1] == '\0' ||
+         (subdir->d_name[1] == '.' && subdir->d_name[2] == '\0'))) {
+      continue;
+    }
+    DirEntry entry;
+    entry.m_name = subdir->d_name;
+    entry.m_type = subdir->d_type;
+    entry.m_inode = subdir->d_ino;
+    const bool RESOLVE = entry.m_type == DT_UNKNOWN ||
+                         (follow_symlinks && entry.m_type == DT_LNK);
+    if (struct stat stt{};
+        RESOLVE && ::fstatat(::dirfd(fs_dir), subdir->d_name, &stt,
+                             follow_symlinks ? 0 : AT_SYMLINK_NOFOLLOW) == 0) {
+      entry.m_type = mode_to_dtype(stt.st_mode);
+    }
+    out.push_back(std::move(entry));
+  }
+  ::closedir(fs_dir);
+  return out;
+}
+
+/**
+ * @brief List typed entries of a directory (non-recursive).
+ * @param dir Directory path to scan.
+ * @param follow_symlinks See `list_entries_at()`.
+ * @return Entries except "." and ".."; empty on error.
+ * @details Unlike `list_dirs()`, callers can filter by type without an extra
+ * `lstat(2)` per entry.
+ */
+[[maybe_unused]] inline auto list_entries(const std::string& dir,
+                                          bool follow_symlinks = false)
+    -> std::vector<DirEntry> {
+  const int FD = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (FD < 0) {
+    return {};
+  }
+  auto out = list_entries_at(FD, follow_symlinks);
+  ::close(FD);
+  return out;
+}
+
 /**
  * @brief Read a symbolic link target once.
  * @param path Path to the symlink.
@@ -277,6 +514,231 @@ namespace fs_tools {
   return buf;
 }
 
+/**
+ * @brief Read a small attribute file relative to a directory descriptor.
+ * @param dirfd Directory descriptor, or `AT_FDCWD` to resolve @p name against
+ * the current directory (absolute names ignore @p dirfd).
+ * @param name Attribute file name or path.
+ * @param out Destination buffer; cleared first, its capacity is reused.
+ * @param error Set to the failing `errno` (from `openat(2)` or `read(2)`).
+ * @return `true` on success, `false` otherwise (with @p out empty).
+ * @details
+ * - Opens with `O_RDONLY | O_CLOEXEC`; no stream or locale machinery.
+ * - Reads in page-sized chunks. sysfs produces an attribute with a single
+ *   `show()` call of at most one page, so a short read means end of file and
+ *   the usual extra zero-length `read(2)` is skipped.
+ * - Pass the same @p out across calls to avoid reallocations.
+ */
+[[maybe_unused]] inline auto read_attr_at(int dirfd, const char* name,
+                                          std::string& out,
+                                          std::error_code& error) -> bool {
+  constexpr size_t CHUNK = 4096U;
+  out.clear();
+  const int FD = ::openat(dirfd, name, O_RDONLY | O_CLOEXEC);
+  if (FD < 0) {
+    error = std::error_code(errno, std::generic_category());
+    return false;
+  }
+
+  size_t used = 0;
+  while (true) {
+    if (out.size() < used + CHUNK) {
+      out.resize(used + CHUNK);
+    }
+    const ssize_t NUM = ::read(FD, &out[used], CHUNK);
+    if (NUM < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      error = std::error_code(errno, std::generic_category());
+      ::close(FD);
+      out.clear();
+      return false;
+    }
+    used += static_cast<size_t>(NUM);
+    if (static_cast<size_t>(NUM) < CHUNK) {
+      break;
+    }
+  }
+  ::close(FD);
+  out.resize(used);
+  error.clear();
+  return true;
+}
+
+/**
+ * @brief Read a small attribute file (e.g. a sysfs `uevent`) by path.
+ * @param path Path to the file.
+ * @param out Destination buffer; cleared first, its capacity is reused.
+ * @param error Set to the failing `errno` on error.
+ * @return `true` on success, `false` otherwise.
+ * @details See `read_attr_at()`.
+ */
+[[maybe_unused]] inline auto read_attr(const std::string& path,
+                                       std::string& out,
+                                       std::error_code& error) -> bool {
+  return read_attr_at(AT_FDCWD, path.c_str(), out, error);
+}
+
+/**
+ * @brief RAII owner of a directory file descriptor for `*at()` traversal.
+ * @details
+ * Opening a directory once and resolving children relative to it lets the
+ * kernel skip re-walking the common prefix on every lookup, and callers skip
+ * building absolute path strings. All relative operations take a name (or
+ * short relative path) under this directory.
+ * @note Move-only; the descriptor is closed on destruction.
+ */
+class DirHandle {
+ public:
+  DirHandle() = default;
+
+  /**
+   * @brief Open @p path as a directory (following symlinks).
+   * @param path Directory path.
+   * @param error Set to the `openat(2)` errno on failure (ENOTDIR if not a
+   * directory).
+   * @return Handle; check `valid()`.
+   */
+  static auto open(const std::string& path, std::error_code& error)
+      -> DirHandle {
+    return open_impl(AT_FDCWD, path.c_str(), path, error);
+  }
+
+  /**
+   * @brief Open child directory @p name relative to this one.
+   * @details Symlinks are followed, so this also enters sysfs class entries
+   * such as "/sys/class/tty/ttyUSB0".
+   */
+  [[nodiscard]] auto open_at(const std::string& name,
+                             std::error_code& error) const -> DirHandle {
+    return open_impl(m_fd, name.c_str(), join_path(m_path, name), error);
+  }
+
+  /**
+   * @brief `fstatat(2)` on @p name relative to this directory.
+   * @param follow_symlinks `false` inspects the link itself (like lstat).
+   */
+  auto stat_at(const std::string& name, struct stat& out,
+               bool follow_symlinks = false) const -> bool {
+    return ::fstatat(m_fd, name.c_str(), &out,
+                     follow_symlinks ? 0 : AT_SYMLINK_NOFOLLOW) == 0;
+  }
+
+  /**
+   * @brief Read the symlink @p name relative to this directory.
+   * @return Raw link target (may be relative), or empty string on error.
+   */
+  [[nodiscard]] auto readlink_at(const std::string& name) const
+      -> std::string {
+    std::array<char, PATH_MAX> buf;
+    const ssize_t NUM =
+        ::readlinkat(m_fd, name.c_str(), buf.data(), buf.size());
+    if (NUM < 0) {
+      return {};
+    }
+    return {buf.data(), static_cast<size_t>(NUM)};
+  }
+
+  /**
+   * @brief Read attribute @p name relative to this directory.
+   * @details See the free function `read_attr_at()`.
+   */
+  auto read_attr_at(const std::string& name, std::string& out,
+                    std::error_code& error) const -> bool;
+
+  /**
+   * @brief Names of all entries except "." and "..", in readdir order.
+   * @details Uses a private descriptor, so it can be called repeatedly.
+   */
+  [[nodiscard]] auto entries() const -> std::vector<std::string> {
+    std::vector<std::string> out;
+    const int FD = ::openat(m_fd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (FD < 0) {
+      return out;
+    }
+    DIR* fs_dir = ::fdopendir(FD);
+    if (fs_dir == nullptr) {
+      ::close(FD);
+      return out;
+    }
+    while (const auto* subdir = ::readdir(fs_dir)) {
+      if (subdir->d_name[0] == '.' &&
+          (subdir->d_name[1] == '\0' ||
+           (subdir->d_name[1] == '.' && subdir->d_name[2] == '\0'))) {
+        continue;
+      }
+      out.emplace_back(subdir->d_name);
+    }
+    ::closedir(fs_dir);
+    return out;
+  }
+
+  /**
+   * @brief Typed entries (name, d_type, inode) straight from readdir.
+   * @details See `list_entries_at()`.
+   */
+  [[nodiscard]] auto typed_entries(bool follow_symlinks = false) const
+      -> std::vector<DirEntry> {
+    return list_entries_at(m_fd, follow_symlinks);
+  }
+
+  /** @brief Whether the handle owns an open descriptor. */
+  [[nodiscard]] auto valid() const -> bool { return m_fd >= 0; }
+
+  /** @brief Raw descriptor (owned by the handle). */
+  [[nodiscard]] auto fd() const -> int { return m_fd; }
+
+  /** @brief Path the handle was opened with (not canonicalized). */
+  [[nodiscard]] auto path() const -> const std::string& { return m_path; }
+
+  DirHandle(const DirHandle&) = delete;
+  auto operator=(const DirHandle&) -> DirHandle& = delete;
+  DirHandle(DirHandle&& other) noexcept
+      : m_fd(other.m_fd), m_path(std::move(other.m_path)) {
+    other.m_fd = -1;
+  }
+  auto operator=(DirHandle&& other) noexcept -> DirHandle& {
+    if (this != &other) {
+      reset();
+      m_fd = other.m_fd;
+      m_path = std::move(other.m_path);
+      other.m_fd = -1;
+    }
+    return *this;
+  }
+  ~DirHandle() { reset(); }
+
+ private:
+  DirHandle(int fd, std::string path) : m_fd(fd), m_path(std::move(path)) {}
+
+  static auto open_impl(int dirfd, const char* name, std::string path,
+                        std::error_code& error) -> DirHandle {
+    const int FD = ::openat(dirfd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (FD < 0) {
+      error = std::error_code(errno, std::generic_category());
+      return {};
+    }
+    error.clear();
+    return {FD, std::move(path)};
+  }
+
+  void reset() {
+    if (m_fd >= 0) {
+      ::close(m_fd);
+      m_fd = -1;
+    }
+  }
+
+  int m_fd = -1;
+  std::string m_path;
+};
+
+inline auto DirHandle::read_attr_at(const std::string& name, std::string& out,
+                                    std::error_code& error) const -> bool {
+  return fs_tools::read_attr_at(m_fd, name.c_str(), out, error);
+}
+
 /**
  * @brief Create a directory if it does not already exist.
  * @param path Directory path to create.
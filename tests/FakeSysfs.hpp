@@ -0,0 +1,331 @@
+/**
+ * @file FakeSysfs.hpp
+ * @brief Synthetic sysfs trees for tests and benchmarks.
+ * @details
+ * Builds N USB devices × M functions under a scratch directory, laid out like
+ * a real `/sys`:
+ *
+ *     sys/devices/pci0000:00/0000:00:14.0/usb1/1-1/1-1.1/1-1.1.3/
+ *         uevent                      PRODUCT=1a86/7002/100, DEVTYPE=usb_device
+ *         1-1.1.3:1.0/uevent          PRODUCT=..., DEVTYPE=usb_interface
+ *         1-1.1.3:1.0/ttyUSB2/tty/ttyUSB2/
+ *                                     uevent (DEVNAME=...), device → ../..
+ *     sys/bus/usb/devices/1-1.1.3   → ../../../devices/...   (relative links)
+ *     sys/class/tty/ttyUSB2         → ../../devices/...
+ *
+ * As in the kernel, a tty hangs below its usb-serial port directory and a
+ * hidraw below its HID device ("1-1.1.3:1.1/0003:1A86:7002.0001/hidraw/
+ * hidraw0"), so `device` points below the interface; other classes hang
+ * directly off the interface.
+ *
+ * Devices hang below a chain of `m_hub_depth` hubs, so the ancestor walk and
+ * the symlink resolution have real-world depth. The root hub and every hub
+ * carry the hub interface the kernel adds ("1-0:1.0" under usb1, "1-1:1.0"). Vendor is always 1a86; the
+ * product id of device `d` is `7000 + d` (hex), so every device has a unique
+ * VID:PID, unless `m_identical` makes them all 1a86:7000. Every USB device
+ * also carries `busnum`, `devnum`, `speed` and `devpath`; devices (not hubs)
+ * have `serial` "SN<d>". Interfaces link `driver` to a per-class driver
+ * (tty → ch341, hidraw → usbhid, others → uvcvideo).
+ *
+ * The same tree can be generated into a `MemoryBackend` instead of disk,
+ * rooted at "/" (so paths are the real "/sys/..."), for fleet-sized runs.
+ */
+#pragma once
+
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "MemoryBackend.hpp"
+
+namespace fs_tools::testing {
+namespace fs = std::filesystem;
+
+/** Shape of the generated tree. */
+struct FakeSysfsOptions {
+  size_t m_devices = 4;
+  /** USB interfaces per device; each carries one class device. */
+  size_t m_functions = 2;
+  /** Hubs between the root hub and the devices. */
+  size_t m_hub_depth = 2;
+  /** Interface `i` gets class `m_classes[i % size]`. */
+  std::vector<std::string> m_classes{"tty", "hidraw", "video4linux"};
+  /** Identical adapters: one VID:PID for all devices, told apart by serial. */
+  bool m_identical = false;
+};
+
+/** One generated function, as `SysFSHelper` should report it. */
+struct FakeFunction {
+  std::string m_vid;
+  std::string m_pid;
+  /** Canonical path of the interface the class device hangs off. */
+  std::string m_usb_node;
+  std::string m_class_name;
+  std::string m_dev_name;
+};
+
+/** Generated tree; removed from disk on destruction. */
+class FakeSysfs {
+ public:
+  static constexpr const char* VENDOR = "1a86";
+
+  explicit FakeSysfs(const fs::path& root, FakeSysfsOptions options = {})
+      : m_options(std::move(options)) {
+    fs::remove_all(root);
+    fs::create_directories(root / "sys/bus/usb/devices");
+    m_root = fs::canonical(root);
+    generate();
+  }
+
+  /** Tree under "/sys" of @p memory; nothing touches disk. */
+  explicit FakeSysfs(MemoryBackend& memory, FakeSysfsOptions options = {})
+      : m_options(std::move(options)), m_root("/"), m_memory(&memory) {
+    make_dir("bus/usb/devices");
+    generate();
+  }
+
+  FakeSysfs(const FakeSysfs&) = delete;
+  auto operator=(const FakeSysfs&) -> FakeSysfs& = delete;
+
+  ~FakeSysfs() {
+    if (m_memory != nullptr) {
+      return;
+    }
+    std::error_code error;
+    fs::remove_all(m_root, error);
+  }
+
+  [[nodiscard]] auto root() const -> const fs::path& { return m_root; }
+
+  /** "<root>/sys/bus/usb/devices". */
+  [[nodiscard]] auto usb_root() const -> std::string {
+    return (m_root / "sys/bus/usb/devices").string();
+  }
+
+  /** "<root>/sys/class/<cls>" for every configured class. */
+  [[nodiscard]] auto class_roots() const -> std::vector<std::string> {
+    std::vector<std::string> out;
+    for (const auto& cls : m_options.m_classes) {
+      out.push_back((m_root / "sys/class" / cls).string());
+    }
+    return out;
+  }
+
+  /** Generated functions in creation order. */
+  [[nodiscard]] auto functions() const -> const std::vector<FakeFunction>& {
+    return m_functions;
+  }
+
+  /** Every (VID, PID) under the USB root, hubs included, sorted. */
+  [[nodiscard]] auto ids() const
+      -> std::vector<std::pair<std::string, std::string>> {
+    return {m_ids.begin(), m_ids.end()};
+  }
+
+ private:
+  void generate() {
+    for (const auto& cls : m_options.m_classes) {
+      make_dir("class/" + cls);
+    }
+
+    std::string parent = "devices/pci0000:00/0000:00:14.0/usb1";
+    add_usb_device(parent, "usb1", "1d6b/2/606");
+    add_hub_interface(parent, "1-0", "1d6b/2/606");
+    std::string name = "1-1";
+    for (size_t hub = 0; hub < m_options.m_hub_depth; ++hub) {
+      parent += "/" + name;
+      add_usb_device(parent, name, "5e3/610/9322");
+      add_hub_interface(parent, name, "5e3/610/9322");
+      name += ".1";
+    }
+
+    std::map<std::string, size_t> numbers;
+    for (size_t dev = 0; dev < m_options.m_devices; ++dev) {
+      const auto DEV_NAME =
+          m_options.m_hub_depth == 0
+              ? "1-" + std::to_string(dev + 1)
+              : name.substr(0, name.size() - 2) + "." + std::to_string(dev + 1);
+      const auto DEV_DIR = parent + "/" + DEV_NAME;
+      const auto PID = hex(0x7000 + (m_options.m_identical ? 0 : dev));
+      const auto PRODUCT = std::string(VENDOR) + "/" + PID + "/100";
+      add_usb_device(DEV_DIR, DEV_NAME, PRODUCT, "SN" + std::to_string(dev));
+
+      for (size_t fun = 0; fun < m_options.m_functions; ++fun) {
+        const auto IFACE_NAME = DEV_NAME + ":1." + std::to_string(fun);
+        const auto IFACE_DIR = DEV_DIR + "/" + IFACE_NAME;
+        write(IFACE_DIR + "/uevent", "DEVTYPE=usb_interface\nPRODUCT=" +
+                                         PRODUCT + "\nINTERFACE=255/0/0\n");
+        link("bus/usb/devices/" + IFACE_NAME, "../../../" + IFACE_DIR);
+        if (m_options.m_classes.empty()) {
+          continue;
+        }
+
+        const auto& cls = m_options.m_classes[fun % m_options.m_classes.size()];
+        const auto DRIVER = driver_name(cls);
+        make_dir("bus/usb/drivers/" + DRIVER);
+        link(IFACE_DIR + "/driver",
+             up(IFACE_DIR) + "bus/usb/drivers/" + DRIVER);
+        const auto NUMBER = numbers[cls]++;
+        const auto DEVNAME = dev_name(cls, NUMBER);
+        const auto ENTRY = DEVNAME.substr(DEVNAME.find_last_of('/') + 1);
+        // родитель class-устройства: порт usb-serial, HID-устройство или
+        // сам интерфейс
+        auto parentDir = IFACE_DIR;
+        if (cls == "tty") {
+          parentDir += "/" + ENTRY;
+          write(parentDir + "/uevent", "DRIVER=" + DRIVER + "-uart\n");
+        } else if (cls == "hidraw") {
+          parentDir += "/0003:" + upper(VENDOR) + ":" + upper(PID) + "." +
+                       hex4(++m_hid_number);
+          write(parentDir + "/uevent", "DRIVER=hid-generic\nHID_ID=0003:" +
+                                           upper(VENDOR) + ":" + upper(PID) +
+                                           "\n");
+        }
+        const auto CLASS_DIR = parentDir + "/" + cls + "/" + ENTRY;
+        write(CLASS_DIR + "/uevent", "MAJOR=188\nMINOR=" +
+                                         std::to_string(NUMBER) +
+                                         "\nDEVNAME=" + DEVNAME + "\n");
+        link(CLASS_DIR + "/device", "../..");
+        link("class/" + cls + "/" + ENTRY, "../../" + CLASS_DIR);
+
+        m_functions.push_back(
+            {VENDOR, PID, (m_root / "sys" / IFACE_DIR).string(), cls, DEVNAME});
+      }
+    }
+  }
+
+  static auto hex(size_t value) -> std::string {
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%zx", value);
+    return buf;
+  }
+
+  static auto upper(std::string str) -> std::string {
+    for (char& chr : str) {
+      chr = static_cast<char>(std::toupper(static_cast<unsigned char>(chr)));
+    }
+    return str;
+  }
+
+  /** "%04X", as in HID device names. */
+  static auto hex4(size_t value) -> std::string {
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%04zX", value);
+    return buf;
+  }
+
+  static auto dev_name(const std::string& cls, size_t number) -> std::string {
+    const auto NUM = std::to_string(number);
+    if (cls == "tty") {
+      return "ttyUSB" + NUM;
+    }
+    if (cls == "video4linux") {
+      return "video" + NUM;
+    }
+    if (cls == "sound") {
+      return "snd/controlC" + NUM;
+    }
+    return cls + NUM;  // hidraw0, usblp0, ...
+  }
+
+  static auto driver_name(const std::string& cls) -> std::string {
+    if (cls == "tty") {
+      return "ch341";
+    }
+    return cls == "hidraw" ? "usbhid" : "uvcvideo";
+  }
+
+  /** "../" per component of @p rel: from "<root>/sys/<rel>" back to sys. */
+  static auto up(const std::string& rel) -> std::string {
+    std::string out = "../";
+    for (const char CH : rel) {
+      if (CH == '/') {
+        out += "../";
+      }
+    }
+    return out;
+  }
+
+  void add_usb_device(const std::string& dir, const std::string& name,
+                      const std::string& product,
+                      const std::string& serial = {}) {
+    write(dir + "/uevent",
+          "DEVTYPE=usb_device\nDRIVER=usb\nPRODUCT=" + product + "\n");
+    const auto DASH = name.find('-');
+    write(dir + "/busnum", "1\n");
+    write(dir + "/devnum", std::to_string(++m_devnum) + "\n");
+    write(dir + "/speed", "480\n");
+    write(dir + "/devpath",
+          (DASH == std::string::npos ? "0" : name.substr(DASH + 1)) + "\n");
+    if (!serial.empty()) {
+      write(dir + "/serial", serial + "\n");
+    }
+    link("bus/usb/devices/" + name, "../../../" + dir);
+    const auto FIRST = product.find('/');
+    const auto SECOND = product.find('/', FIRST + 1);
+    m_ids.emplace(product.substr(0, FIRST),
+                  product.substr(FIRST + 1, SECOND - FIRST - 1));
+  }
+
+  /** Interface "<name>:1.0" the hub driver binds to, as on every hub. */
+  void add_hub_interface(const std::string& dir, const std::string& name,
+                         const std::string& product) {
+    const auto IFACE_NAME = name + ":1.0";
+    const auto IFACE_DIR = dir + "/" + IFACE_NAME;
+    write(IFACE_DIR + "/uevent",
+          "DEVTYPE=usb_interface\nDRIVER=hub\nPRODUCT=" + product +
+              "\nINTERFACE=9/0/0\n");
+    make_dir("bus/usb/drivers/hub");
+    link(IFACE_DIR + "/driver", up(IFACE_DIR) + "bus/usb/drivers/hub");
+    link("bus/usb/devices/" + IFACE_NAME, "../../../" + IFACE_DIR);
+  }
+
+  /** Directory "<root>/sys/<rel>" and its parents. */
+  void make_dir(const std::string& rel) const {
+    const auto PATH = m_root / "sys" / rel;
+    if (m_memory != nullptr) {
+      m_memory->add_dir(PATH.string());
+      return;
+    }
+    fs::create_directories(PATH);
+  }
+
+  /** Write @p data to "<root>/sys/<rel>", creating parents. */
+  void write(const std::string& rel, const std::string& data) const {
+    const auto PATH = m_root / "sys" / rel;
+    if (m_memory != nullptr) {
+      m_memory->add_file(PATH.string(), data);
+      return;
+    }
+    fs::create_directories(PATH.parent_path());
+    std::ofstream(PATH, std::ios::binary) << data;
+  }
+
+  /** Symlink "<root>/sys/<rel>" → @p target (relative, as in sysfs). */
+  void link(const std::string& rel, const std::string& target) const {
+    const auto PATH = m_root / "sys" / rel;
+    if (m_memory != nullptr) {
+      m_memory->add_symlink(PATH.string(), target);
+      return;
+    }
+    fs::create_directories(PATH.parent_path());
+    fs::create_symlink(target, PATH);
+  }
+
+  FakeSysfsOptions m_options;
+  fs::path m_root;
+  std::vector<FakeFunction> m_functions;
+  std::set<std::pair<std::string, std::string>> m_ids;
+  size_t m_devnum = 0;
+  size_t m_hid_number = 0;
+  /** Target tree instead of disk, if set. */
+  MemoryBackend* m_memory = nullptr;
+};
+}  // namespace fs_tools::testing
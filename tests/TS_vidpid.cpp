@@ -1,11 +1,35 @@
 #include <gtest/gtest.h>
+#include <fnmatch.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <thread>
 
+#include "BatchReader.hpp"
+#include "DeviceRegistry.hpp"
+#include "DeviceSnapshot.hpp"
+#include "EnumStats.hpp"
+#include "FakeSysfs.hpp"
+#include "FunctionTable.hpp"
+#include "FsBackend.hpp"
+#include "HotplugMonitor.hpp"
+#include "MemoryBackend.hpp"
+#include "PathResolver.hpp"
+#include "SnapshotCache.hpp"
 #include "SysFSHelper.hpp"
+#include "SysFSIndex.hpp"
+#include "UsbDevice.hpp"
+#include "UsbQuery.hpp"
+#include "UsbTopology.hpp"
 
 namespace fs = std::filesystem;
 
@@ -33,6 +57,237 @@ static void write_all(const fs::path& path, const std::string& data) {
   ASSERT_TRUE(fs::exists(path)) << "File not created: " << path;
 }
 
+// фейковое дерево ForwardAndReverse: 067b:2303 с ttyACM0 и hidraw0 на одном
+// интерфейсе; возвращает корни классов
+static auto make_acm_tree(const fs::path& root) -> std::vector<std::string> {
+  fs::remove_all(root);
+  const fs::path USB_DEV = root / "sys/bus/usb/devices/1-1";
+  const fs::path IFACE = USB_DEV / "1-1:1.0";
+  const fs::path SYS_TTY = root / "sys/class/tty";
+  const fs::path SYS_HID = root / "sys/class/hidraw";
+  write_all(USB_DEV / "uevent", "DRIVER=usb\nPRODUCT=067b/2303/0100\n");
+  fs::create_directories(IFACE);
+  write_all(SYS_TTY / "ttyACM0" / "uevent", "DEVNAME=ttyACM0\n");
+  fs::create_symlink(weakly_canonical_compat(IFACE),
+                     SYS_TTY / "ttyACM0" / "device");
+  write_all(SYS_HID / "hidraw0" / "uevent", "DEVNAME=hidraw0\n");
+  fs::create_symlink(weakly_canonical_compat(IFACE),
+                     SYS_HID / "hidraw0" / "device");
+  return {SYS_TTY.string(), SYS_HID.string()};
+}
+
+TEST(VidPidHelper, UeventParser_And_NormalizeId) {
+  using Uevent = fs_tools::SysFSHelper::Uevent;
+  const std::string CONTENT =
+      "MAJOR=188\nMINOR=0\nDEVNAME=ttyUSB0\nPRODUCT=403/6001/600\n"
+      "DEVNAME=ignored\nBROKEN LINE\nDRIVER=";
+  const auto EVENT = Uevent::parse(CONTENT);
+  EXPECT_EQ(EVENT.m_major, "188");
+  EXPECT_EQ(EVENT.m_minor, "0");
+  EXPECT_EQ(EVENT.m_devname, "ttyUSB0");
+  EXPECT_EQ(EVENT.m_product, "403/6001/600");
+  EXPECT_TRUE(EVENT.has(Uevent::DRIVER));
+  EXPECT_TRUE(EVENT.m_driver.empty());
+  EXPECT_FALSE(EVENT.has(Uevent::BUSNUM));
+
+  // запрошен только DEVNAME — остальные ключи не заполняются
+  const auto ONLY = Uevent::parse(CONTENT, Uevent::DEVNAME);
+  EXPECT_EQ(ONLY.m_devname, "ttyUSB0");
+  EXPECT_FALSE(ONLY.has(Uevent::PRODUCT));
+
+  EXPECT_EQ(fs_tools::SysFSHelper::normalize_id("0x0403"), "403");
+  EXPECT_EQ(fs_tools::SysFSHelper::normalize_id("1A86"), "1a86");
+  EXPECT_EQ(fs_tools::SysFSHelper::normalize_id("0000"), "0");
+  EXPECT_EQ(fs_tools::SysFSHelper::normalize_id(""), "0");
+}
+
+TEST(VidPidHelper, UsbId_And_FunctionTable) {
+  using UsbId = fs_tools::SysFSHelper::UsbId;
+  const auto ID = UsbId::parse("0x1A86", "007523");
+  ASSERT_TRUE(ID.has_value());
+  EXPECT_EQ(ID->m_vid, 0x1a86);
+  EXPECT_EQ(ID->m_pid, 0x7523);
+  EXPECT_EQ(ID->vid_string(), "1a86");
+  EXPECT_EQ((UsbId{0x67b, 0}.pid_string()), "0");
+  EXPECT_FALSE(UsbId::parse("1a86", "10000").has_value());
+  EXPECT_FALSE(UsbId::parse("xyz", "1").has_value());
+  EXPECT_EQ(std::hash<UsbId>{}(*ID), ID->key());
+
+  // два интерфейса одного устройства делят USB-узел и имя класса
+  std::vector<fs_tools::SysFSHelper::UsbFunction> funcs(3);
+  for (size_t i = 0; i < funcs.size(); ++i) {
+    auto& func = funcs[i];
+    func.m_id = *ID;
+    func.m_vid = ID->vid_string();
+    func.m_pid = ID->pid_string();
+    func.m_usbNode = i < 2 ? "/sys/devices/usb1/1-1/1-1:1.0"
+                           : "/sys/devices/usb1/1-1/1-1:1.1";
+    func.m_class_name = "tty";
+    func.m_dev_name = "ttyUSB" + std::to_string(i);
+    func.m_dev_path = "/dev/" + func.m_dev_name;
+  }
+  // строки — только вывод: сравнение и порядок идут по m_id
+  auto edited = funcs[2];
+  edited.m_pid = "6001";
+  EXPECT_EQ(edited, funcs[2]);
+  edited.m_id.m_pid = 0x6001;
+  EXPECT_FALSE(edited == funcs[2]);
+  EXPECT_LT(edited, funcs[2]);
+  EXPECT_LT(funcs[0], funcs[2]);
+  const fs_tools::FunctionTable TABLE(funcs);
+  ASSERT_EQ(TABLE.size(), 3u);
+  EXPECT_EQ(TABLE.pool().size(), 6u);  // 2 узла + класс + 3 имени
+  EXPECT_EQ(TABLE.row(0).m_usb_node, TABLE.row(1).m_usb_node);
+  const auto BACK = TABLE.functions();
+  for (size_t i = 0; i < funcs.size(); ++i) {
+    EXPECT_EQ(BACK[i].m_dev_path, funcs[i].m_dev_path);
+    EXPECT_EQ(BACK[i].m_usbNode, funcs[i].m_usbNode);
+    EXPECT_EQ(BACK[i].m_vid, funcs[i].m_vid);
+    EXPECT_EQ(BACK[i].m_id, funcs[i].m_id);
+  }
+
+  // копия пула не ссылается на память оригинала
+  auto copy = std::make_unique<fs_tools::FunctionTable>(TABLE);
+  const fs_tools::StringPool POOL = copy->pool();
+  copy.reset();
+  EXPECT_EQ(POOL.view(TABLE.row(2).m_dev_name), "ttyUSB2");
+  EXPECT_EQ(POOL.find("tty"), TABLE.row(0).m_class_name);
+}
+
+TEST(VidPidHelper, ReadAttr_And_DirHandle) {
+  const fs::path ROOT = fs::current_path() / "fake-attr";
+  fs::remove_all(ROOT);
+  write_all(ROOT / "uevent", "DEVNAME=ttyUSB0\n");
+  write_all(ROOT / "big", std::string(10000, 'x'));
+
+  std::string buf;
+  std::error_code error;
+  ASSERT_TRUE(fs_tools::read_attr((ROOT / "uevent").string(), buf, error));
+  EXPECT_FALSE(error);
+  EXPECT_EQ(buf, "DEVNAME=ttyUSB0\n");
+
+  // больше страницы — дочитывается целиком
+  ASSERT_TRUE(fs_tools::read_attr((ROOT / "big").string(), buf, error));
+  EXPECT_EQ(buf.size(), 10000u);
+
+  EXPECT_FALSE(fs_tools::read_attr((ROOT / "missing").string(), buf, error));
+  EXPECT_EQ(error, std::errc::no_such_file_or_directory);
+  EXPECT_TRUE(buf.empty());
+
+  EXPECT_FALSE(fs_tools::read_attr(ROOT.string(), buf, error));
+  EXPECT_EQ(error, std::errc::is_a_directory);
+
+  // те же операции относительно открытого каталога
+  fs::create_symlink("uevent", ROOT / "link");
+  const auto DIR = fs_tools::DirHandle::open(ROOT.string(), error);
+  ASSERT_TRUE(DIR.valid());
+  auto names = DIR.entries();
+  std::sort(names.begin(), names.end());
+  EXPECT_EQ(names, (std::vector<std::string>{"big", "link", "uevent"}));
+  ASSERT_TRUE(DIR.read_attr_at("link", buf, error));
+  EXPECT_EQ(buf, "DEVNAME=ttyUSB0\n");
+  EXPECT_EQ(DIR.readlink_at("link"), "uevent");
+  struct stat stt{};
+  ASSERT_TRUE(DIR.stat_at("link", stt));
+  EXPECT_TRUE(S_ISLNK(stt.st_mode));
+  ASSERT_TRUE(DIR.stat_at("link", stt, true));
+  EXPECT_TRUE(S_ISREG(stt.st_mode));
+  EXPECT_FALSE(DIR.open_at("uevent", error).valid());
+  EXPECT_EQ(error, std::errc::not_a_directory);
+
+  fs::remove_all(ROOT);
+}
+
+TEST(VidPidHelper, Glob_MatchesLikeFnmatch) {
+  using Kind = fs_tools::Glob::Kind;
+  EXPECT_EQ(fs_tools::Glob("*").kind(), Kind::ANY);
+  EXPECT_EQ(fs_tools::Glob("ttyUSB0").kind(), Kind::LITERAL);
+  EXPECT_EQ(fs_tools::Glob("ttyUSB*").kind(), Kind::PREFIX);
+  EXPECT_EQ(fs_tools::Glob("*.bin").kind(), Kind::SUFFIX);
+  EXPECT_EQ(fs_tools::Glob("file?.txt").kind(), Kind::GENERAL);
+  EXPECT_EQ(fs_tools::Glob("*a*").kind(), Kind::GENERAL);
+  EXPECT_EQ(fs_tools::Glob("a\\*").kind(), Kind::GENERAL);
+  EXPECT_EQ(fs_tools::Glob("tty*", FNM_CASEFOLD).kind(), Kind::GENERAL);
+  EXPECT_EQ(fs_tools::Glob("").kind(), Kind::NOTHING);
+
+  // быстрые пути обязаны отвечать так же, как fnmatch(3)
+  const std::vector<std::string> PATTERNS{
+      "*", "ttyUSB0", "ttyUSB*", "*.bin", "*USB0", "file?.txt", "[a-t]*",
+      "a\\*", "tty", "*/x", "a/*"};
+  const std::vector<std::string> NAMES{
+      "", "ttyUSB0", "ttyUSB", "ttyUSB12", "fw.bin", ".bin", "bin",
+      "file1.txt", "a*", "ab", "a/b", "tty/USB0", ".hidden", "x/x"};
+  for (const int FLAGS : {FNM_PATHNAME, 0}) {
+    for (const auto& pattern : PATTERNS) {
+      const fs_tools::Glob GLOB(pattern, FLAGS);
+      for (const auto& name : NAMES) {
+        EXPECT_EQ(GLOB.matches(name),
+                  ::fnmatch(pattern.c_str(), name.c_str(), FLAGS) == 0)
+            << pattern << " vs " << name << " flags " << FLAGS;
+      }
+    }
+  }
+  EXPECT_FALSE(fs_tools::Glob("").matches(""));
+
+  // один скомпилированный шаблон — на несколько листингов
+  const fs::path ROOT = fs::current_path() / "fake-glob";
+  fs::remove_all(ROOT);
+  for (const char* name : {"fw.bin", "boot.bin", "notes.txt"}) {
+    write_all(ROOT / name, "x");
+  }
+  const fs_tools::Glob BIN("*.bin");
+  for (int i = 0; i < 2; ++i) {
+    auto paths = fs_tools::list_dir_fs(ROOT.string(), BIN);
+    std::sort(paths.begin(), paths.end());
+    EXPECT_EQ(paths, (std::vector<std::string>{(ROOT / "boot.bin").string(),
+                                               (ROOT / "fw.bin").string()}));
+  }
+  EXPECT_EQ(fs_tools::list_dir_fs(ROOT.string()).size(), 3u);
+  EXPECT_TRUE(fs_tools::list_dir_fs(ROOT.string(), "").empty());
+
+  fs::remove_all(ROOT);
+}
+
+TEST(VidPidHelper, BatchReader_MatchesSyncReads) {
+  const fs::path ROOT = fs::current_path() / "fake-batch";
+  fs::remove_all(ROOT);
+  // больше одного пакета кольца, с длинным и отсутствующим файлом
+  constexpr size_t COUNT = 300;
+  for (size_t i = 0; i < COUNT; ++i) {
+    write_all(ROOT / std::to_string(i),
+              i == 7 ? std::string(9000, 'y') : "N=" + std::to_string(i));
+  }
+
+  std::error_code error;
+  const auto DIR = fs_tools::DirHandle::open(ROOT.string(), error);
+  ASSERT_TRUE(DIR.valid());
+  auto make_items = [&DIR] {
+    std::vector<fs_tools::BatchReader::Item> items(COUNT + 1);
+    for (size_t i = 0; i < items.size(); ++i) {
+      items[i].m_dirfd = DIR.fd();
+      items[i].m_name = std::to_string(i);  // последний не существует
+    }
+    return items;
+  };
+
+  // io_uring (если ядро даёт) и синхронный путь должны совпасть
+  for (const bool ALLOW_URING : {true, false}) {
+    fs_tools::BatchReader reader(ALLOW_URING);
+    if (!ALLOW_URING) {
+      EXPECT_FALSE(reader.uses_io_uring());
+    }
+    auto items = make_items();
+    EXPECT_EQ(reader.read_all(items), COUNT);
+    EXPECT_EQ(items[0].m_content, "N=0");
+    EXPECT_EQ(items[7].m_content.size(), 9000u);
+    EXPECT_EQ(items[COUNT - 1].m_content, "N=" + std::to_string(COUNT - 1));
+    EXPECT_EQ(items[COUNT].m_error, std::errc::no_such_file_or_directory);
+    EXPECT_TRUE(items[COUNT].m_content.empty());
+  }
+
+  fs::remove_all(ROOT);
+}
+
 TEST(VidPidHelper, FakeSysTree_ForwardAndReverse) {
   // создаём фейковое дерево прямо в каталоге выполнения теста
   const fs::path ROOT = fs::current_path() / "fake-sys";
@@ -80,6 +335,1141 @@ TEST(VidPidHelper, FakeSysTree_ForwardAndReverse) {
   fs::remove_all(ROOT);
 }
 
+TEST(VidPidHelper, FakeSysTree_FindByDevNode) {
+  const fs::path ROOT = fs::current_path() / "fake-sys-find";
+  const auto CLASS_ROOTS = make_acm_tree(ROOT);
+  const fs::path SYS_USB = ROOT / "sys/bus/usb/devices";
+
+  // /dev/ttyACM0 здесь может не существовать — тогда find() уходит в
+  // линейный поиск по переданным корням
+  const auto FUNS =
+      fs_tools::SysFSHelper::list_functions(SYS_USB.string(), CLASS_ROOTS);
+  ASSERT_EQ(FUNS.size(), 2u);
+  EXPECT_EQ(FUNS[0].m_dev_path, "/dev/hidraw0");
+  EXPECT_EQ(FUNS[0].m_class_name, "hidraw");
+  EXPECT_EQ(FUNS[1].m_dev_path, "/dev/ttyACM0");
+  EXPECT_EQ(FUNS[1].m_class_name, "tty");
+  for (const auto& func : FUNS) {
+    EXPECT_EQ(func.m_vid, "67b");
+    EXPECT_EQ(func.m_pid, "2303");
+  }
+
+  const auto BACK = fs_tools::SysFSHelper::find("/dev/ttyACM0", CLASS_ROOTS);
+  ASSERT_TRUE(BACK.has_value());
+  EXPECT_EQ(BACK->m_vid, "67b");
+  EXPECT_EQ(BACK->m_pid, "2303");
+  EXPECT_EQ(BACK->m_class_name, "tty");
+  EXPECT_EQ(BACK->m_dev_name, "ttyACM0");
+
+  EXPECT_FALSE(
+      fs_tools::SysFSHelper::find("ttyACM9", CLASS_ROOTS).has_value());
+
+  // корень USB ограничивает результат устройствами в нём; пустой — нет
+  const fs::path OTHER_USB = ROOT / "other-usb";
+  fs::create_directories(OTHER_USB);
+  EXPECT_TRUE(fs_tools::SysFSHelper::list_functions(OTHER_USB.string(),
+                                                    CLASS_ROOTS)
+                  .empty());
+  EXPECT_EQ(fs_tools::SysFSHelper::list_functions({}, CLASS_ROOTS).size(),
+            FUNS.size());
+  // несуществующий корень USB — без отбора, а не пустой список
+  EXPECT_EQ(fs_tools::SysFSHelper::list_functions(
+                (ROOT / "missing-usb").string(), CLASS_ROOTS)
+                .size(),
+            FUNS.size());
+
+  fs::remove_all(ROOT);
+}
+
+TEST(VidPidHelper, FakeSysTree_ParallelListing) {
+  const fs::path ROOT = fs::current_path() / "fake-sys-parallel";
+  const auto CLASS_ROOTS = make_acm_tree(ROOT);
+  const fs::path SYS_USB = ROOT / "sys/bus/usb/devices";
+
+  const auto FUNS =
+      fs_tools::SysFSHelper::list_functions(SYS_USB.string(), CLASS_ROOTS);
+  ASSERT_EQ(FUNS.size(), 2u);
+
+  // параллельный режим даёт тот же результат и порядок
+  for (const size_t THREADS : {0u, 1u, 4u}) {
+    const auto PAR = fs_tools::SysFSHelper::list_functions(
+        fs_tools::SysFSHelper::ParallelOptions{THREADS}, SYS_USB.string(),
+        CLASS_ROOTS);
+    ASSERT_EQ(PAR.size(), FUNS.size());
+    for (size_t i = 0; i < PAR.size(); ++i) {
+      EXPECT_EQ(PAR[i].m_dev_path, FUNS[i].m_dev_path);
+      EXPECT_EQ(PAR[i].m_usbNode, FUNS[i].m_usbNode);
+    }
+  }
+
+  fs::remove_all(ROOT);
+}
+
+TEST(VidPidHelper, FakeSysTree_WaitFor) {
+  const fs::path ROOT = fs::current_path() / "fake-sys-wait";
+  const auto CLASS_ROOTS = make_acm_tree(ROOT);
+  const fs::path SYS_TTY = CLASS_ROOTS[0];
+
+  // уже присутствующее устройство возвращается сразу, отсутствующее — по
+  // таймауту; ищется только в переданных корнях
+  const auto PRESENT = fs_tools::SysFSHelper::wait_for(
+      [](const auto& func) { return func.m_dev_name == "ttyACM0"; },
+      std::chrono::seconds(5), CLASS_ROOTS);
+  ASSERT_TRUE(PRESENT.has_value());
+  EXPECT_EQ(PRESENT->m_pid, "2303");
+
+  const auto START = std::chrono::steady_clock::now();
+  EXPECT_FALSE(fs_tools::SysFSHelper::wait_for(
+                   [](const auto& func) { return func.m_vid == "dead"; },
+                   std::chrono::milliseconds(50), CLASS_ROOTS)
+                   .has_value());
+  EXPECT_GE(std::chrono::steady_clock::now() - START,
+            std::chrono::milliseconds(50));
+
+  // неразборные идентификаторы не совпадут ни с чем — без ожидания
+  const auto BAD = std::chrono::steady_clock::now();
+  EXPECT_FALSE(fs_tools::SysFSHelper::wait_for("zz", "1",
+                                               std::chrono::seconds(10))
+                   .has_value());
+  EXPECT_LT(std::chrono::steady_clock::now() - BAD, std::chrono::seconds(5));
+
+  // появление во время ожидания: будит событие, а не таймаут
+  std::array<int, 2> fds{};
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_DGRAM, 0, fds.data()), 0);
+  std::thread plug([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    // как у ядра: устройство под /devices, в классе — ссылка на него
+    const fs::path DEV = ROOT / "sys/devices/fake/1-1:1.0/tty/ttyACM1";
+    write_all(DEV / "uevent", "DEVNAME=ttyACM1\n");
+    fs::create_symlink(
+        weakly_canonical_compat(ROOT / "sys/bus/usb/devices/1-1/1-1:1.0"),
+        DEV / "device");
+    fs::create_symlink(weakly_canonical_compat(DEV), SYS_TTY / "ttyACM1");
+    using namespace std::string_literals;
+    // DEVPATH относительно ROOT/sys — корня sysfs переданных корней классов
+    const auto MSG =
+        "add@/devices/fake/1-1:1.0/tty/ttyACM1\0ACTION=add\0"
+        "DEVPATH=/devices/fake/1-1:1.0/tty/ttyACM1\0SUBSYSTEM=tty\0"
+        "DEVNAME=ttyACM1\0"s;
+    ::send(fds[1], MSG.data(), MSG.size(), 0);
+  });
+  const auto WAKE = std::chrono::steady_clock::now();
+  const auto PLUGGED = fs_tools::SysFSHelper::wait_for(
+      fds[0], [](const auto& func) { return func.m_dev_name == "ttyACM1"; },
+      std::chrono::seconds(10), CLASS_ROOTS);
+  plug.join();
+  ASSERT_TRUE(PLUGGED.has_value());
+  EXPECT_EQ(PLUGGED->m_class_name, "tty");
+  EXPECT_EQ(PLUGGED->m_pid, "2303");
+  EXPECT_LT(std::chrono::steady_clock::now() - WAKE, std::chrono::seconds(5));
+
+  ::close(fds[0]);
+  ::close(fds[1]);
+  fs::remove_all(ROOT);
+}
+
+TEST(VidPidHelper, FindByRdev_DefinitiveMiss) {
+  // /dev/null разрешается через /sys/dev, но это класс mem: в стандартных
+  // корнях его нет, и линейный скан не нужен
+  struct stat stt{};
+  if (::stat("/dev/null", &stt) != 0 || !S_ISCHR(stt.st_mode) ||
+      !fs::exists("/sys/dev/char/" + std::to_string(major(stt.st_rdev)) +
+                  ":" + std::to_string(minor(stt.st_rdev)))) {
+    GTEST_SKIP() << "no /dev/null in /sys/dev";
+  }
+
+  fs_tools::EnumStats stats;
+  {
+    const fs_tools::EnumStats::Scope SCOPE(&stats);
+    EXPECT_FALSE(fs_tools::SysFSHelper::find("/dev/null").has_value());
+    const auto MANY = fs_tools::SysFSHelper::find_many({"/dev/null"});
+    ASSERT_EQ(MANY.size(), 1u);
+    EXPECT_FALSE(MANY[0].m_function);
+    EXPECT_EQ(MANY[0].m_error, std::errc::no_such_device);
+  }
+  if (fs_tools::EnumStats::ENABLED) {
+    EXPECT_EQ(stats.m_dirs_opened, 0u);
+  }
+
+  // нестандартный корень: решает линейный поиск
+  const fs::path CUSTOM = fs::current_path() / "fake-custom-class";
+  fs::create_directories(CUSTOM);
+  fs_tools::EnumStats custom;
+  {
+    const fs_tools::EnumStats::Scope SCOPE(&custom);
+    EXPECT_FALSE(
+        fs_tools::SysFSHelper::find("/dev/null", {CUSTOM.string()}));
+  }
+  if (fs_tools::EnumStats::ENABLED) {
+    EXPECT_EQ(custom.m_dirs_opened, 1u);
+  }
+  fs::remove_all(CUSTOM);
+
+  // "/sys/class/mem/" — тот же корень, что "/sys/class/mem": промах
+  // окончательный и без скана
+  for (const std::string ROOT : {"/sys/class/mem/", "/sys/class/mem//"}) {
+    fs_tools::EnumStats slashed;
+    {
+      const fs_tools::EnumStats::Scope SCOPE(&slashed);
+      const auto MANY = fs_tools::SysFSHelper::find_many({"null"}, {ROOT});
+      ASSERT_EQ(MANY.size(), 1u);
+      EXPECT_EQ(MANY[0].m_error, std::errc::no_such_device) << ROOT;
+    }
+    if (fs_tools::EnumStats::ENABLED) {
+      EXPECT_EQ(slashed.m_dirs_opened, 0u) << ROOT;
+    }
+  }
+  // класс mem, но корень не вида /sys/class/<name>: решает скан
+  fs_tools::EnumStats odd;
+  {
+    const fs_tools::EnumStats::Scope SCOPE(&odd);
+    EXPECT_FALSE(
+        fs_tools::SysFSHelper::find("null", {"/sys/class/tty/../mem"}));
+  }
+  if (fs_tools::EnumStats::ENABLED) {
+    EXPECT_EQ(odd.m_dirs_opened, 1u);
+  }
+}
+
+TEST(VidPidHelper, FakeSysTree_Generated) {
+  // 20 устройств × 3 функции за двумя хабами, относительные симлинки
+  const fs_tools::testing::FakeSysfs TREE(fs::current_path() / "fake-gen",
+                                          {20, 3});
+  const auto ROOTS = TREE.class_roots();
+
+  auto expected = TREE.functions();
+  std::sort(expected.begin(), expected.end(),
+            [](const auto& first, const auto& second) {
+              return first.m_dev_name < second.m_dev_name;
+            });
+  const auto FUNS =
+      fs_tools::SysFSHelper::list_functions(TREE.usb_root(), ROOTS);
+  ASSERT_EQ(FUNS.size(), expected.size());
+  for (size_t i = 0; i < FUNS.size(); ++i) {
+    EXPECT_EQ(FUNS[i].m_dev_name, expected[i].m_dev_name);
+    EXPECT_EQ(FUNS[i].m_class_name, expected[i].m_class_name);
+    EXPECT_EQ(FUNS[i].m_vid, expected[i].m_vid);
+    EXPECT_EQ(FUNS[i].m_pid, expected[i].m_pid);
+    EXPECT_EQ(FUNS[i].m_usbNode, expected[i].m_usb_node);
+  }
+
+  const auto BACK = fs_tools::SysFSHelper::find("hidraw5", ROOTS);
+  ASSERT_TRUE(BACK.has_value());
+  EXPECT_EQ(BACK->m_pid, "7005");
+  EXPECT_EQ(fs_tools::SysFSHelper::find_by_id("0x1A86", "7003", ROOTS).size(),
+            3u);
+  EXPECT_EQ(fs_tools::SysFSHelper::list_ids(TREE.usb_root()), TREE.ids());
+
+  // потоковый обход: ранний выход и дедупликация по хешу
+  size_t seen = 0;
+  EXPECT_EQ(fs_tools::SysFSHelper::for_each_function(
+                [&seen](const auto&) { return ++seen < 5; }, ROOTS),
+            5u);
+  auto twice = ROOTS;
+  twice.insert(twice.end(), ROOTS.begin(), ROOTS.end());
+  const auto COUNT_ALL = [](const auto&) { return true; };
+  EXPECT_EQ(fs_tools::SysFSHelper::for_each_function(COUNT_ALL, twice), 60u);
+  EXPECT_EQ(
+      fs_tools::SysFSHelper::for_each_function(COUNT_ALL, twice, false), 120u);
+  const auto FIRST =
+      fs_tools::SysFSHelper::find_first_by_id("1a86", "0x7003", ROOTS);
+  ASSERT_TRUE(FIRST.has_value());
+  EXPECT_EQ(FIRST->m_pid, "7003");
+  EXPECT_FALSE(
+      fs_tools::SysFSHelper::find_first_by_id("1a86", "6fff", ROOTS));
+}
+
+TEST(VidPidHelper, MemoryBackend_MatchesDisk) {
+  fs_tools::MemoryBackend mem;
+  ASSERT_TRUE(mem.add_file("/a/b/file", "data\n"));
+  ASSERT_TRUE(mem.add_symlink("/a/link", "b/file"));
+  ASSERT_TRUE(mem.add_symlink("/a/up", "../a/b"));
+  ASSERT_TRUE(mem.add_symlink("/a/loop", "loop"));
+  EXPECT_FALSE(mem.add_symlink("/a/link", "b"));
+  EXPECT_FALSE(mem.add_dir("/a/b/file/sub"));
+
+  std::string buf;
+  std::error_code error;
+  ASSERT_TRUE(mem.read_attr("/a/link", buf, error));
+  EXPECT_EQ(buf, "data\n");
+  ASSERT_TRUE(mem.readlink("/a/link", buf, error));
+  EXPECT_EQ(buf, "b/file");
+  EXPECT_EQ(mem.realpath("/a/up/./file", error), "/a/b/file");
+  EXPECT_EQ(mem.realpath("/a/up/..", error), "/a");
+  EXPECT_TRUE(mem.realpath("/a/loop", error).empty());
+  EXPECT_EQ(error, std::errc::too_many_symbolic_link_levels);
+  EXPECT_FALSE(mem.read_attr("/a/missing", buf, error));
+  EXPECT_EQ(error, std::errc::no_such_file_or_directory);
+  EXPECT_FALSE(mem.read_attr("/a/b", buf, error));
+  EXPECT_EQ(error, std::errc::is_a_directory);
+  EXPECT_TRUE(mem.realpath("/a/b/file/x", error).empty());
+  EXPECT_EQ(error, std::errc::not_a_directory);
+  fs_tools::FsBackend::Stat stt;
+  ASSERT_TRUE(mem.stat("/a/link", stt, false, error));
+  EXPECT_EQ(stt.m_type, DT_LNK);
+  ASSERT_TRUE(mem.stat("/a/link", stt, true, error));
+  EXPECT_EQ(stt.m_type, DT_REG);
+  EXPECT_EQ(stt.m_size, 5u);
+  std::vector<fs_tools::DirEntry> entries;
+  ASSERT_TRUE(mem.list("/a", entries, error));
+  ASSERT_EQ(entries.size(), 4u);
+  EXPECT_EQ(entries[0].m_name, "b");
+  EXPECT_TRUE(entries[0].is_dir());
+  EXPECT_TRUE(entries[1].is_symlink());
+
+  // одно и то же дерево на диске и в памяти — одинаковый результат
+  const fs_tools::testing::FakeSysfsOptions OPTIONS{12, 3};
+  const fs_tools::testing::FakeSysfs DISK(fs::current_path() / "fake-mem",
+                                          OPTIONS);
+  fs_tools::MemoryBackend tree;
+  const fs_tools::testing::FakeSysfs MEM(tree, OPTIONS);
+  EXPECT_EQ(MEM.usb_root(), "/sys/bus/usb/devices");
+
+  const auto FROM_DISK = fs_tools::SysFSHelper::list_functions(
+      DISK.usb_root(), DISK.class_roots());
+  const auto FROM_MEM = fs_tools::SysFSHelper::list_functions(
+      tree, MEM.usb_root(), MEM.class_roots());
+  ASSERT_EQ(FROM_MEM.size(), 36u);
+  ASSERT_EQ(FROM_MEM.size(), FROM_DISK.size());
+  for (size_t i = 0; i < FROM_MEM.size(); ++i) {
+    EXPECT_EQ(FROM_MEM[i].m_dev_path, FROM_DISK[i].m_dev_path);
+    EXPECT_EQ(FROM_MEM[i].m_id, FROM_DISK[i].m_id);
+    EXPECT_EQ(FROM_MEM[i].m_class_name, FROM_DISK[i].m_class_name);
+    // путь интерфейса — тот же, только без корня временного каталога
+    EXPECT_EQ(DISK.root().string() + FROM_MEM[i].m_usbNode,
+              FROM_DISK[i].m_usbNode);
+  }
+  EXPECT_EQ(fs_tools::SysFSHelper::list_ids(tree, MEM.usb_root()), MEM.ids());
+
+  // POSIX-бэкенд — обычный путь через дескрипторы
+  const auto& posix = fs_tools::FsBackend::posix();
+  EXPECT_EQ(fs_tools::SysFSHelper::list_functions(posix, DISK.usb_root(),
+                                                  DISK.class_roots())
+                .size(),
+            FROM_DISK.size());
+  EXPECT_EQ(fs_tools::SysFSHelper::list_ids(posix, DISK.usb_root()),
+            DISK.ids());
+  ASSERT_TRUE(posix.list(DISK.usb_root(), entries, error));
+  // usb1 и 2 хаба со своими интерфейсами, 12 устройств × (1 + 3)
+  EXPECT_EQ(entries.size(), (1 + 2) * 2 + 12 * 4u);
+
+  // крупное дерево целиком в памяти
+  fs_tools::MemoryBackend big;
+  const fs_tools::testing::FakeSysfs BIG(big, {2000, 4});
+  EXPECT_GT(big.size(), 50000u);
+  EXPECT_EQ(fs_tools::SysFSHelper::list_functions(big, BIG.usb_root(),
+                                                  BIG.class_roots())
+                .size(),
+            8000u);
+}
+
+TEST(VidPidHelper, PathResolver_MatchesRealpath) {
+  const fs_tools::testing::FakeSysfs TREE(fs::current_path() / "fake-paths",
+                                          {6, 3});
+  fs_tools::PathResolver resolver;
+  std::error_code error;
+  std::string out;
+  size_t links = 0;
+  for (const auto& root : TREE.class_roots()) {
+    for (const auto& entry : fs_tools::list_dirs(root)) {
+      const auto LINK = entry + "/device";
+      const auto EXPECTED = fs_tools::canonical_path(LINK, error);
+      ASSERT_TRUE(resolver.resolve(LINK, out, error)) << LINK;
+      EXPECT_EQ(out, EXPECTED);
+      ++links;
+    }
+  }
+  EXPECT_EQ(links, 18u);
+
+  // общие префиксы уже в кэше: повтор и собственный результат — без промахов
+  const auto CACHED = resolver.size();
+  const auto LINK = TREE.class_roots().front() + "/ttyUSB1/device/../..";
+  EXPECT_EQ(resolver.resolve(LINK, error),
+            fs_tools::canonical_path(LINK, error));
+  const auto CANONICAL = resolver.resolve(LINK, error);
+  EXPECT_EQ(resolver.resolve(CANONICAL, error), CANONICAL);
+  EXPECT_EQ(resolver.size(), CACHED);
+
+  EXPECT_FALSE(resolver.resolve(TREE.usb_root() + "/nosuch", out, error));
+  EXPECT_EQ(error, std::errc::no_such_file_or_directory);
+  EXPECT_TRUE(out.empty());
+
+  // поверх MemoryBackend — те же ответы, что его realpath
+  fs_tools::MemoryBackend mem;
+  const fs_tools::testing::FakeSysfs MEM(mem, {3, 2});
+  ASSERT_TRUE(mem.add_symlink("/loop", "/loop"));
+  ASSERT_TRUE(mem.add_symlink("/root", "/"));
+  fs_tools::PathResolver in_memory(mem);
+  for (const auto& func : MEM.functions()) {
+    const auto LINK = "/sys/class/" + func.m_class_name + "/" +
+                      func.m_dev_name + "/device";
+    const auto EXPECTED = mem.realpath(LINK, error);
+    EXPECT_EQ(EXPECTED.rfind(func.m_usb_node + "/", 0), 0u) << EXPECTED;
+    EXPECT_EQ(in_memory.resolve(LINK, error), EXPECTED);
+  }
+  EXPECT_EQ(in_memory.resolve("/root/sys/../root", error), "/");
+  EXPECT_TRUE(in_memory.resolve("/loop", error).empty());
+  EXPECT_EQ(error, std::errc::too_many_symbolic_link_levels);
+}
+
+TEST(VidPidHelper, FakeSysTree_FindMany) {
+  const fs_tools::testing::FakeSysfs TREE(fs::current_path() / "fake-many",
+                                          {6, 3});
+  const auto ROOTS = TREE.class_roots();
+
+  // порядок входа, повтор, "/dev/"-префикс, отсутствующий и пустой узел
+  const std::vector<std::string> NODES{"video1", "/dev/ttyUSB0", "nosuch0",
+                                       "hidraw4", "", "ttyUSB0"};
+  const auto RESULTS = fs_tools::SysFSHelper::find_many(NODES, ROOTS);
+  ASSERT_EQ(RESULTS.size(), NODES.size());
+  for (const size_t INDEX : {0u, 1u, 3u, 5u}) {
+    ASSERT_TRUE(RESULTS[INDEX].m_function.has_value()) << NODES[INDEX];
+    EXPECT_FALSE(RESULTS[INDEX].m_error);
+    const auto SINGLE = fs_tools::SysFSHelper::find(NODES[INDEX], ROOTS);
+    ASSERT_TRUE(SINGLE.has_value());
+    EXPECT_EQ(RESULTS[INDEX].m_function->m_dev_path, SINGLE->m_dev_path);
+    EXPECT_EQ(RESULTS[INDEX].m_function->m_usbNode, SINGLE->m_usbNode);
+    EXPECT_EQ(RESULTS[INDEX].m_function->m_id, SINGLE->m_id);
+  }
+  EXPECT_EQ(RESULTS[0].m_function->m_pid, "7001");
+  EXPECT_EQ(RESULTS[3].m_function->m_pid, "7004");
+  EXPECT_EQ(RESULTS[1].m_function->m_dev_path, "/dev/ttyUSB0");
+  EXPECT_FALSE(RESULTS[2].m_function);
+  EXPECT_EQ(RESULTS[2].m_error, std::errc::no_such_device);
+  EXPECT_FALSE(RESULTS[4].m_function);
+  EXPECT_EQ(RESULTS[4].m_error, std::errc::invalid_argument);
+  EXPECT_TRUE(fs_tools::SysFSHelper::find_many({}, ROOTS).empty());
+}
+
+TEST(VidPidHelper, FakeSysTree_UsbDeviceAttributes) {
+  // три одинаковых адаптера 1a86:7000, различимых только серийником
+  fs_tools::testing::FakeSysfsOptions options;
+  options.m_devices = 3;
+  options.m_identical = true;
+  const fs_tools::testing::FakeSysfs TREE(fs::current_path() / "fake-attrs",
+                                          options);
+  const auto ROOTS = TREE.class_roots();
+  ASSERT_EQ(fs_tools::SysFSHelper::find_by_id("1a86", "7000", ROOTS).size(),
+            6u);
+
+  const auto FUNCS =
+      fs_tools::SysFSHelper::find_by_serial("1a86", "7000", "SN1", ROOTS);
+  ASSERT_EQ(FUNCS.size(), 2u);
+  for (const auto& func : FUNCS) {
+    const fs_tools::UsbDevice DEVICE(func);
+    EXPECT_EQ(fs::path(func.m_usbNode).parent_path().string(), DEVICE.path());
+    EXPECT_EQ(DEVICE.serial(), "SN1");
+  }
+  EXPECT_TRUE(
+      fs_tools::SysFSHelper::find_by_serial("1a86", "7000", "SN9", ROOTS)
+          .empty());
+  EXPECT_TRUE(
+      fs_tools::SysFSHelper::find_by_serial("1a86", "7001", "SN1", ROOTS)
+          .empty());
+
+  // ленивость: ничего не читается до первого обращения, затем всё из кеша
+  const fs_tools::UsbDevice DEVICE(FUNCS.front());
+  DEVICE.load(fs_tools::UsbDevice::BUSNUM | fs_tools::UsbDevice::DEVNUM |
+              fs_tools::UsbDevice::DEVPATH);
+  EXPECT_EQ(DEVICE.busnum(), 1u);
+  EXPECT_TRUE(DEVICE.devnum().has_value());
+  EXPECT_EQ(DEVICE.devpath(), "1.1.2");
+  fs::remove(fs::path(DEVICE.path()) / "speed");
+  EXPECT_FALSE(DEVICE.speed().has_value());
+  fs::remove(fs::path(DEVICE.path()) / "devpath");
+  EXPECT_EQ(DEVICE.devpath(), "1.1.2");
+
+  // корневой хаб: узел — само устройство, серийника нет
+  const fs_tools::UsbDevice HUB(
+      (TREE.root() / "sys/devices/pci0000:00/0000:00:14.0/usb1").string());
+  EXPECT_EQ(HUB.devpath(), "0");
+  EXPECT_FALSE(HUB.serial().has_value());
+}
+
+TEST(VidPidHelper, FakeSysTree_UsbNodeBelowInterface) {
+  const fs::path ROOT = fs::current_path() / "fake-sys-nested";
+  fs::remove_all(ROOT);
+
+  // как в настоящем sysfs: device у ttyUSB ведёт на порт usb-serial, у
+  // hidraw — на HID-устройство; оба лежат под интерфейсом
+  const fs::path DEV = ROOT / "sys/devices/pci0000:00/usb1/1-1";
+  const fs::path SERIAL_IF = DEV / "1-1:1.0";
+  const fs::path HID_IF = DEV / "1-1:1.1";
+  const fs::path PORT = SERIAL_IF / "ttyUSB0";
+  const fs::path HID = HID_IF / "0003:1A86:7523.0001";
+  write_all(DEV / "uevent", "DEVTYPE=usb_device\nPRODUCT=1a86/7523/264\n");
+  write_all(DEV / "serial", "A1\n");
+  write_all(DEV / "busnum", "1\n");
+  for (const auto& iface : {SERIAL_IF, HID_IF}) {
+    write_all(iface / "uevent",
+              "DEVTYPE=usb_interface\nPRODUCT=1a86/7523/264\n");
+  }
+  write_all(PORT / "uevent", "DRIVER=ch341-uart\n");
+  write_all(PORT / "tty/ttyUSB0/uevent", "MAJOR=188\nDEVNAME=ttyUSB0\n");
+  fs::create_symlink("../..", PORT / "tty/ttyUSB0/device");
+  write_all(HID / "uevent", "DRIVER=hid-generic\nHID_ID=0003:1A86:7523\n");
+  write_all(HID / "hidraw/hidraw0/uevent", "MAJOR=240\nDEVNAME=hidraw0\n");
+  fs::create_symlink("../..", HID / "hidraw/hidraw0/device");
+
+  const fs::path SYS_TTY = ROOT / "sys/class/tty";
+  const fs::path SYS_HID = ROOT / "sys/class/hidraw";
+  fs::create_directories(SYS_TTY);
+  fs::create_directories(SYS_HID);
+  fs::create_symlink(PORT / "tty/ttyUSB0", SYS_TTY / "ttyUSB0");
+  fs::create_symlink(HID / "hidraw/hidraw0", SYS_HID / "hidraw0");
+  const std::vector<std::string> ROOTS = {SYS_TTY.string(), SYS_HID.string()};
+
+  const auto FUNCS = fs_tools::SysFSHelper::list_functions({}, ROOTS);
+  ASSERT_EQ(FUNCS.size(), 2u);
+  EXPECT_EQ(FUNCS[0].m_dev_name, "hidraw0");
+  EXPECT_EQ(FUNCS[0].m_usbNode, fs::canonical(HID_IF).string());
+  EXPECT_EQ(FUNCS[1].m_dev_name, "ttyUSB0");
+  EXPECT_EQ(FUNCS[1].m_usbNode, fs::canonical(SERIAL_IF).string());
+  for (const auto& func : FUNCS) {
+    const fs_tools::UsbDevice DEVICE(func);
+    EXPECT_EQ(DEVICE.path(), fs::canonical(DEV).string());
+    EXPECT_EQ(DEVICE.serial(), "A1");
+    EXPECT_EQ(DEVICE.busnum(), 1u);
+  }
+  EXPECT_EQ(fs_tools::SysFSHelper::find("ttyUSB0", ROOTS)->m_usbNode,
+            FUNCS[1].m_usbNode);
+  EXPECT_EQ(
+      fs_tools::SysFSHelper::find_by_serial("1a86", "7523", "A1", ROOTS).size(),
+      2u);
+
+  fs::remove_all(ROOT);
+}
+
+TEST(VidPidHelper, FakeSysTree_UsbQuery) {
+  // 12 устройств × 3 функции: tty, hidraw, video4linux по кругу
+  const fs_tools::testing::FakeSysfs TREE(fs::current_path() / "fake-query",
+                                          {12, 3});
+  const auto ROOTS = TREE.class_roots();
+  using fs_tools::UsbQuery;
+  using UsbId = fs_tools::SysFSHelper::UsbId;
+
+  EXPECT_EQ(UsbQuery().run(ROOTS).size(), 36u);
+  EXPECT_EQ(UsbQuery().run(ROOTS).size(),
+            fs_tools::SysFSHelper::list_functions({}, ROOTS).size());
+  EXPECT_EQ(UsbQuery().class_name("tty").run(ROOTS).size(), 12u);
+  EXPECT_EQ(
+      UsbQuery().class_name("tty").class_name("hidraw").run(ROOTS).size(),
+      24u);
+  // корень класса с завершающим '/': имя класса то же, что и без него
+  const std::vector<std::string> SLASHED{ROOTS[0] + "/", ROOTS[1] + "//"};
+  const auto SLASHED_TTY = UsbQuery().class_name("tty").run(SLASHED);
+  ASSERT_EQ(SLASHED_TTY.size(), 12u);
+  for (const auto& func : SLASHED_TTY) {
+    EXPECT_EQ(func.m_class_name, "tty");
+    EXPECT_TRUE(UsbQuery().class_name("tty").matches(func));
+  }
+  EXPECT_EQ(UsbQuery().class_name("hidraw").run(SLASHED).size(), 12u);
+
+  // устройства 1-1.1.1 ... 1-1.1.12; "1-1.1.?" — только первые девять
+  const auto PORTED =
+      UsbQuery().class_name("tty").vendor(0x1a86).port("1-1.1.?").run(ROOTS);
+  ASSERT_EQ(PORTED.size(), 9u);
+  for (const auto& func : PORTED) {
+    EXPECT_EQ(func.m_class_name, "tty");
+  }
+
+  EXPECT_EQ(UsbQuery().id(UsbId{0x1a86, 0x7003}).run(ROOTS).size(), 3u);
+  EXPECT_EQ(UsbQuery()
+                .ids({UsbId{0x1a86, 0x7003}, UsbId{0x1a86, 0x7005}})
+                .run(ROOTS)
+                .size(),
+            6u);
+  // диапазон 7008–700f по маске: устройства 8..11
+  EXPECT_EQ(UsbQuery()
+                .id_mask(UsbId{0x1a86, 0x7008}, UsbId{0xffff, 0xfff8})
+                .class_name("hidraw")
+                .run(ROOTS)
+                .size(),
+            4u);
+  EXPECT_TRUE(UsbQuery().vendor(0x0403).run(ROOTS).empty());
+
+  // драйвер интерфейса, а не порта (ch341-uart) или HID (hid-generic)
+  EXPECT_EQ(UsbQuery().driver("usbhid").run(ROOTS).size(), 12u);
+  EXPECT_EQ(UsbQuery().driver("ch341").class_name("tty").run(ROOTS).size(),
+            12u);
+  EXPECT_TRUE(UsbQuery().driver("ch341-uart").run(ROOTS).empty());
+  EXPECT_TRUE(UsbQuery().driver("hid-generic").run(ROOTS).empty());
+  // порт — имя USB-устройства, а не интерфейса или каталога под ним
+  EXPECT_EQ(UsbQuery().port("1-1.1.3").run(ROOTS).size(), 3u);
+  EXPECT_TRUE(UsbQuery().port("1-1.1.3:*").run(ROOTS).empty());
+  EXPECT_EQ(UsbQuery().dev_name("video1?").run(ROOTS).size(), 2u);
+  const auto CUSTOM = UsbQuery()
+                          .class_name("tty")
+                          .where([](const auto& func) {
+                            return func.m_dev_name == "ttyUSB4";
+                          })
+                          .run(ROOTS);
+  ASSERT_EQ(CUSTOM.size(), 1u);
+  EXPECT_EQ(CUSTOM[0].m_pid, "7004");
+
+  // matches() на готовых функциях совпадает со сканом
+  const auto QUERY = UsbQuery().class_name("hidraw").dev_name("hidraw1*");
+  size_t matched = 0;
+  for (const auto& func : fs_tools::SysFSHelper::list_functions({}, ROOTS)) {
+    matched += QUERY.matches(func) ? 1 : 0;
+  }
+  EXPECT_EQ(matched, QUERY.run(ROOTS).size());
+  EXPECT_EQ(matched, 3u);
+
+  // for_each отбирает то же, что run(), и останавливается по false
+  size_t streamed = 0;
+  EXPECT_EQ(QUERY.for_each(
+                [&](const auto& func) {
+                  EXPECT_TRUE(QUERY.matches(func));
+                  return ++streamed < 2;
+                },
+                ROOTS),
+            2u);
+  EXPECT_EQ(QUERY.for_each([](const auto&) { return true; }, ROOTS), 3u);
+
+  // отсев по имени узла не разыменовывает device-ссылки остальных 35
+  fs_tools::EnumStats all;
+  {
+    const fs_tools::EnumStats::Scope SCOPE(&all);
+    EXPECT_EQ(UsbQuery().run(ROOTS).size(), 36u);
+  }
+  fs_tools::EnumStats by_name;
+  {
+    const fs_tools::EnumStats::Scope SCOPE(&by_name);
+    EXPECT_EQ(UsbQuery().dev_name("ttyUSB0").run(ROOTS).size(), 1u);
+  }
+  fs_tools::EnumStats by_class;
+  {
+    const fs_tools::EnumStats::Scope SCOPE(&by_class);
+    EXPECT_EQ(UsbQuery().class_name("tty").run(ROOTS).size(), 12u);
+  }
+  if (fs_tools::EnumStats::ENABLED) {
+    EXPECT_EQ(by_name.m_realpath_calls, all.m_realpath_calls / 36);
+    EXPECT_EQ(by_name.m_dirs_opened, 3u);
+    EXPECT_EQ(by_class.m_dirs_opened, 1u);
+  }
+}
+
+TEST(VidPidHelper, FakeSysTree_UsbTopology) {
+  // usb1 → 1-1 → 1-1.1 → 1-1.1.{1..11} → интерфейсы → функции; у корневого
+  // хаба и хабов — свои интерфейсы 1-0:1.0, 1-1:1.0, 1-1.1:1.0
+  const fs_tools::testing::FakeSysfs TREE(fs::current_path() / "fake-topo",
+                                          {11, 2});
+  using Topology = fs_tools::UsbTopology;
+  using Kind = Topology::Kind;
+  const auto TOPO = Topology::build(TREE.usb_root(), TREE.class_roots());
+  // (1 + 2 хаба) × (1 + интерфейс) + 11 устройств × (1 + 2 интерфейса +
+  // 2 функции)
+  ASSERT_EQ(TOPO.size(), 3u * 2u + 11u * 5u);
+  ASSERT_EQ(TOPO.functions().size(), 22u);
+
+  const auto ROOT = TOPO.first_root();
+  ASSERT_NE(ROOT, Topology::NONE);
+  EXPECT_EQ(TOPO.name(ROOT), "usb1");
+  EXPECT_EQ(TOPO.node(ROOT).m_kind, Kind::CONTROLLER);
+  EXPECT_EQ(TOPO.node(ROOT).m_end, TOPO.size());
+  EXPECT_EQ(TOPO.next_sibling(ROOT), Topology::NONE);
+  EXPECT_EQ(TOPO.functions_under(ROOT).size(), 22u);
+  // "1-0:1.0" — интерфейс usb1, а не отдельный корень
+  const auto ROOT_IFACE = TOPO.find("1-0:1.0");
+  ASSERT_NE(ROOT_IFACE, Topology::NONE);
+  EXPECT_EQ(TOPO.node(ROOT_IFACE).m_kind, Kind::INTERFACE);
+  EXPECT_EQ(TOPO.parent(ROOT_IFACE), ROOT);
+  EXPECT_EQ(TOPO.node(ROOT_IFACE).m_depth, 1u);
+  for (Topology::Index i = 0; i < TOPO.size(); ++i) {
+    EXPECT_EQ(TOPO.parent(i) == Topology::NONE, i == ROOT) << TOPO.name(i);
+  }
+
+  const auto HUB = TOPO.find("1-1.1");
+  ASSERT_NE(HUB, Topology::NONE);
+  EXPECT_EQ(TOPO.node(HUB).m_kind, Kind::HUB);
+  EXPECT_EQ(TOPO.name(TOPO.parent(HUB)), "1-1");
+  EXPECT_EQ(TOPO.node(HUB).m_depth, 2u);
+  EXPECT_EQ(TOPO.functions_under(HUB).size(), 22u);
+  EXPECT_EQ(TOPO.parent(TOPO.find("1-1.1:1.0")), HUB);
+
+  // дети хаба по порядку портов: 1-1.1.1, ..., 1-1.1.9, 1-1.1.10, 1-1.1.11
+  std::vector<std::string> ports;
+  for (auto child = TOPO.first_child(HUB); child != Topology::NONE;
+       child = TOPO.next_sibling(child)) {
+    EXPECT_EQ(TOPO.parent(child), HUB);
+    if (TOPO.node(child).m_kind != Kind::INTERFACE) {
+      ports.emplace_back(TOPO.name(child));
+    }
+  }
+  ASSERT_EQ(ports.size(), 11u);
+  EXPECT_EQ(ports[8], "1-1.1.9");
+  EXPECT_EQ(ports[9], "1-1.1.10");
+
+  const auto DEV = TOPO.find("1-1.1.4");
+  ASSERT_NE(DEV, Topology::NONE);
+  EXPECT_EQ(TOPO.node(DEV).m_kind, Kind::DEVICE);
+  EXPECT_EQ(TOPO.node(DEV).m_id,
+            (fs_tools::SysFSHelper::UsbId{0x1a86, 0x7003}));
+  const auto [FIRST, LAST] = TOPO.subtree(DEV);
+  EXPECT_EQ(LAST - FIRST, 5u);
+  const auto UNDER = TOPO.functions_under(DEV);
+  ASSERT_EQ(UNDER.size(), 2u);
+  EXPECT_EQ(UNDER[0].m_pid, "7003");
+
+  const auto FUNC = TOPO.find("hidraw3");
+  ASSERT_NE(FUNC, Topology::NONE);
+  EXPECT_EQ(TOPO.node(FUNC).m_kind, Kind::FUNCTION);
+  EXPECT_EQ(TOPO.name(TOPO.parent(FUNC)), "1-1.1.4:1.1");
+  EXPECT_EQ(TOPO.parent(TOPO.parent(FUNC)), DEV);
+  EXPECT_EQ(TOPO.function(FUNC).m_dev_path, "/dev/hidraw3");
+  // device-ссылки ведут ниже интерфейса (HID-устройство, порт usb-serial),
+  // а функции всё равно висят под интерфейсом
+  EXPECT_EQ(fs::canonical(TREE.class_roots()[1] + "/hidraw3/device")
+                .filename()
+                .string()
+                .rfind("0003:", 0),
+            0u);
+  const auto TTY = TOPO.find("ttyUSB3");
+  ASSERT_NE(TTY, Topology::NONE);
+  EXPECT_EQ(TOPO.name(TOPO.parent(TTY)), "1-1.1.4:1.0");
+  EXPECT_EQ(fs::canonical(TREE.class_roots()[0] + "/ttyUSB3/device")
+                .filename(),
+            "ttyUSB3");
+  EXPECT_EQ(TOPO.find("nosuch"), Topology::NONE);
+}
+
+TEST(VidPidHelper, FakeSysTree_EnumStats) {
+  const fs_tools::testing::FakeSysfs TREE(fs::current_path() / "fake-stats",
+                                          {4, 2});
+  const fs::path TTY = TREE.class_roots().front();
+  const fs::path OTHER = TREE.root() / "sys/devices/platform/serial8250";
+  // три элемента, отбрасываемые по разным причинам
+  write_all(TTY / "console" / "uevent", "MAJOR=5\n");
+  write_all(TTY / "ttyX0" / "uevent", "DEVNAME=ttyX0\n");
+  write_all(OTHER / "uevent", "DRIVER=serial8250\n");
+  write_all(TTY / "ttyS0" / "uevent", "DEVNAME=ttyS0\n");
+  fs::create_symlink(OTHER, TTY / "ttyS0" / "device");
+
+  fs_tools::EnumStats stats;
+  {
+    const fs_tools::EnumStats::Scope SCOPE(&stats);
+    EXPECT_EQ(fs_tools::SysFSHelper::list_functions(TREE.usb_root(),
+                                                    TREE.class_roots())
+                  .size(),
+              8u);
+  }
+  if (!fs_tools::EnumStats::ENABLED) {
+    // хуки вырезаны при компиляции
+    EXPECT_EQ(stats.m_files_read.load(), 0u);
+    return;
+  }
+  // три корня классов и корень USB
+  EXPECT_EQ(stats.m_dirs_opened.load(), 4u);
+  EXPECT_EQ(stats.m_dropped_no_devname.load(), 1u);
+  EXPECT_EQ(stats.m_dropped_no_device_link.load(), 1u);
+  EXPECT_EQ(stats.m_dropped_no_usb_ancestor.load(), 1u);
+  // 11 uevent элементов классов + интерфейсы и предки
+  EXPECT_GE(stats.m_files_read.load(), 11u);
+  EXPECT_GT(stats.m_bytes_read.load(), 0u);
+  EXPECT_GT(stats.m_ancestor_levels.load(), 0u);
+  // одно разрешение на device-ссылку и на элемент корня USB; usb_ids_for
+  // не канонизирует повторно
+  const auto USB_ENTRIES = static_cast<size_t>(
+      std::distance(fs::directory_iterator(TREE.usb_root()),
+                    fs::directory_iterator()));
+  EXPECT_EQ(stats.m_realpath_calls.load(), 9u + 1u + USB_ENTRIES);
+  EXPECT_GT(stats.m_readlink_calls.load(), 0u);
+  EXPECT_GT(stats.phase_time(fs_tools::EnumStats::ANCESTOR_WALK).count(), 0);
+
+  stats.reset();
+  EXPECT_EQ(stats.m_files_read.load(), 0u);
+}
+
+TEST(VidPidHelper, FakeSysTree_ListIdsFollowsSymlinks) {
+  const fs::path ROOT = fs::current_path() / "fake-sys-ids";
+  fs::remove_all(ROOT);
+
+  // как в настоящем /sys/bus/usb/devices: элементы — симлинки на устройства
+  const fs::path DEVICES = ROOT / "devices/usb1";
+  const fs::path SYS_USB = ROOT / "bus/usb/devices";
+  write_all(DEVICES / "1-1" / "uevent", "PRODUCT=403/6001/600\n");
+  write_all(DEVICES / "1-2" / "uevent", "PRODUCT=0x1A86/7523/264\n");
+  write_all(DEVICES / "1-3" / "uevent", "PRODUCT=403/6001/600\n");
+  fs::create_directories(SYS_USB);
+  for (const auto* name : {"1-1", "1-2", "1-3"}) {
+    fs::create_symlink(weakly_canonical_compat(DEVICES / name), SYS_USB / name);
+  }
+  write_all(SYS_USB / "not-a-device", "PRODUCT=dead/beef/1\n");
+
+  const auto ENTRIES = fs_tools::list_entries(SYS_USB.string());
+  ASSERT_EQ(ENTRIES.size(), 4u);
+  for (const auto& entry : ENTRIES) {
+    EXPECT_EQ(entry.is_symlink(), entry.m_name != "not-a-device")
+        << entry.m_name;
+    EXPECT_NE(entry.m_inode, 0u);
+  }
+  const auto FOLLOWED = fs_tools::list_entries(SYS_USB.string(), true);
+  EXPECT_EQ(std::count_if(FOLLOWED.begin(), FOLLOWED.end(),
+                          [](const auto& entry) { return entry.is_dir(); }),
+            3);
+
+  const auto IDS = fs_tools::SysFSHelper::list_ids(SYS_USB.string());
+  const std::vector<std::pair<std::string, std::string>> EXPECTED = {
+      {"1a86", "7523"}, {"403", "6001"}};
+  EXPECT_EQ(IDS, EXPECTED);
+
+  fs::remove_all(ROOT);
+}
+
+TEST(VidPidHelper, FakeSysTree_IndexRefresh) {
+  const fs::path ROOT = fs::current_path() / "fake-sys-index";
+  fs::remove_all(ROOT);
+
+  const fs::path SYS_USB = ROOT / "sys/bus/usb/devices";
+  const fs::path SYS_TTY = ROOT / "sys/class/tty";
+  fs::create_directories(SYS_TTY);
+
+  // два устройства: 1-1 (0403:6001) и 1-2 (1a86:7523)
+  write_all(SYS_USB / "1-1" / "uevent", "PRODUCT=403/6001/600\n");
+  write_all(SYS_USB / "1-2" / "uevent", "PRODUCT=1a86/7523/264\n");
+  fs::create_directories(SYS_USB / "1-1" / "1-1:1.0");
+  fs::create_directories(SYS_USB / "1-2" / "1-2:1.0");
+
+  auto add_tty = [&](const std::string& name, const fs::path& iface) {
+    write_all(SYS_TTY / name / "uevent", "DEVNAME=" + name + "\n");
+    fs::create_symlink(weakly_canonical_compat(iface),
+                       SYS_TTY / name / "device");
+  };
+  add_tty("ttyUSB0", SYS_USB / "1-1" / "1-1:1.0");
+
+  fs_tools::SysFSIndex index({SYS_TTY.string()});
+  ASSERT_EQ(index.size(), 1u);
+  ASSERT_TRUE(index.find("/dev/ttyUSB0").has_value());
+  EXPECT_EQ(index.find("ttyUSB0")->m_vid, "403");
+  EXPECT_EQ(index.find_by_id("0x0403", "6001").size(), 1u);
+  EXPECT_EQ(index.find_by_usb_node(index.find("ttyUSB0")->m_usbNode).size(),
+            1u);
+  const auto LISTED =
+      fs_tools::SysFSHelper::list_functions({}, {SYS_TTY.string()});
+  ASSERT_EQ(index.functions().size(), LISTED.size());
+  EXPECT_EQ(index.functions().front().m_dev_path, LISTED.front().m_dev_path);
+
+  // без изменений refresh ничего не перечитывает
+  EXPECT_EQ(index.refresh(), 0u);
+
+  add_tty("ttyUSB1", SYS_USB / "1-2" / "1-2:1.0");
+  EXPECT_EQ(index.refresh(), 1u);
+  EXPECT_EQ(index.size(), 2u);
+  EXPECT_EQ(index.find_by_id("1a86", "7523").size(), 1u);
+
+  fs::remove_all(SYS_TTY / "ttyUSB0");
+  EXPECT_EQ(index.refresh(), 1u);
+  EXPECT_FALSE(index.find("ttyUSB0").has_value());
+  EXPECT_TRUE(index.find_by_id("403", "6001").empty());
+
+  // перепрошивка: тот же узел, новый PRODUCT → invalidate
+  write_all(SYS_USB / "1-2" / "uevent", "PRODUCT=1a86/55d4/443\n");
+  EXPECT_TRUE(index.invalidate("/dev/ttyUSB1"));
+  EXPECT_EQ(index.find("ttyUSB1")->m_pid, "55d4");
+  EXPECT_TRUE(index.find_by_id("1a86", "7523").empty());
+
+  // элемент пересоздан: invalidate берёт новый inode, refresh не повторяет
+  fs::remove_all(SYS_TTY / "ttyUSB1");
+  add_tty("ttyUSB1", SYS_USB / "1-2" / "1-2:1.0");
+  EXPECT_TRUE(index.invalidate("ttyUSB1"));
+  EXPECT_EQ(index.refresh(), 0u);
+
+  // у предка нет uevent, и он не под корневым хабом usbN: отказ
+  // окончательный, refresh его не повторяет, а invalidate — повторяет
+  fs::create_directories(SYS_USB / "1-3" / "1-3:1.0");
+  add_tty("ttyUSB2", SYS_USB / "1-3" / "1-3:1.0");
+  EXPECT_EQ(index.refresh(), 1u);
+  EXPECT_FALSE(index.find("ttyUSB2").has_value());
+  EXPECT_FALSE(index.invalidate("/dev/ttyUSB2"));
+  write_all(SYS_USB / "1-3" / "uevent", "PRODUCT=10c4/ea60/100\n");
+  EXPECT_EQ(index.refresh(), 0u);
+  EXPECT_FALSE(index.find("ttyUSB2").has_value());
+  EXPECT_TRUE(index.invalidate("/dev/ttyUSB2"));
+  EXPECT_EQ(index.find("ttyUSB2")->m_vid, "10c4");
+
+  // USB-устройство под usb2, uevent ещё не прочитать: отказ временный, и
+  // один refresh() без invalidate подхватывает устройство
+  const fs::path HUB = ROOT / "sys/devices/pci0000:00/usb2";
+  fs::create_directories(HUB / "2-1" / "2-1:1.0");
+  add_tty("ttyACM0", HUB / "2-1" / "2-1:1.0");
+  EXPECT_EQ(index.refresh(), 1u);
+  EXPECT_FALSE(index.find("ttyACM0").has_value());
+  EXPECT_EQ(index.refresh(), 0u);  // повтор без успеха не считается
+  write_all(HUB / "2-1" / "uevent", "PRODUCT=2341/43/1\n");
+  EXPECT_EQ(index.refresh(), 1u);
+  ASSERT_TRUE(index.find("ttyACM0").has_value());
+  EXPECT_EQ(index.find("ttyACM0")->m_vid, "2341");
+
+  // окончательные отказы и резолвленные элементы refresh не перечитывает
+  fs_tools::EnumStats stats;
+  {
+    const fs_tools::EnumStats::Scope SCOPE(&stats);
+    EXPECT_EQ(index.refresh(), 0u);
+  }
+  if (fs_tools::EnumStats::ENABLED) {
+    EXPECT_EQ(stats.m_files_read, 0u);
+  }
+
+  fs::remove_all(ROOT);
+}
+
+TEST(VidPidHelper, DeviceSnapshot_Diff) {
+  const fs_tools::testing::FakeSysfs TREE(fs::current_path() / "fake-snap",
+                                          {4, 2});
+  const auto BEFORE = fs_tools::DeviceSnapshot::capture(TREE.usb_root(),
+                                                        TREE.class_roots());
+  ASSERT_EQ(BEFORE.size(), TREE.functions().size());
+  EXPECT_TRUE(fs_tools::DeviceSnapshot::diff(BEFORE, BEFORE).empty());
+  ASSERT_TRUE(BEFORE.find("/dev/hidraw2").has_value());
+  EXPECT_EQ(BEFORE.find("hidraw2")->m_pid, "7002");
+  EXPECT_FALSE(BEFORE.find("ttyUSB9").has_value());
+
+  // порядок входа не важен: снимок упорядочен по (dev path, класс)
+  auto funcs = BEFORE.functions();
+  std::reverse(funcs.begin(), funcs.end());
+  EXPECT_TRUE(
+      fs_tools::DeviceSnapshot::diff(BEFORE, fs_tools::DeviceSnapshot(funcs))
+          .empty());
+
+  // ttyUSB0 выдернут, hidraw1 перепрошит (новый PID), ttyUSB7 добавлен
+  funcs.erase(std::remove_if(funcs.begin(), funcs.end(),
+                             [](const auto& func) {
+                               return func.m_dev_name == "ttyUSB0";
+                             }),
+              funcs.end());
+  for (auto& func : funcs) {
+    if (func.m_dev_name == "hidraw1") {
+      func.m_id.m_pid = 0x55d4;
+    }
+  }
+  auto added = funcs.front();
+  added.m_dev_name = "ttyUSB7";
+  added.m_dev_path = "/dev/ttyUSB7";
+  added.m_class_name = "tty";
+  funcs.push_back(added);
+
+  const auto DIFF =
+      fs_tools::DeviceSnapshot::diff(BEFORE, fs_tools::DeviceSnapshot(funcs));
+  ASSERT_EQ(DIFF.m_removed.size(), 1u);
+  EXPECT_EQ(DIFF.m_removed[0].m_dev_name, "ttyUSB0");
+  ASSERT_EQ(DIFF.m_added.size(), 1u);
+  EXPECT_EQ(DIFF.m_added[0].m_dev_path, "/dev/ttyUSB7");
+  ASSERT_EQ(DIFF.m_changed.size(), 1u);
+  EXPECT_EQ(DIFF.m_changed[0].m_before.m_pid, "7001");
+  EXPECT_EQ(DIFF.m_changed[0].m_after.m_pid, "55d4");
+}
+
+TEST(VidPidHelper, DeviceRegistry_PublishesSnapshots) {
+  const fs_tools::testing::FakeSysfs TREE(fs::current_path() / "fake-registry",
+                                          {4, 2});
+  fs_tools::DeviceRegistry registry(TREE.class_roots());
+  ASSERT_EQ(registry.generation(), 1u);
+  const auto FIRST = registry.snapshot();
+  ASSERT_EQ(FIRST->size(), TREE.functions().size());
+
+  // без изменений новый снимок не публикуется
+  EXPECT_FALSE(registry.refresh());
+  EXPECT_EQ(registry.snapshot(), FIRST);
+
+  // читатели в других потоках, пока писатель обновляет реестр
+  std::atomic<bool> done{false};
+  std::vector<std::thread> readers;
+  std::atomic<size_t> reads{0};
+  for (int i = 0; i < 4; ++i) {
+    readers.emplace_back([&registry, &done, &reads] {
+      fs_tools::DeviceRegistry::Reader reader(registry);
+      while (!done.load()) {
+        const auto& SNAP = reader.get();
+        EXPECT_GE(SNAP.size(), 7u);
+        reads.fetch_add(1);
+      }
+    });
+  }
+  fs::remove(TREE.root() / "sys/class/tty/ttyUSB0");
+  EXPECT_TRUE(registry.refresh());
+  done = true;
+  for (auto& thread : readers) {
+    thread.join();
+  }
+  EXPECT_GT(reads.load(), 0u);
+
+  EXPECT_EQ(registry.generation(), 2u);
+  const auto DIFF =
+      fs_tools::DeviceSnapshot::diff(*FIRST, *registry.snapshot());
+  ASSERT_EQ(DIFF.m_removed.size(), 1u);
+  EXPECT_EQ(DIFF.m_removed[0].m_dev_name, "ttyUSB0");
+  // старый снимок жив, пока на него есть ссылка
+  EXPECT_EQ(FIRST->size(), TREE.functions().size());
+
+  // фоновое обновление подхватывает удаление само
+  fs_tools::DeviceRegistry::Reader reader(registry);
+  registry.start(std::chrono::milliseconds(5));
+  fs::remove(TREE.root() / "sys/class/hidraw/hidraw0");
+  for (int i = 0; i < 400 && reader.get().find("hidraw0"); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  registry.stop();
+  EXPECT_FALSE(reader.get().find("hidraw0").has_value());
+  EXPECT_EQ(reader.get().size(), TREE.functions().size() - 2);
+
+  // снимки, заменённые под читателями snapshot(), освобождаются только
+  // после них
+  const auto LAST = registry.snapshot();
+  done = false;
+  readers.clear();
+  for (int i = 0; i < 4; ++i) {
+    readers.emplace_back([&registry, &done, &LAST] {
+      while (!done.load()) {
+        const auto SNAP = registry.snapshot();
+        ASSERT_NE(SNAP, nullptr);
+        EXPECT_EQ(SNAP->size(), LAST->size());
+      }
+    });
+  }
+  const auto BEFORE = registry.generation();
+  for (int i = 0; i < 200; ++i) {
+    registry.publish(fs_tools::DeviceSnapshot(LAST->functions()));
+  }
+  done = true;
+  for (auto& thread : readers) {
+    thread.join();
+  }
+  EXPECT_EQ(registry.generation(), BEFORE + 200);
+}
+
+TEST(VidPidHelper, SnapshotCache_RoundTripAndStale) {
+  const fs_tools::testing::FakeSysfs TREE(fs::current_path() / "fake-cache",
+                                          {5, 2});
+  const auto USB = TREE.usb_root();
+  const auto ROOTS = TREE.class_roots();
+  const auto PATH = (fs::current_path() / "fake-cache.bin").string();
+  fs::remove(PATH);
+
+  std::error_code error;
+  EXPECT_FALSE(fs_tools::SnapshotCache::open(PATH, error, USB, ROOTS));
+  EXPECT_EQ(error, std::errc::no_such_file_or_directory);
+
+  const auto LIVE = fs_tools::SnapshotCache::rebuild(PATH, error, USB, ROOTS);
+  ASSERT_FALSE(error) << error.message();
+  ASSERT_EQ(LIVE.size(), 10u);
+
+  auto cache = fs_tools::SnapshotCache::open(PATH, error, USB, ROOTS);
+  ASSERT_TRUE(cache.has_value()) << error.message();
+  EXPECT_EQ(cache->size(), LIVE.size());
+  EXPECT_TRUE(fs_tools::DeviceSnapshot::diff(LIVE, cache->snapshot()).empty());
+  const auto FUNC = cache->find("/dev/hidraw3");
+  ASSERT_TRUE(FUNC.has_value());
+  const auto EXPECTED = fs_tools::SysFSHelper::find("hidraw3", ROOTS);
+  ASSERT_TRUE(EXPECTED.has_value());
+  EXPECT_EQ(FUNC->m_usbNode, EXPECTED->m_usbNode);
+  EXPECT_EQ(FUNC->m_id, EXPECTED->m_id);
+  EXPECT_EQ(FUNC->m_class_name, "hidraw");
+  EXPECT_FALSE(cache->find("ttyUSB9"));
+  EXPECT_EQ(cache->find_by_id("0x1a86", "7002").size(), 2u);
+  EXPECT_TRUE(cache->find_by_id("1a86", "zz").empty());
+
+  // другой набор корней — кеш не про них
+  EXPECT_FALSE(fs_tools::SnapshotCache::open(PATH, error, USB, {ROOTS[0]}));
+  EXPECT_EQ(error.value(), ESTALE);
+
+  // выдернули функцию — отпечаток корня класса изменился
+  fs::remove(TREE.root() / "sys/class/tty/ttyUSB1");
+  EXPECT_FALSE(fs_tools::SnapshotCache::open(PATH, error, USB, ROOTS));
+  EXPECT_EQ(error.value(), ESTALE);
+  fs_tools::SnapshotCache::rebuild(PATH, error, USB, ROOTS);
+  cache = fs_tools::SnapshotCache::open(PATH, error, USB, ROOTS);
+  ASSERT_TRUE(cache.has_value());
+  EXPECT_EQ(cache->size(), 9u);
+
+  // параллельные rebuild() одного файла: у каждого свой временный файл
+  {
+    std::vector<std::thread> writers;
+    std::atomic<int> failed{0};
+    for (int i = 0; i < 4; ++i) {
+      writers.emplace_back([&] {
+        std::error_code own;
+        for (int j = 0; j < 5; ++j) {
+          fs_tools::SnapshotCache::rebuild(PATH, own, USB, ROOTS);
+          failed += own ? 1 : 0;
+        }
+      });
+    }
+    for (auto& writer : writers) {
+      writer.join();
+    }
+    EXPECT_EQ(failed.load(), 0);
+  }
+  cache = fs_tools::SnapshotCache::open(PATH, error, USB, ROOTS);
+  ASSERT_TRUE(cache.has_value()) << error.message();
+  EXPECT_EQ(cache->size(), 9u);
+  for (const auto& entry : fs::directory_iterator(fs::current_path())) {
+    EXPECT_EQ(entry.path().string().find(PATH + ".tmp."), std::string::npos);
+  }
+
+  // обрезанный файл
+  fs::resize_file(PATH, fs::file_size(PATH) - 1);
+  EXPECT_FALSE(fs_tools::SnapshotCache::open(PATH, error, USB, ROOTS));
+  EXPECT_EQ(error, std::errc::invalid_argument);
+  fs::remove(PATH);
+}
+
+TEST(VidPidHelper, FakeSysTree_HotplugSocketpair) {
+  const fs::path ROOT = fs::current_path() / "fake-sys-hotplug";
+  fs::remove_all(ROOT);
+
+  // /devices/usb1/1-1 → PRODUCT=2341/43/1, класс tty под интерфейсом
+  const fs::path USB_DEV = ROOT / "devices/usb1/1-1";
+  const fs::path IFACE = USB_DEV / "1-1:1.0";
+  write_all(USB_DEV / "uevent", "PRODUCT=2341/43/1\n");
+  write_all(IFACE / "tty/ttyACM0/uevent", "DEVNAME=ttyACM0\n");
+  fs::create_symlink(weakly_canonical_compat(IFACE),
+                     IFACE / "tty/ttyACM0/device");
+
+  std::array<int, 2> fds{};
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_DGRAM, 0, fds.data()), 0);
+
+  std::vector<fs_tools::HotplugMonitor::Event> events;
+  auto monitor = fs_tools::HotplugMonitor::adopt(
+      fds[0], [&](const auto& event) { events.push_back(event); },
+      ROOT.string());
+
+  auto send_message = [&](const std::string& msg) {
+    ASSERT_EQ(::send(fds[1], msg.data(), msg.size(), 0),
+              static_cast<ssize_t>(msg.size()));
+  };
+  using namespace std::string_literals;
+  send_message(
+      "add@/devices/usb1/1-1/1-1:1.0/tty/ttyACM0\0ACTION=add\0"
+      "DEVPATH=/devices/usb1/1-1/1-1:1.0/tty/ttyACM0\0SUBSYSTEM=tty\0"
+      "DEVNAME=ttyACM0\0"s);
+  // сообщения udevd (заголовок "libudev") игнорируются
+  send_message("libudev\0ACTION=add\0DEVNAME=ttyACM0\0"s);
+
+  EXPECT_EQ(monitor.poll(std::chrono::milliseconds(1000)), 1u);
+  ASSERT_EQ(events.size(), 1u);
+  EXPECT_EQ(events[0].m_action, fs_tools::HotplugMonitor::Action::ADDED);
+  EXPECT_EQ(events[0].m_function.m_dev_path, "/dev/ttyACM0");
+  EXPECT_EQ(events[0].m_function.m_class_name, "tty");
+  EXPECT_EQ(events[0].m_function.m_vid, "2341");
+  EXPECT_EQ(events[0].m_function.m_pid, "43");
+
+  // удаление USB-устройства снимает все функции под ним
+  const auto REMOVE =
+      "remove@/devices/usb1/1-1\0ACTION=remove\0DEVPATH=/devices/usb1/1-1\0"
+      "SUBSYSTEM=usb\0DEVTYPE=usb_device\0PRODUCT=2341/43/1\0"s;
+  EXPECT_EQ(monitor.handle_message(REMOVE.data(), REMOVE.size()), 1u);
+  ASSERT_EQ(events.size(), 2u);
+  EXPECT_EQ(events[1].m_action, fs_tools::HotplugMonitor::Action::REMOVED);
+  EXPECT_EQ(events[1].m_function.m_dev_path, "/dev/ttyACM0");
+
+  // повторное удаление уже ничего не даёт
+  EXPECT_EQ(monitor.handle_message(REMOVE.data(), REMOVE.size()), 0u);
+
+  ::close(fds[1]);
+  fs::remove_all(ROOT);
+}
+
 TEST(VidPidHelper, RealSystem_Enumerate_And_ReverseIfAvailable) {
   // 1) список всех VID:PID из USB-дерева
   const auto ALL_VID_PID = fs_tools::SysFSHelper::list_ids();
@@ -111,6 +1501,13 @@ TEST(VidPidHelper, RealSystem_Enumerate_And_ReverseIfAvailable) {
         << "Reverse lookup failed for " << func.m_dev_path;
     EXPECT_EQ(back->m_vid, func.m_vid);
     EXPECT_EQ(back->m_pid, func.m_pid);
+    // корень класса с завершающим '/' — тот же класс, а не промах
+    const auto SLASHED = fs_tools::SysFSHelper::find(
+        func.m_dev_path, {"/sys/class/" + func.m_class_name + "/"});
+    ASSERT_TRUE(SLASHED.has_value())
+        << "Reverse lookup with a slashed root failed for " << func.m_dev_path;
+    EXPECT_EQ(SLASHED->m_id, func.m_id);
+    EXPECT_EQ(SLASHED->m_class_name, func.m_class_name);
 
     // 4) прямой поиск VID:PID должен, как минимум, возвращать что-то,
     // и среди результатов должен быть наш devPath (в реальной системе — часто